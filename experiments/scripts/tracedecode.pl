@@ -0,0 +1,52 @@
+#!/usr/bin/perl
+
+# Decode the "[B]" binary trace lines printed by the logger thread into the
+# text lines print_dbg would have printed, so that the output can be fed to
+# the other scripts. All other lines are passed through unchanged.
+# Usage: tracedecode.pl [-v] log.txt | streamredundancy.pl
+# -v prints the verbose form of the messages, as with COMPRESSED_DBG=false
+# The event numbers must be kept in sync with network_module/util/trace.h
+
+use warnings;
+no warnings 'portable';
+use strict;
+
+my $verbose=0;
+if(@ARGV && $ARGV[0] eq '-v') { $verbose=1; shift @ARGV; }
+
+my @data=(
+    ['Sent packet for stream', 's'],          # DATA_SENT
+    ['no packet ready to send for stream', 'x'], # DATA_NOT_READY
+    ['Skipped copy for stream', 'k'],         # DATA_SKIPPED
+    ['Received packet for stream', 'r'],      # DATA_RECEIVED
+    ['Missed packet for stream', 'm'],        # DATA_MISSED
+);
+
+while(<>)
+{
+    # Fields are hex except the time and the extra value, signed decimal
+    unless(/^(.*)\[B\] ([0-9a-f]+) ([0-9a-f]+) ([0-9a-f]+) ([0-9a-f]+) (-?\d+) (-?\d+)$/) {
+        print;
+        next;
+    }
+    my $prefix=$1, my $ev=hex($2), my $node=hex($3), my $src=hex($4), my $dst=hex($5);
+    my $t=$6, my $extra=$7;
+    if($ev < @data) {
+        my ($text, $short)=@{$data[$ev]};
+        if($verbose) { print "$prefix\[D\] Node $node: $text ($src,$dst) NT=$t\n"; }
+        else         { print "$prefix\[D\] $short ($src,$dst) NT=$t\n"; }
+    } elsif($ev == 5) { # DATA_PERIOD_END
+        if($verbose) { print "$prefix\[D\] Node $node: ($src,$dst) --- \n"; }
+        else         { print "$prefix\[D\] - ($src,$dst)\n"; }
+    } elsif($ev == 6) { # DATA_RECOVERED
+        print "$prefix\[D\] Node $node: Recovered packet for stream ($src,$dst)\n";
+    } elsif($ev == 7) { # UPLINK_SLOT
+        print "$prefix\[U\] N=$node NT=$t\n";
+    } elsif($ev == 8) { # UPLINK_SENT
+        print "$prefix\[U\] N=$node -> \@$t\n";
+    } elsif($ev == 9) { # UPLINK_RECEIVED
+        print "$prefix\[U\]<-N=$node \@$t ${extra}dBm\n";
+    } else {
+        print "$prefix\[E\] Unknown trace event $ev\n";
+    }
+}
@@ -168,7 +168,18 @@ void masterNode(void*)
             -95,           //minWeakNeighborRSSI
             4,             //maxMissedTimesyncs
             true,          //channelSpatialReuse
-            useWeakTopologies          //useWeakTopologies
+            useWeakTopologies,          //useWeakTopologies
+            false,                      //compactDataHeader
+            false,                      //combineRedundantCopies
+            false,                      //earlyTermination
+            false,                      //calibrateSlotTiming
+            false,                      //adaptiveUplink
+            false,                      //burstUplink
+            false,                      //deltaTopologies
+            false,                      //sparseTopologies
+            false,                      //concurrentUplink
+            false,                      //smeFastPath
+            false                       //backgroundRekeying
 #ifdef CRYPTO
             ,
             true,          //authenticateControlMessages
@@ -225,7 +236,18 @@ void dynamicNode(void* argv)
             -95,           //minWeakNeighborRSSI
             4,             //maxMissedTimesyncs
             true,          //channelSpatialReuse
-            useWeakTopologies          //useWeakTopologies
+            useWeakTopologies,          //useWeakTopologies
+            false,                      //compactDataHeader
+            false,                      //combineRedundantCopies
+            false,                      //earlyTermination
+            false,                      //calibrateSlotTiming
+            false,                      //adaptiveUplink
+            false,                      //burstUplink
+            false,                      //deltaTopologies
+            false,                      //sparseTopologies
+            false,                      //concurrentUplink
+            false,                      //smeFastPath
+            false                       //backgroundRekeying
 #ifdef CRYPTO
             ,
             true,          //authenticateControlMessages
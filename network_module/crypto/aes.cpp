@@ -26,7 +26,7 @@
  ***************************************************************************/
 
 #include <stdexcept>
-#include <mutex>
+#include <algorithm>
 #include "aes.h"
 #include "initialization_vector.h"
 #include "crypto_utils.h"
@@ -44,14 +44,14 @@ const unsigned int Aes::AESBlockSize = 16;
 #ifdef _MIOSIX
 miosix::Mutex Aes::aesMutex;
 AESAccelerator& Aes::aesAcc = AESAccelerator::instance();
-#else
-std::mutex Aes::aesMutex;
 #endif
 
 Aes::~Aes() {
     secureClearBytes(key, AESBlockSize);
 #ifdef _MIOSIX
     secureClearBytes(lrk, AESBlockSize);
+#else
+    secureClearBytes(&roundKeys, sizeof(roundKeys));
 #endif
 }
 
@@ -71,9 +71,8 @@ void Aes::ecbEncrypt(void *ctx, const void *ptx, unsigned int length) {
             aesAcc.aes128_ecbEncrypt(&cp[i], &pp[i]);
         }
 #else
-        std::unique_lock<std::mutex> lock(aesMutex);
         for (unsigned i=0; i<length; i+=AESBlockSize) {
-            AES_ECB_encrypt(&pp[i], key, &cp[i]);
+            AES_ECB_encrypt_ctx(&roundKeys, &pp[i], &cp[i]);
         }
 #endif
     }
@@ -95,9 +94,8 @@ void Aes::ecbDecrypt(void *ptx, const void *ctx, unsigned int length) {
             aesAcc.aes128_ecbDecrypt(&pp[i], &cp[i]);
         }
 #else
-        std::unique_lock<std::mutex> lock(aesMutex);
         for (unsigned i=0; i<length; i+=AESBlockSize) {
-            AES_ECB_decrypt(&cp[i], key, &pp[i]);
+            AES_ECB_decrypt_ctx(&roundKeys, &cp[i], &pp[i]);
         }
 #endif
     }
@@ -116,8 +114,6 @@ void Aes::ctrXcrypt(const IV& iv, void *dst, const void *src, unsigned int lengt
 #ifdef _MIOSIX
         miosix::Lock<miosix::Mutex> lock(aesMutex);
         aesAcc.aes128_setKey(key);
-#else
-        std::unique_lock<std::mutex> lock(aesMutex);
 #endif
         IV ctr(iv);
 
@@ -127,7 +123,7 @@ void Aes::ctrXcrypt(const IV& iv, void *dst, const void *src, unsigned int lengt
 #ifdef _MIOSIX
             aesAcc.aes128_ecbEncrypt(buffer, ctr.getData());
 #else
-            AES_ECB_encrypt(ctr.getData(), key, buffer);
+            AES_ECB_encrypt_ctx(&roundKeys, ctr.getData(), buffer);
 #endif
             xorBytes(&dp[i], buffer, &sp[i], blockLength);
             ++ctr; //prefix operator is more efficient
@@ -26,7 +26,7 @@
  ***************************************************************************/
 
 #pragma once
-#include <mutex>
+#include <cstring>
 #include "initialization_vector.h"
 #ifdef _MIOSIX
 #include "../util/aes_accelerator.h"
@@ -49,7 +49,7 @@ public:
             miosix::Lock<miosix::Mutex> lock(aesMutex);
             aesAcc.aes128_computeLastRoundKey(lrk, key);
 #else
-            std::unique_lock<std::mutex> lock(aesMutex);
+            AES_init_ctx(&roundKeys, this->key);
 #endif
         }
     }
@@ -61,7 +61,7 @@ public:
             miosix::Lock<miosix::Mutex> lock(aesMutex);
             aesAcc.aes128_computeLastRoundKey(lrk, key);
 #else
-            std::unique_lock<std::mutex> lock(aesMutex);
+            AES_init_ctx(&roundKeys, this->key);
 #endif
         }
     }
@@ -73,7 +73,7 @@ public:
             miosix::Lock<miosix::Mutex> lock(aesMutex);
             aesAcc.aes128_computeLastRoundKey(lrk, key);
 #else
-            std::unique_lock<std::mutex> lock(aesMutex);
+            AES_init_ctx(&roundKeys, this->key);
 #endif
         }
     }
@@ -95,13 +95,11 @@ public:
 private:
     static const unsigned int AESBlockSize;
 
+#ifdef _MIOSIX
     /* Mutex to access the AESAccelerator, must be locked before setting the key
      * and unlocked after all blocks are processed that use such key. */
-#ifdef _MIOSIX
     static miosix::Mutex aesMutex;
     static AESAccelerator& aesAcc;
-#else
-    static std::mutex aesMutex;
 #endif
 
 
@@ -109,6 +107,10 @@ private:
 
 #ifdef _MIOSIX
     unsigned char lrk[16];
+#else
+    /* Round keys expanded once per key, with no state shared between
+     * instances, so that no locking is needed */
+    AES_ctx roundKeys;
 #endif
 
 };
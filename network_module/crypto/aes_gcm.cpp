@@ -25,6 +25,7 @@
  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
  ***************************************************************************/
 
+#include <algorithm>
 #include "aes_gcm.h"
 #include "initialization_vector.h"
 #include "crypto_utils.h"
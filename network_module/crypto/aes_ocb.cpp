@@ -37,6 +37,8 @@ AesOcb::~AesOcb() {
     secureClearBytes(l_star, blockSize);
     secureClearBytes(l_dollar, blockSize);
     secureClearBytes(l, maxCachedL*blockSize);
+    secureClearBytes(firstOffset, blockSize);
+    secureClearBytes(slotInfoAuth, blockSize);
 }
 
 void AesOcb::encryptAndComputeTag(void *tag, void *ctx, const void *ptx,
@@ -58,7 +60,7 @@ void AesOcb::encryptAndComputeTag(void *tag, void *ctx, const void *ptx,
     const unsigned char *pp = reinterpret_cast<const unsigned char*>(ptx);
     unsigned int clen = cryptLength;
 
-    computeFirstOffset();
+    memcpy(offsetBuffer, firstOffset, blockSize);
     unsigned i = 0;
     while (clen >= blockSize) {
         // compute each offset from previous one in offsetBuffer
@@ -119,7 +121,7 @@ bool AesOcb::verifyAndDecrypt(const void *tag, void *ptx, const void *ctx,
     const unsigned char *cp = reinterpret_cast<const unsigned char*>(ctx);
     unsigned int clen = cryptLength;
 
-    computeFirstOffset();
+    memcpy(offsetBuffer, firstOffset, blockSize);
     unsigned i = 0;
     while (clen >= blockSize) {
         // compute each offset from previous one in offsetBuffer
@@ -212,10 +214,9 @@ void AesOcb::processAdditionalData(const void* auth, unsigned int authLength) {
     }
 
     /* xor all deltas with all data, and ECB-encrypt in bulk. The first data block is
-     * the slotInfo block. */
-    xorBytes(offsetBuffer, offsetBuffer, slotInfo, blockSize);
+     * the slotInfo block, that was already encrypted by prepareNonce(). */
     xorBytes(offsetBuffer + blockSize, offsetBuffer + blockSize, auth, authLength);
-    aes.ecbEncrypt(authBuffer, offsetBuffer, authBlocks*blockSize);
+    aes.ecbEncrypt(authBuffer + blockSize, offsetBuffer + blockSize, (authBlocks - 1)*blockSize);
 
     /* compute sum */
     memset(sum, 0, blockSize);
@@ -224,7 +225,8 @@ void AesOcb::processAdditionalData(const void* auth, unsigned int authLength) {
 //#define TEST_EMPTY_AUTH_DATA
 #endif
 #ifndef TEST_EMPTY_AUTH_DATA
-    for (i=0; i<authLen; i+=blockSize) {
+    memcpy(sum, slotInfoAuth, blockSize);
+    for (i=blockSize; i<authLen; i+=blockSize) {
         xorBytes(sum, sum, &authBuffer[i], blockSize);
     }
 #endif
@@ -240,13 +242,21 @@ void AesOcb::finishTag(unsigned char tag[16], const unsigned char offset[16]) {
     secureClearBytes(sum, blockSize);
 }
 
+void AesOcb::prepareNonce() {
+    computeFirstOffset();
+    xorBytes(slotInfoAuth, slotInfo, &l[ntz[0]][0], blockSize);
+    aes.ecbEncrypt(slotInfoAuth, slotInfoAuth);
+}
+
 void AesOcb::computeFirstOffset() {
     // select the last 6 bits
     unsigned char bottom = nonce[15] & 0x3f;
-    // clear the last 6 bits
-    nonce[15] = nonce[15] & 0xc0;
+    // clear the last 6 bits, leaving the nonce unchanged
+    unsigned char top[16];
+    memcpy(top, nonce, blockSize);
+    top[15] = top[15] & 0xc0;
     unsigned char ktop[24];
-    aes.ecbEncrypt(ktop, nonce);
+    aes.ecbEncrypt(ktop, top);
     memcpy(ktop + 16, ktop, 8);
     xorBytes(ktop + 16, ktop + 16, ktop + 1, 8);
     unsigned char bitshift = bottom % 8;
@@ -254,9 +264,10 @@ void AesOcb::computeFirstOffset() {
     for (int i=15; i>=0; i--) {
         unsigned char rightpart = ktop[i+byteshift+1] >> (8-bitshift);
         unsigned char leftpart = ktop[i+byteshift] << bitshift;
-        offsetBuffer[i] = rightpart | leftpart ;
+        firstOffset[i] = rightpart | leftpart ;
     }
     secureClearBytes(ktop, 24);
+    secureClearBytes(top, blockSize);
 }
 
 void AesOcb::gfDouble(unsigned char dst[16], const unsigned char src[16]) {
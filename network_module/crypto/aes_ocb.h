@@ -38,6 +38,12 @@ namespace mxnet {
  *  - setNonce
  *  - encryptAndComputeTag / verifyAndDecrypt
  *
+ * setNonce also precomputes the first offset and the authentication of the
+ * slotInfo block, which only depend on the key and on the nonce. Calling it
+ * ahead of time, e.g. before waiting for a slot, leaves only the data
+ * dependent part of the computation to encryptAndComputeTag and
+ * verifyAndDecrypt. The same nonce can be used for more than one call.
+ *
  * NOTE (1): this implementation presents a small difference with respect to
  * the standard's prescriptions. The standard prescribes support for a nonce of
  * variable length. We have chosen to always use a nonce of the maximum possible
@@ -56,15 +62,18 @@ public:
 
     AesOcb(const unsigned char key[16]) : aes(key) {
         compute_l_values();
+        prepareNonce();
     }
 
     AesOcb() : aes() {
         compute_l_values();
+        prepareNonce();
     }
 
     void rekey(const unsigned char key[16]) {
         aes.rekey(key);
         compute_l_values();
+        prepareNonce();
     }
 
     void setNonce(unsigned int tileOrFrameNumber,
@@ -82,6 +91,7 @@ public:
         auto ip = reinterpret_cast<unsigned int *>(&nonce[1]);
         ip[0] = masterIndex;
         ip[1] = tileOrFrameNumber;
+        prepareNonce();
     }
 
 #ifdef UNITTEST
@@ -90,6 +100,7 @@ public:
      * */
     void setSlotInfo(unsigned char data[16]) {
         memcpy(slotInfo, data, 16);
+        prepareNonce();
     }
 
     /**
@@ -103,6 +114,7 @@ public:
         this->nonce[2] = 0x0;
         this->nonce[3] = 0x1;
         memcpy(this->nonce + 4,  nonce, 12);
+        prepareNonce();
     }
 #endif
 
@@ -150,6 +162,12 @@ private:
         lp[0] = sequenceNumber;
     }
 
+    /**
+     * Compute the values that only depend on the key, nonce and slotInfo,
+     * that is the first offset and the authentication of the slotInfo block
+     */
+    void prepareNonce();
+
     /**
      * Compute the value of the first offset used for encryption/decryption
      */
@@ -222,7 +240,12 @@ private:
      * - sequenceNumber
      * - masterIndex
      **/
-    unsigned char __attribute__((aligned(4))) slotInfo[16];
+    unsigned char __attribute__((aligned(4))) slotInfo[16] = {0};
+
+    /* precomputed by prepareNonce() */
+    unsigned char firstOffset[blockSize];
+    unsigned char slotInfoAuth[blockSize];
+
     Aes aes;
 };
 
@@ -29,6 +29,7 @@
 
 #include <cstring>
 #include "aes.h"
+#include "crypto_utils.h"
 
 namespace mxnet {
 
@@ -108,6 +109,13 @@ public:
         memcpy(this->iv, iv, 16);
     }
 
+    /**
+     * The IV can be secret, as for the hash of the stream keys
+     */
+    ~SingleBlockMPHash() {
+        secureClearBytes(iv, 16);
+    }
+
     /**
      * Change IV and reset
      * \param iv the new init vector in Miyaguchi-Preneel scheme
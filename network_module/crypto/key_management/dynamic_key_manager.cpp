@@ -42,17 +42,15 @@ namespace mxnet {
  */
 void DynamicKeyManager::startRekeying() {
     if (status == KeyManagerStatus::MASTER_UNTRUSTED) {
-        masterHash.digestBlock(nextMasterKey, tempMasterKey);
-        nextMasterIndex = tempMasterIndex + 1;
+        masterChain.next(nextMasterKey, tempMasterKey);
         status = KeyManagerStatus::REKEYING_UNTRUSTED;
     } else if (status == KeyManagerStatus::CONNECTED) {
-        masterHash.digestBlock(nextMasterKey, masterKey);
-        nextMasterIndex = masterIndex + 1;
+        masterChain.next(nextMasterKey, masterKey);
         status = KeyManagerStatus::REKEYING;
 
         /* Also prepare the stream manager for rekeying */
         unsigned char nextIv[16];
-        firstBlockStreamHash.digestBlock(nextIv, nextMasterKey);
+        firstBlockStreamHash.digestBlock(nextIv, nextMasterKey.get());
         streamMgr.setSecondBlockHash(nextIv);
         memset(nextIv, 0, 16);
     } else {
@@ -64,9 +62,9 @@ void DynamicKeyManager::startRekeying() {
         print_dbg("[KM] N=%d starting rekeying\n", myId);
     }
 
-    uplinkHash.digestBlock(nextUplinkKey, nextMasterKey);
-    downlinkHash.digestBlock(nextDownlinkKey, nextMasterKey);
-    timesyncHash.digestBlock(nextTimesyncKey, nextMasterKey);
+    uplinkHash.digestBlock(nextUplinkKey, nextMasterKey.get());
+    downlinkHash.digestBlock(nextDownlinkKey, nextMasterKey.get());
+    timesyncHash.digestBlock(nextTimesyncKey, nextMasterKey.get());
 
 }
 
@@ -75,12 +73,10 @@ void DynamicKeyManager::startRekeying() {
  */
 void DynamicKeyManager::applyRekeying() { 
     if (status == KeyManagerStatus::REKEYING_UNTRUSTED) {
-        tempMasterIndex = nextMasterIndex;
-        memcpy(tempMasterKey, nextMasterKey, 16);
+        tempMasterKey = nextMasterKey;
         status = KeyManagerStatus::MASTER_UNTRUSTED;
     } else if (status == KeyManagerStatus::REKEYING) {
-        masterIndex = nextMasterIndex;
-        memcpy(masterKey, nextMasterKey, 16);
+        masterKey = nextMasterKey;
         status = KeyManagerStatus::CONNECTED;
     } else {
         printf("DynamicKeyManager: unexpected call to applyRekeying\n");
@@ -98,11 +94,11 @@ void DynamicKeyManager::applyRekeying() {
 
 void* DynamicKeyManager::getMasterKey() {
     switch (status) {
-        case KeyManagerStatus::MASTER_UNTRUSTED: return tempMasterKey;
-        case KeyManagerStatus::REKEYING_UNTRUSTED: return tempMasterKey;
-        case KeyManagerStatus::CONNECTED: return masterKey;
-        case KeyManagerStatus::REKEYING: return masterKey;
-        case KeyManagerStatus::ADVANCING: return tempMasterKey;
+        case KeyManagerStatus::MASTER_UNTRUSTED: return tempMasterKey.get();
+        case KeyManagerStatus::REKEYING_UNTRUSTED: return tempMasterKey.get();
+        case KeyManagerStatus::CONNECTED: return masterKey.get();
+        case KeyManagerStatus::REKEYING: return masterKey.get();
+        case KeyManagerStatus::ADVANCING: return tempMasterKey.get();
         default: {
             printf("DynamicKeyManager: unexpected call to getMasterKey\n");
             assert(false);
@@ -112,8 +108,8 @@ void* DynamicKeyManager::getMasterKey() {
 
 void* DynamicKeyManager::getNextMasterKey() {
     switch (status) {
-        case KeyManagerStatus::REKEYING_UNTRUSTED: return nextMasterKey;
-        case KeyManagerStatus::REKEYING: return nextMasterKey;
+        case KeyManagerStatus::REKEYING_UNTRUSTED: return nextMasterKey.get();
+        case KeyManagerStatus::REKEYING: return nextMasterKey.get();
         default: {
             printf("DynamicKeyManager: unexpected call to getNextMasterKey\n");
             assert(false);
@@ -123,12 +119,12 @@ void* DynamicKeyManager::getNextMasterKey() {
 
 unsigned int DynamicKeyManager::getMasterIndex() {
     switch (status) {
-        case KeyManagerStatus::DISCONNECTED: return masterIndex;
-        case KeyManagerStatus::MASTER_UNTRUSTED: return tempMasterIndex;
-        case KeyManagerStatus::REKEYING_UNTRUSTED: return tempMasterIndex;
-        case KeyManagerStatus::CONNECTED: return masterIndex;
-        case KeyManagerStatus::REKEYING: return masterIndex;
-        case KeyManagerStatus::ADVANCING: return tempMasterIndex;
+        case KeyManagerStatus::DISCONNECTED: return masterKey.getIndex();
+        case KeyManagerStatus::MASTER_UNTRUSTED: return tempMasterKey.getIndex();
+        case KeyManagerStatus::REKEYING_UNTRUSTED: return tempMasterKey.getIndex();
+        case KeyManagerStatus::CONNECTED: return masterKey.getIndex();
+        case KeyManagerStatus::REKEYING: return masterKey.getIndex();
+        case KeyManagerStatus::ADVANCING: return tempMasterKey.getIndex();
         default: assert(false);
     }
 }
@@ -196,25 +192,22 @@ void DynamicKeyManager::sendChallenge() {
 
 bool DynamicKeyManager::attemptResync(unsigned int newIndex) {
     if (status != KeyManagerStatus::DISCONNECTED) return false;
-    if (newIndex < masterIndex) return false;
-    if (newIndex - masterIndex > maxIndexDelta) return false;
+    if (newIndex < masterKey.getIndex()) return false;
+    if (newIndex - masterKey.getIndex() > maxIndexDelta) return false;
 
-    memcpy(tempMasterKey, masterKey, 16);
-    for (unsigned int i = masterIndex ; i < newIndex; i++) {
-        masterHash.digestBlock(tempMasterKey, tempMasterKey);
-    }
-    tempMasterIndex = newIndex;
+    unsigned int hashes = masterChain.advance(tempMasterKey, masterKey, newIndex);
 
     if(ENABLE_CRYPTO_KEY_MGMT_DBG) {
-        print_dbg("[KM] N=%d attempting resync\n", myId);
+        print_dbg("[KM] N=%d attempting resync (%u indexes, %u hashes)\n", myId,
+                  newIndex - masterKey.getIndex(), hashes);
     }
 
     status = KeyManagerStatus::MASTER_UNTRUSTED;
     streamMgr.untrustMaster();
 
-    uplinkHash.digestBlock(uplinkKey, tempMasterKey);
-    downlinkHash.digestBlock(downlinkKey, tempMasterKey);
-    timesyncHash.digestBlock(timesyncKey, tempMasterKey);
+    uplinkHash.digestBlock(uplinkKey, tempMasterKey.get());
+    downlinkHash.digestBlock(downlinkKey, tempMasterKey.get());
+    timesyncHash.digestBlock(timesyncKey, tempMasterKey.get());
     uplinkOCB.rekey(uplinkKey);
     downlinkOCB.rekey(downlinkKey);
     timesyncOCB.rekey(timesyncKey);
@@ -233,12 +226,11 @@ void DynamicKeyManager::advanceResync() {
         print_dbg("[KM] N=%d advancing resync\n", myId);
     }
 
-    masterHash.digestBlock(tempMasterKey, tempMasterKey);
-    tempMasterIndex++;
+    masterChain.next(tempMasterKey, tempMasterKey);
 
-    uplinkHash.digestBlock(uplinkKey, tempMasterKey);
-    downlinkHash.digestBlock(downlinkKey, tempMasterKey);
-    timesyncHash.digestBlock(timesyncKey, tempMasterKey);
+    uplinkHash.digestBlock(uplinkKey, tempMasterKey.get());
+    downlinkHash.digestBlock(downlinkKey, tempMasterKey.get());
+    timesyncHash.digestBlock(timesyncKey, tempMasterKey.get());
     uplinkOCB.rekey(uplinkKey);
     downlinkOCB.rekey(downlinkKey);
     timesyncOCB.rekey(timesyncKey);
@@ -271,8 +263,7 @@ void DynamicKeyManager::commitResync() {
     } else if(status == KeyManagerStatus::REKEYING_UNTRUSTED) {
         status = KeyManagerStatus::REKEYING;
     }
-    memcpy(masterKey, tempMasterKey, 16);
-    masterIndex = tempMasterIndex;
+    masterKey = tempMasterKey;
     streamMgr.trustMaster();
 }
 
@@ -296,11 +287,10 @@ void DynamicKeyManager::attemptAdvance() {
      * phase will be executed while in state ADVANCING, we only derive the
      * timesync key here.
      */
-    masterHash.digestBlock(tempMasterKey, masterKey);
+    masterChain.next(tempMasterKey, masterKey);
     status = KeyManagerStatus::ADVANCING;
-    tempMasterIndex = masterIndex + 1;
 
-    timesyncHash.digestBlock(timesyncKey, tempMasterKey);
+    timesyncHash.digestBlock(timesyncKey, tempMasterKey.get());
     timesyncOCB.rekey(timesyncKey);
 }
 
@@ -311,15 +301,14 @@ void DynamicKeyManager::commitAdvance() {
         print_dbg("[KM] N=%d committing advance\n", myId);
     }
 
-    memcpy(masterKey, tempMasterKey, 16);
-    masterIndex = tempMasterIndex;
+    masterKey = tempMasterKey;
     status = KeyManagerStatus::CONNECTED;
 
     /**
      * Compute phase keys. Timesync has already been computed.
      */
-    uplinkHash.digestBlock(uplinkKey, masterKey);
-    downlinkHash.digestBlock(downlinkKey, masterKey);
+    uplinkHash.digestBlock(uplinkKey, masterKey.get());
+    downlinkHash.digestBlock(downlinkKey, masterKey.get());
     uplinkOCB.rekey(uplinkKey);
     downlinkOCB.rekey(downlinkKey);
 }
@@ -331,11 +320,11 @@ void DynamicKeyManager::rollbackAdvance() {
         print_dbg("[KM] N=%d aborting advance\n", myId);
     }
 
-    // rollback to the values of masterKey and masterIndex 
+    // rollback to the value of masterKey
     status = KeyManagerStatus::CONNECTED;
 
     /* restore last valid timesync key */
-    timesyncHash.digestBlock(timesyncKey, masterKey);
+    timesyncHash.digestBlock(timesyncKey, masterKey.get());
     timesyncOCB.rekey(timesyncKey);
 }
 
@@ -367,7 +356,7 @@ bool DynamicKeyManager::verifyResponse(ResponseElement response) {
     const unsigned char *bytes = response.getResponseBytes();
     unsigned char key[16];
     unsigned char solution[16];
-    xorBytes(key, tempMasterKey, challengeSecret, 16);
+    xorBytes(key, tempMasterKey.get(), challengeSecret, 16);
     Aes aes(key);
     aes.ecbEncrypt(solution, chal);
     bool valid = true;
@@ -133,19 +133,19 @@ private:
      */
     void resendChallenge();
 
-    /* Maximum index advancement when attempting resync */
+    /* Maximum index advancement when attempting resync, that with the
+     * MasterKeyChain takes a few hundred hashes at most */
     const unsigned maxIndexDelta = 600000;
     const unsigned char myId;
     const bool sendChallenges;
     /**
      * Temporary values for master key and index.
      * These values are computed and used, but not yet committed. Committing
-     * them consists in copying these values to masterKey and masterIndex.
+     * them consists in copying these values to masterKey.
      * Committing sets the context status to CONNECTED, meaning we have reached
      * a point where the master index advancement is completely verified.
      */
-    unsigned char tempMasterKey[16];
-    unsigned int tempMasterIndex;
+    MasterKey tempMasterKey;
 
     const bool doChallengeResponse;
     const unsigned int challengeTimeout;
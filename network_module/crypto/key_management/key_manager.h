@@ -28,6 +28,7 @@
 #pragma once
 #include "../aes_ocb.h"
 #include "../hash.h"
+#include "master_key_chain.h"
 #include "../../stream/stream_manager.h"
 #include "../../scheduler/schedule_element.h"
 
@@ -101,12 +102,12 @@ public:
      * Load last Master Key and Index from persistent memory (TODO)
      */
     void loadMasterKey() {
-        masterIndex = 0;
+        masterChain.init(masterKey, rootMasterKey);
 
         // Initialize phase OCBs
-        uplinkHash.digestBlock(uplinkKey, masterKey);
-        downlinkHash.digestBlock(downlinkKey, masterKey);
-        timesyncHash.digestBlock(timesyncKey, masterKey);
+        uplinkHash.digestBlock(uplinkKey, masterKey.get());
+        downlinkHash.digestBlock(downlinkKey, masterKey.get());
+        timesyncHash.digestBlock(timesyncKey, masterKey.get());
         uplinkOCB.rekey(uplinkKey);
         downlinkOCB.rekey(downlinkKey);
         timesyncOCB.rekey(timesyncKey);
@@ -169,8 +170,6 @@ protected:
 
     KeyManagerStatus status;
 
-    unsigned int masterIndex;
-    unsigned int nextMasterIndex;
 
     /**
      * Value of the secret key used for challenge-respose authentication of
@@ -188,23 +187,16 @@ protected:
         };
 
     /**
-     * Value of the first master key. This value is SECRET and hardcoding it
+     * Root of the master key chain. This value is SECRET and hardcoding it
      * is meant as a temporary solution.
      */
-    unsigned char masterKey[16] = {
+    const unsigned char rootMasterKey[16] = {
                 0x4d, 0x69, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74,
                 0x4d, 0x69, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74
         };
-    unsigned char nextMasterKey[16];
-    /**
-     * IV for the Miyaguchi-Preneel Hash used for rotating the master key.
-     * Value for this constant is arbitrary and is NOT secret.
-     */
-    const unsigned char masterRotationIv[16] = {
-                0x6d, 0x61, 0x73, 0x74, 0x65, 0x72, 0x49, 0x56,
-                0x6d, 0x61, 0x73, 0x74, 0x65, 0x72, 0x49, 0x56
-        };
-    SingleBlockMPHash masterHash = SingleBlockMPHash(masterRotationIv);
+    MasterKey masterKey;
+    MasterKey nextMasterKey;
+    MasterKeyChain masterChain;
 
     /*
      * Timesync: key, next key, current valid OCB, hash for
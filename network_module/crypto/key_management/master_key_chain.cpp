@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "master_key_chain.h"
+#include <cstring>
+
+namespace mxnet {
+
+MasterKeyChain::MasterKeyChain() {
+    /**
+     * IVs for the Miyaguchi-Preneel Hashes of each level, that only differ
+     * in the last byte. Values for these constants are arbitrary and are NOT
+     * secret.
+     */
+    unsigned char chainIv[16] = {
+                0x6d, 0x61, 0x73, 0x74, 0x65, 0x72, 0x43, 0x68,
+                0x61, 0x69, 0x6e, 0x4c, 0x65, 0x76, 0x65, 0x00
+        };
+    unsigned char restartIv[16] = {
+                0x6d, 0x61, 0x73, 0x74, 0x65, 0x72, 0x52, 0x65,
+                0x73, 0x74, 0x61, 0x72, 0x74, 0x4c, 0x76, 0x00
+        };
+    for(unsigned int i = 0; i < MasterKey::levels; i++) {
+        chainIv[15] = i;
+        chainHash[i].setIv(chainIv);
+    }
+    for(unsigned int i = 0; i < MasterKey::levels - 1; i++) {
+        restartIv[15] = i;
+        restartHash[i].setIv(restartIv);
+    }
+}
+
+void MasterKeyChain::init(MasterKey& key, const unsigned char rootKey[16]) {
+    const unsigned int top = MasterKey::levels - 1;
+    key.index = 0;
+    memcpy(key.keys[top], rootKey, 16);
+    for(int l = top; l > 0; l--) {
+        restartHash[l - 1].digestBlock(key.keys[l - 1], key.keys[l]);
+        chainHash[l].digestBlock(key.keys[l], key.keys[l]);
+    }
+}
+
+unsigned int MasterKeyChain::advance(MasterKey& result, const MasterKey& key, unsigned int newIndex) {
+    if(&result != &key) result = key;
+    if(newIndex <= key.index) return 0;
+
+    // Find the highest level whose digit changes, lower levels restart
+    int level = MasterKey::levels - 1;
+    while((key.index >> (level * fanoutBits)) == (newIndex >> (level * fanoutBits)))
+        level--;
+
+    // Upper level keys are already one position ahead in their chain
+    unsigned int hashes = 0;
+    unsigned int first = digit(key.index, level) + (level > 0 ? 1 : 0);
+    for(unsigned int i = first; i < digit(newIndex, level); i++) {
+        chainHash[level].digestBlock(result.keys[level], result.keys[level]);
+        hashes++;
+    }
+    for(int l = level; l > 0; l--) {
+        restartHash[l - 1].digestBlock(result.keys[l - 1], result.keys[l]);
+        chainHash[l].digestBlock(result.keys[l], result.keys[l]);
+        hashes += 2;
+        for(unsigned int i = 0; i < digit(newIndex, l - 1); i++) {
+            chainHash[l - 1].digestBlock(result.keys[l - 1], result.keys[l - 1]);
+            hashes++;
+        }
+    }
+    result.index = newIndex;
+    return hashes;
+}
+
+} //namespace mxnet
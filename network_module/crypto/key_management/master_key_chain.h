@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "../hash.h"
+
+namespace mxnet {
+
+/**
+ * A value of the master key, together with its index and the keys of the
+ * upper levels of the MasterKeyChain needed to derive the next ones
+ */
+class MasterKey {
+public:
+    static const unsigned int levels = 3;
+
+    /**
+     * \return a pointer to the 16-byte buffer containing the master key
+     */
+    unsigned char *get() { return keys[0]; }
+    const unsigned char *get() const { return keys[0]; }
+
+    unsigned int getIndex() const { return index; }
+
+    /**
+     * \param level a level of the MasterKeyChain, 0 being the master key
+     * \return a pointer to the 16-byte key stored for that level
+     */
+    const unsigned char *getLevelKey(unsigned int level) const { return keys[level]; }
+
+private:
+    friend class MasterKeyChain;
+
+    unsigned int index = 0;
+    // keys[0] is the master key, keys[levels-1] the top level key. The upper
+    // levels are one position ahead of the digit of index in their chain
+    unsigned char keys[levels][16];
+};
+
+/**
+ * Derives the sequence of master keys from a root key.
+ *
+ * Instead of a single hash chain, where reaching index n from index m takes
+ * n-m hashes, the master index is split in MasterKey::levels digits of
+ * fanoutBits bits, the top one being unbounded. Each level is a hash chain
+ * advanced once per increment of its digit, and restarted from a key derived
+ * from the upper level when its digit wraps around. The master key is the key
+ * of the lowest level.
+ *
+ * Moving forward by any amount takes at most fanout + 1 hashes per level,
+ * plus one hash per increment of the top digit.
+ *
+ * A MasterKey also holds the upper level keys, so these must not allow to
+ * compute earlier master keys either. Once an upper level key has been used
+ * to restart the lower level, it is replaced by the following key of its
+ * chain. The restart key of the current lower level chain can then no longer
+ * be computed, and neither can any master key preceding the current one.
+ */
+class MasterKeyChain {
+public:
+    static const unsigned int fanoutBits = 7;
+    static const unsigned int fanout = 1 << fanoutBits;
+
+    MasterKeyChain();
+
+    /**
+     * \param key the master key to initialize at index 0
+     * \param rootKey the 16-byte root key of the chain
+     */
+    void init(MasterKey& key, const unsigned char rootKey[16]);
+
+    /**
+     * Compute the master key following another one
+     * \param result the master key at the index of key plus one
+     * \param key the current master key. Can be the same object as result
+     */
+    void next(MasterKey& result, const MasterKey& key) { advance(result, key, key.index + 1); }
+
+    /**
+     * Compute a following master key
+     * \param result the master key at index newIndex
+     * \param key the current master key. Can be the same object as result
+     * \param newIndex index of the master key to compute, not less than the
+     * index of key
+     * \return the number of hashes computed
+     */
+    unsigned int advance(MasterKey& result, const MasterKey& key, unsigned int newIndex);
+
+private:
+    static unsigned int digit(unsigned int index, unsigned int level) {
+        index >>= level * fanoutBits;
+        return level == MasterKey::levels - 1 ? index : index & (fanout - 1);
+    }
+
+    // Advance the chain of each level
+    SingleBlockMPHash chainHash[MasterKey::levels];
+    // Restart the chain of each level from the upper level
+    SingleBlockMPHash restartHash[MasterKey::levels - 1];
+};
+
+} //namespace mxnet
@@ -44,17 +44,16 @@ void MasterKeyManager::startRekeying() {
         print_dbg("[KM] N=0 starting rekeying\n");
     }
 
-    masterHash.digestBlock(nextMasterKey, masterKey);
-    nextMasterIndex = masterIndex + 1;
+    masterChain.next(nextMasterKey, masterKey);
     status = KeyManagerStatus::REKEYING;
 
-    uplinkHash.digestBlock(nextUplinkKey, nextMasterKey);
-    downlinkHash.digestBlock(nextDownlinkKey, nextMasterKey);
-    timesyncHash.digestBlock(nextTimesyncKey, nextMasterKey);
+    uplinkHash.digestBlock(nextUplinkKey, nextMasterKey.get());
+    downlinkHash.digestBlock(nextDownlinkKey, nextMasterKey.get());
+    timesyncHash.digestBlock(nextTimesyncKey, nextMasterKey.get());
 
     /* Also prepare the stream manager for rekeying */
     unsigned char nextIv[16];
-    firstBlockStreamHash.digestBlock(nextIv, nextMasterKey);
+    firstBlockStreamHash.digestBlock(nextIv, nextMasterKey.get());
     streamMgr.setSecondBlockHash(nextIv);
     memset(nextIv, 0, 16);
 }
@@ -69,8 +68,7 @@ void MasterKeyManager::applyRekeying() {
         print_dbg("[KM] N=0 applying rekeying\n");
     }
 
-    masterIndex = nextMasterIndex;
-    memcpy(masterKey, nextMasterKey, 16);
+    masterKey = nextMasterKey;
     status = KeyManagerStatus::CONNECTED;
 
     uplinkOCB.rekey(nextUplinkKey);
@@ -80,8 +78,8 @@ void MasterKeyManager::applyRekeying() {
 
 void* MasterKeyManager::getMasterKey() {
     switch (status) {
-        case KeyManagerStatus::CONNECTED: return masterKey;
-        case KeyManagerStatus::REKEYING: return masterKey;
+        case KeyManagerStatus::CONNECTED: return masterKey.get();
+        case KeyManagerStatus::REKEYING: return masterKey.get();
         default: {
             printf("MasterKeyManager: unexpected call to getMasterKey\n");
             assert(false);
@@ -91,7 +89,7 @@ void* MasterKeyManager::getMasterKey() {
 
 void* MasterKeyManager::getNextMasterKey() {
     switch (status) {
-        case KeyManagerStatus::REKEYING: return nextMasterKey;
+        case KeyManagerStatus::REKEYING: return nextMasterKey.get();
         default: {
             printf("MasterKeyManager: unexpected call to getNextMasterKey\n");
             assert(false);
@@ -101,8 +99,8 @@ void* MasterKeyManager::getNextMasterKey() {
 
 unsigned int MasterKeyManager::getMasterIndex() {
     switch (status) {
-        case KeyManagerStatus::CONNECTED: return masterIndex;
-        case KeyManagerStatus::REKEYING: return masterIndex;
+        case KeyManagerStatus::CONNECTED: return masterKey.getIndex();
+        case KeyManagerStatus::REKEYING: return masterKey.getIndex();
         default: {
             printf("MasterKeyManager: unexpected call to getMasterIndex\n");
             assert(false);
@@ -130,7 +128,7 @@ std::vector<ResponseElement> MasterKeyManager::solveChallengesAndGetResponses()
     result.reserve(maxSolvesPerSlot);
     unsigned char key[16];
     unsigned char response[16];
-    xorBytes(key, masterKey, challengeSecret, 16);
+    xorBytes(key, masterKey.get(), challengeSecret, 16);
     Aes aes(key);
 
     unsigned int solved = 0;
@@ -45,13 +45,12 @@ public:
              *
             unsigned how_many = 10000;
             for (unsigned i=0; i<how_many; i++) {
-                masterHash.digestBlock(masterKey, masterKey);
+                masterChain.next(masterKey, masterKey);
             }
-            masterIndex = how_many;
 
-            uplinkHash.digestBlock(uplinkKey, masterKey);
-            downlinkHash.digestBlock(downlinkKey, masterKey);
-            timesyncHash.digestBlock(timesyncKey, masterKey);
+            uplinkHash.digestBlock(uplinkKey, masterKey.get());
+            downlinkHash.digestBlock(downlinkKey, masterKey.get());
+            timesyncHash.digestBlock(timesyncKey, masterKey.get());
             uplinkOCB.rekey(uplinkKey);
             downlinkOCB.rekey(downlinkKey);
             timesyncOCB.rekey(timesyncKey);
@@ -27,6 +27,8 @@
 
 #include "dataphase.h"
 #include "../util/debug_settings.h"
+#include "../util/trace.h"
+#include "../uplink_phase/uplink_phase.h"
 #include <unistd.h>
 #ifdef CRYPTO
 #include "../crypto/aes_ocb.h"
@@ -50,26 +52,26 @@ void DataPhase::execute(long long slotStart) {
     usleep(1000);
 #endif
     try {
+        const ExplicitScheduleElement& e = currentSchedule.at(slotIndex);
         // Schedule playback
-        switch(currentSchedule.at(slotIndex).getAction()){
+        switch(e.getAction()){
         case Action::SLEEP:
             this->sleep(slotStart);
             break;
         case Action::SENDSTREAM:
-            sendFromStream(slotStart, currentSchedule.at(slotIndex).getStreamId());
+            sendFromStream(slotStart, e);
             break;
         case Action::RECVSTREAM:
-            receiveToStream(slotStart, currentSchedule.at(slotIndex).getStreamId());
+            receiveToStream(slotStart, e);
             break;
         case Action::SENDBUFFER:
-            sendFromBuffer(slotStart, currentSchedule.at(slotIndex).getBuffer(),
-                                    currentSchedule.at(slotIndex).getStreamId());
+            sendFromBuffer(slotStart, e.getBuffer(), e.getStreamId());
             break;
         case Action::RECVBUFFER:
-            receiveToBuffer(slotStart, currentSchedule.at(slotIndex).getBuffer(),
-                                    currentSchedule.at(slotIndex).getStreamId());
+            receiveToBuffer(slotStart, e.getBuffer(), e.getStreamId());
             break;
         }
+        notifyStreams();
         incrementSlot();
     } catch(...) {
         incrementSlot(); //Do not forget to increment the slot
@@ -84,22 +86,37 @@ void DataPhase::advance(long long slotStart) {
         return;
     }
     try {
-        StreamId id = currentSchedule.at(slotIndex).getStreamId();
-        Packet pkt;
-        switch(currentSchedule.at(slotIndex).getAction()){
+        const ExplicitScheduleElement& e = currentSchedule.at(slotIndex);
+        Stream *s = boundStream(e);
+        PooledPacket pkt;
+        switch(e.getAction()){
         case Action::SLEEP:
             this->sleep(slotStart);
             break;
         case Action::SENDSTREAM:
-            stream.sendPacket(id, pkt);
+            if(s) {
+                s->sendPacket(pkt);
+                deferNotify(e.getStream());
+            }
             break;
         case Action::RECVSTREAM:
-            stream.missPacket(id);
+            if(s) {
+                s->missPacket();
+                deferNotify(e.getStream());
+            }
+            break;
+        case Action::RECVBUFFER:
+            // With early termination a non empty buffer is never overwritten,
+            // do not forward a stale packet of a period we did not receive
+            if(earlyTermination && e.getBuffer())
+                e.getBuffer()->clear();
+            this->sleep(slotStart);
             break;
         default:
             this->sleep(slotStart);
             break;
         }
+        notifyStreams();
         incrementSlot();
     } catch(...) {
         incrementSlot(); //Do not forget to increment the slot
@@ -111,75 +128,128 @@ void DataPhase::sleep(long long slotStart) {
     ctx.sleepUntil(slotStart);
 }
 
-void DataPhase::sendFromStream(long long slotStart, StreamId id) {
-    Packet pkt;
-    bool pktReady;
+void DataPhase::sendFromStream(long long slotStart, const ExplicitScheduleElement& e) {
+    StreamId id = e.getStreamId();
+    Stream *s = boundStream(e);
+    // NOTE: the packet is shared with the stream, no copy is made
+    PooledPacket pkt;
+    bool pktReady = false;
+    long long prepareStart = calibrate ? getTime() : 0;
 
+    if(s == nullptr) {
+        // Stream closed or not present when the schedule was applied
+    }
 #ifdef CRYPTO
-    if (config.getAuthenticateDataMessages()) {
-        unsigned long long seqNo = stream.getSequenceNumber(id);
+    else if (config.getAuthenticateDataMessages()) {
+        unsigned long long seqNo = s->getSequenceNumber();
+        AesOcb& ocb = s->getOCB();
+        unsigned int masterIndex = ctx.getKeyManager()->getMasterIndex();
+
+        if (ENABLE_CRYPTO_DATA_DBG)
+            print_dbg("[D] sendFromStream: FrameNumber = %u, seqNo = %llu, mIndex = %u\n",
+                      dataSuperframeNumber, seqNo, masterIndex);
+        // The nonce is known in advance, prepare it before waiting so that
+        // only the data dependent crypto code is left close to the slot
+        ocb.setNonce(dataSuperframeNumber, seqNo, masterIndex);
         // time needed to execute the following crypto code
         const long long cryptoExecTime = 110000; // 110 us
         // wait until slightly before the slotStart, with an advance equal
         // to the time needed to execute the following crypto code + the
         // execution time of the callbacks (if used)
-        pkt.waitUntilSendTime(ctx, slotStart, cryptoExecTime + config.getCallbacksExecutionTime());
+        Packet::waitUntilSendTime(ctx, slotStart, cryptoExecTime + config.getCallbacksExecutionTime());
+        if(calibrate) prepareStart = getTime();
         /**
          * NOTE: sendPacket must be called after getSequenceNumber, because
          * sendPacket advances the sequence numbers too.
          */
-        pktReady = stream.sendPacket(id, pkt);
-        if (pktReady) {
-            AesOcb& ocb = stream.getStreamOCB(id);
-            unsigned int masterIndex = ctx.getKeyManager()->getMasterIndex();
-
-            if (ENABLE_CRYPTO_DATA_DBG)
-                print_dbg("[D] sendFromStream: FrameNumber = %u, seqNo = %llu, mIndex = %u\n",
-                          dataSuperframeNumber, seqNo, masterIndex);
-            ocb.setNonce(dataSuperframeNumber, seqNo, masterIndex);
-
-            if (config.getEncryptDataMessages()) pkt.encryptAndPutTag(ocb);
-            else pkt.putTag(ocb);
+        pktReady = s->sendPacket(pkt);
+        /**
+         * NOTE: encryption is done in place on the stream packet. Redundant
+         * copies within the same period share the same nonce, so the packet
+         * is encrypted only the first time and then resent as is.
+         */
+        if (pktReady && pkt->hasReservedTag()) {
+            if (config.getEncryptDataMessages()) pkt->encryptAndPutTag(ocb);
+            else pkt->putTag(ocb);
         }
     } else {
-        pktReady = stream.sendPacket(id, pkt);
+        pktReady = s->sendPacket(pkt);
     }
 #else
-    pkt.waitUntilSendTime(ctx, slotStart, config.getCallbacksExecutionTime());
-    pktReady = stream.sendPacket(id, pkt);
+    else {
+        Packet::waitUntilSendTime(ctx, slotStart, config.getCallbacksExecutionTime());
+        if(calibrate) prepareStart = getTime();
+        pktReady = s->sendPacket(pkt);
+    }
 #endif
+    if(calibrate && pktReady)
+        ctx.getSlotCalibration().add(SlotCalibration::DATA_PREPARE, getTime() - prepareStart);
 
+    if(s) deferNotify(e.getStream());
     if(pktReady) {
+        unsigned int smeBytes = putSMEs(*pkt, id);
         // TODO: should be moved before waitUntilSendTime() call
         ctx.configureTransceiver(ctx.getTransceiverConfig());
-        pkt.sendWithoutWaiting(ctx, slotStart);
+        pkt->sendWithoutWaiting(ctx, slotStart);
         ctx.transceiverIdle();
-        if(ENABLE_DATA_INFO_DBG) {
-            auto nt = NetworkTime::fromLocalTime(slotStart);
-            if(COMPRESSED_DBG==false)
-                print_dbg("[D] Node %d: Sent packet for stream (%d,%d) NT=%lld\n", myId, id.src, id.dst, nt.get());
-            else
-                print_dbg("[D] s (%d,%d) NT=%lld\n", id.src, id.dst, nt.get());
-        }
+        // Redundant copies are sent from the same packet
+        removeSMEs(*pkt, smeBytes);
+        if(ENABLE_DATA_INFO_DBG)
+            trace_dbg(TraceEvent::DATA_SENT, myId, id.src, id.dst,
+                      NetworkTime::fromLocalTime(slotStart).get());
+        calibrateProcessing(slotStart, MACContext::radioTime(pkt->size()));
     }
     else {
-        if(ENABLE_DATA_INFO_DBG) {
-            auto nt = NetworkTime::fromLocalTime(slotStart);
-            if(COMPRESSED_DBG==false) {
-                print_dbg("[D] Node %d: no packet ready to send for stream (%d,%d) NT=%llu\n", myId, id.src, id.dst, nt.get());
-            } else {
-                print_dbg("[D] x (%d,%d) NT=%lld\n", id.src, id.dst, nt.get());
-            }
-        }
+        if(ENABLE_DATA_INFO_DBG)
+            trace_dbg(TraceEvent::DATA_NOT_READY, myId, id.src, id.dst,
+                      NetworkTime::fromLocalTime(slotStart).get());
         this->sleep(slotStart);
     }
 }
 
-void DataPhase::receiveToStream(long long slotStart, StreamId id) {
-    Packet pkt;
-    ctx.configureTransceiver(ctx.getTransceiverConfig());
-    auto rcvResult = pkt.recv(ctx, slotStart);
-    ctx.transceiverIdle();
+void DataPhase::receiveToStream(long long slotStart, const ExplicitScheduleElement& e) {
+    StreamId id = e.getStreamId();
+    Stream *s = boundStream(e);
+    if(s == nullptr) {
+        // Stream closed or not present when the schedule was applied
+        this->sleep(slotStart);
+        return;
+    }
+    // A valid copy of this period was already received, keep the radio off
+    // during the remaining redundant copies
+    if(earlyTermination && s->hasReceived()) {
+        this->sleep(slotStart + radioTime);
+        s->missPacket();
+        deferNotify(e.getStream());
+        if(ENABLE_DATA_INFO_DBG)
+            trace_dbg(TraceEvent::DATA_SKIPPED, myId, id.src, id.dst,
+                      NetworkTime::fromLocalTime(slotStart).get());
+        return;
+    }
+#ifdef CRYPTO
+    // The nonce is known in advance, prepare it before receiving so that
+    // only the data dependent crypto code is left after the reception
+    if (config.getAuthenticateDataMessages()) {
+        unsigned int masterIndex = ctx.getKeyManager()->getMasterIndex();
+        if (ENABLE_CRYPTO_DATA_DBG)
+            print_dbg("[D] receiveToStream: FrameNumber = %u, seqNo = %llu, mIndex = %u\n",
+                      dataSuperframeNumber, s->getSequenceNumber(),
+                      masterIndex);
+        s->getOCB().setNonce(dataSuperframeNumber, s->getSequenceNumber(),
+                             masterIndex);
+    }
+#endif
+    // Receive directly in a pool packet, that will be handed to the stream
+    PooledPacket pkt = s->allocatePacket();
+    RecvResult rcvResult;
+    if(pkt) {
+        ctx.configureTransceiver(ctx.getTransceiverConfig());
+        if(combineCopies) rcvResult = pkt->recvKeepCorrupted(ctx, slotStart);
+        else rcvResult = pkt->recv(ctx, slotStart);
+        ctx.transceiverIdle();
+    } else {
+        print_dbg("[E] DataPhase::receiveToStream packet pool exhausted\n");
+    }
 
     // Always align the call to receivePacket() and missPacket()
     // with the readio time computed by the mac context.
@@ -191,75 +261,78 @@ void DataPhase::receiveToStream(long long slotStart, StreamId id) {
     this->sleep(slotStart + radioTime);
 
     bool periodEnd = false;
-    bool valid = true;
-    
-    // Time needed to decrypt packet
-    //long long decryptExecTime = 120000; // 120 us
-    
-    if(rcvResult.error == RecvResult::ErrorCode::OK && pkt.checkPanHeader(panId) == true) {
-#ifdef CRYPTO
-        if (config.getAuthenticateDataMessages()) {
-            AesOcb& ocb = stream.getStreamOCB(id);
-            unsigned int masterIndex = ctx.getKeyManager()->getMasterIndex();
-            if (ENABLE_CRYPTO_DATA_DBG)
-                print_dbg("[D] receiveToStream: FrameNumber = %u, seqNo = %llu, mIndex = %u\n",
-                          dataSuperframeNumber, stream.getSequenceNumber(id),
-                          masterIndex);
-            ocb.setNonce(dataSuperframeNumber, stream.getSequenceNumber(id),
-                      masterIndex);
-            if (config.getEncryptDataMessages()) valid &= pkt.verifyAndDecrypt(ocb);
-            else valid &= pkt.verify(ocb);
+    // Piggybacked SMEs are forwarded only if the packet is ours and valid
+    std::vector<StreamManagementElement> smes;
+    bool valid = rcvResult.error == RecvResult::ErrorCode::OK && extractSMEs(*pkt, smes) &&
+                 verifyStreamPacket(*pkt, s, id);
+    if(valid) enqueueSMEs(smes);
 
-            if (ENABLE_CRYPTO_DATA_DBG)
-                if (!valid) print_dbg("[D] receiveToStream: verify failed\n");
+    if(valid == false && combineCopies) {
+        if(rcvResult.error == RecvResult::ErrorCode::CRC_FAIL)
+            s->keepCorruptedCopy(pkt, rcvResult.rssi);
+        // No copy of this period received correctly, try recovering the
+        // packet from the corrupted ones. Their FCS is not available, so
+        // combining requires the OCB tag to verify the result. Recovered
+        // packets with piggybacked SMEs are dropped, as the SMEs are not
+        // covered by the tag
+        if(s->isLastCopy()) {
+            PooledPacket combined = s->combineCorruptedCopies();
+            if(combined && combined->hasPanHeaderTrailerFlag() == false &&
+               verifyStreamPacket(*combined, s, id)) {
+                pkt = combined;
+                valid = true;
+                if(ENABLE_DATA_INFO_DBG)
+                    trace_dbg(TraceEvent::DATA_RECOVERED, myId, id.src, id.dst, 0);
+            }
         }
-#endif
-        valid &= checkStreamId(pkt, id);
-    } else {
-        valid = false;
     }
 
     if (valid) {
-        periodEnd = stream.receivePacket(id, pkt);
-        if(ENABLE_DATA_INFO_DBG) {
-            auto nt = NetworkTime::fromLocalTime(slotStart);
-            if(COMPRESSED_DBG==false)
-                print_dbg("[D] Node %d: Received packet for stream (%d,%d) NT=%lld\n", myId, id.src, id.dst, nt.get());
-            else
-                print_dbg("[D] r (%d,%d) NT=%lld\n", id.src, id.dst, nt.get());
-        }
+        periodEnd = s->receivePacket(pkt);
+        if(ENABLE_DATA_INFO_DBG)
+            trace_dbg(TraceEvent::DATA_RECEIVED, myId, id.src, id.dst,
+                      NetworkTime::fromLocalTime(slotStart).get());
     } else {
         // Avoid overwriting valid data
-        periodEnd = stream.missPacket(id);
-        if(ENABLE_DATA_ERROR_DBG) {
-            auto nt = NetworkTime::fromLocalTime(slotStart);
-            if(COMPRESSED_DBG==false)
-                print_dbg("[D] Node %d: Missed packet for stream (%d,%d) NT=%lld\n", myId, id.src, id.dst, nt.get());
-            else
-                print_dbg("[D] m (%d,%d) NT=%lld\n", id.src, id.dst, nt.get());
-        }
+        periodEnd = s->missPacket();
+        if(ENABLE_DATA_ERROR_DBG)
+            trace_dbg(TraceEvent::DATA_MISSED, myId, id.src, id.dst,
+                      NetworkTime::fromLocalTime(slotStart).get());
     }
+    deferNotify(e.getStream());
     if(ENABLE_DATA_INFO_DBG || ENABLE_DATA_ERROR_DBG) {
         if(periodEnd)
-        {
-            if(COMPRESSED_DBG==false)
-                print_dbg("[D] Node %d: (%d,%d) --- \n", myId, id.src, id.dst);
-            else
-                print_dbg("[D] - (%d,%d)\n", id.src, id.dst);
-        }
+            trace_dbg(TraceEvent::DATA_PERIOD_END, myId, id.src, id.dst, 0);
     }
+    // The processing starts after the radio time of the largest packet
+    if(valid) calibrateProcessing(slotStart, radioTime);
+}
+
+void DataPhase::notifyStreams() {
+    // Remove the streams that have been notified, keeping the others
+    // to retry at the end of the next slot
+    auto it = std::remove_if(pendingNotify.begin(), pendingNotify.end(),
+                             [](const REF_PTR_STREAM& s) { return s->notify(); });
+    pendingNotify.erase(it, pendingNotify.end());
+    if(pollNotify && stream.notifyPollers())
+        pollNotify = false;
 }
 void DataPhase::sendFromBuffer(long long slotStart,
-                               std::shared_ptr<Packet> buffer, StreamId id) {
+                               const PooledPacket& buffer, StreamId id) {
     if(!buffer)
     {
         print_dbg("Error: DataPhase::sendFromBuffer no buffer\n");
         return;
     }
+    // NOTE: early termination does not apply here, the next hop may have
+    // missed the previous copies and there is no feedback telling otherwise
     if(buffer->empty()==false) {
+        unsigned int smeBytes = putSMEs(*buffer, id);
         ctx.configureTransceiver(ctx.getTransceiverConfig());
         buffer->send(ctx, slotStart);
         ctx.transceiverIdle();
+        removeSMEs(*buffer, smeBytes);
+        calibrateProcessing(slotStart, MACContext::radioTime(buffer->size()));
 
         incrementBufCtr(id);
         if(lastTransmission(id)) {
@@ -276,27 +349,120 @@ void DataPhase::sendFromBuffer(long long slotStart,
     }
 }
 void DataPhase::receiveToBuffer(long long slotStart,
-                                std::shared_ptr<Packet> buffer, StreamId id) {
+                                const PooledPacket& buffer, StreamId id) {
     if(!buffer)
     {
         print_dbg("Error: DataPhase::receiveToBuffer no buffer\n");
         return;
     }
+    // A valid copy of this period is already waiting to be forwarded, keep
+    // the radio off during the remaining redundant copies. The buffer is
+    // cleared after its last forwarding, so it is never stale here
+    if(earlyTermination && buffer->empty() == false) {
+        this->sleep(slotStart);
+        return;
+    }
     ctx.configureTransceiver(ctx.getTransceiverConfig());
     auto rcvResult = buffer->recv(ctx, slotStart);
     ctx.transceiverIdle();
-    if(rcvResult.error != RecvResult::ErrorCode::OK || buffer->checkPanHeader(panId) == false) {
+    std::vector<StreamManagementElement> smes;
+    if(rcvResult.error != RecvResult::ErrorCode::OK || extractSMEs(*buffer, smes) == false ||
+       buffer->checkPanHeader(panId, panSeqNo(id)) == false) {
         // Delete received packet if pan header doesn't match with our network
         buffer->clear();
+    } else {
+        enqueueSMEs(smes);
+        calibrateProcessing(slotStart, MACContext::radioTime(buffer->size()));
+    }
+}
+bool DataPhase::verifyStreamPacket(Packet& pkt, Stream *s, StreamId id) {
+    if(pkt.checkPanHeader(panId, panSeqNo(id)) == false)
+        return false;
+    bool valid = true;
+#ifdef CRYPTO
+    if (config.getAuthenticateDataMessages()) {
+        // The nonce was set by receiveToStream before the reception
+        AesOcb& ocb = s->getOCB();
+        if (config.getEncryptDataMessages()) valid &= pkt.verifyAndDecrypt(ocb);
+        else valid &= pkt.verify(ocb);
+
+        if (ENABLE_CRYPTO_DATA_DBG)
+            if (!valid) print_dbg("[D] receiveToStream: verify failed\n");
+    }
+#endif
+    valid &= checkStreamId(pkt, id);
+    return valid;
+}
+unsigned int DataPhase::putSMEs(Packet& pkt, StreamId id) {
+    // All hops of a stream directed to the master get closer to it
+    const unsigned int smeSize = StreamManagementElement::maxSize();
+    if(smeFastPath == false || id.dst != 0 || pkt.available() < smeSize + 1)
+        return 0;
+    auto smes = ctx.getUplink()->dequeueSMEs(std::min(255u, (pkt.available() - 1) / smeSize));
+    if(smes.empty())
+        return 0;
+    // The SMEs are followed by their number, and flagged in the panHeader
+    for(auto& sme : smes) sme.serialize(pkt);
+    unsigned char numSMEs = smes.size();
+    pkt.put(&numSMEs, sizeof(numSMEs));
+    pkt.setPanHeaderTrailerFlag(true);
+    if(ENABLE_DATA_INFO_DBG)
+        print_dbg("[D] N=%d %d SMEs piggybacked (%d,%d)\n", myId, numSMEs, id.src, id.dst);
+    return numSMEs * smeSize + sizeof(numSMEs);
+}
+
+void DataPhase::removeSMEs(Packet& pkt, unsigned int size) {
+    if(size == 0)
+        return;
+    pkt.discardFromEnd(size);
+    pkt.setPanHeaderTrailerFlag(false);
+}
+
+bool DataPhase::extractSMEs(Packet& pkt, std::vector<StreamManagementElement>& smes) {
+    if(smeFastPath == false || pkt.hasPanHeaderTrailerFlag() == false)
+        return true;
+    const unsigned int smeSize = StreamManagementElement::maxSize();
+    unsigned int numSMEs = pkt[pkt.size() - 1];
+    unsigned int trailerSize = numSMEs * smeSize + 1;
+    if(trailerSize > pkt.size() - panHeaderSize)
+        return false;
+    Packet trailer;
+    trailer.put(&pkt[pkt.size() - trailerSize], trailerSize - 1);
+    pkt.discardFromEnd(trailerSize);
+    pkt.setPanHeaderTrailerFlag(false);
+
+    for(unsigned int i = 0; i < numSMEs; i++) {
+        if(StreamManagementElement::validateInPacket(trailer, 0, config.getMaxNodes())) {
+            StreamManagementElement sme;
+            sme.deserialize(trailer);
+            smes.push_back(sme);
+        } else {
+            trailer.discard(smeSize);
+        }
     }
+    return true;
 }
-bool DataPhase::checkStreamId(Packet pkt, StreamId streamId) {
+
+void DataPhase::enqueueSMEs(const std::vector<StreamManagementElement>& smes) {
+    if(smes.empty())
+        return;
+    ctx.getUplink()->enqueueSMEs(smes);
+    if(ENABLE_DATA_INFO_DBG)
+        print_dbg("[D] N=%d %d SMEs received\n", myId, static_cast<int>(smes.size()));
+}
+
+bool DataPhase::checkStreamId(const Packet& pkt, StreamId streamId) {
+    // With compact header the stream tag has already been checked as part
+    // of the panHeader, and is covered by the OCB tag if data is authenticated
+    if(compactHeader)
+        return true;
     if(pkt.size() < 8)
         return false;
     // Check streamId inside packet without extracting it
     static_assert(sizeof(StreamId) == 3, "");
     // Read streamId bytes inside the packet
-    StreamId packetId = StreamId::fromBytes(&pkt[5]);
+    unsigned char idBytes[sizeof(StreamId)] = { pkt[5], pkt[6], pkt[7] };
+    StreamId packetId = StreamId::fromBytes(idBytes);
     return packetId == streamId;
 }
 
@@ -32,7 +32,9 @@
 #include "../downlink_phase/schedule_distribution.h"
 #include "../downlink_phase/timesync/networktime.h"
 #include "../stream/stream_manager.h"
+#include "explicit_schedule_element.h"
 #include "../util/align.h"
+#include <algorithm>
 
 namespace mxnet {
 /**
@@ -45,6 +47,11 @@ public:
     DataPhase(MACContext& ctx, StreamManager& str) : MACPhase(ctx),
                                                      config(ctx.getNetworkConfig()),
                                                      panId(ctx.getNetworkConfig().getPanId()),
+                                                     compactHeader(ctx.getNetworkConfig().getCompactDataHeader()),
+                                                     combineCopies(ctx.getNetworkConfig().getCombineRedundantCopies()),
+                                                     earlyTermination(ctx.getNetworkConfig().getEarlyTermination()),
+                                                     calibrate(ctx.getNetworkConfig().getCalibrateSlotTiming()),
+                                                     smeFastPath(ctx.getNetworkConfig().getSmeFastPath()),
                                                      myId(ctx.getNetworkId()),
                                                      stream(str), bufCtr() {};
     
@@ -62,6 +69,10 @@ public:
         incrementSlot(slots);
     }
     static unsigned long long getDuration(const NetworkConfiguration& netConfig) {
+        // A calibrated profile already accounts for callbacks and crypto
+        long long calibrated = netConfig.getSlotTimingProfile().getDataProcessingTime();
+        if(calibrated > 0)
+            return calibrated;
         // TODO: make configurable on maxDataPktSize
         // Callbacks execution time is considered two times to allocated enough
         // time also in the case in which the schedule contains an RX stream
@@ -99,19 +110,29 @@ public:
 
     /* Five possible actions, as described by the explicit schedule */
     void sleep(long long slotStart);
-    void sendFromStream(long long slotStart, StreamId id);
-    void receiveToStream(long long slotStart, StreamId id);
-    void sendFromBuffer(long long slotStart, std::shared_ptr<Packet> buffer, StreamId id);
-    void receiveToBuffer(long long slotStart, std::shared_ptr<Packet> buffer, StreamId id);
+    void sendFromStream(long long slotStart, const ExplicitScheduleElement& e);
+    void receiveToStream(long long slotStart, const ExplicitScheduleElement& e);
+    void sendFromBuffer(long long slotStart, const PooledPacket& buffer, StreamId id);
+    void receiveToBuffer(long long slotStart, const PooledPacket& buffer, StreamId id);
     /* Called from ScheduleDownlinkPhase class on the first downlink slot
      * of the new schedule, to replace the currentSchedule,
      * taking effect in the next dataphase */
-    void applySchedule(const std::vector<ExplicitScheduleElement>&& newSchedule,
+    void applySchedule(std::vector<ExplicitScheduleElement>&& newSchedule,
                        const std::map<StreamId, std::pair<unsigned char, unsigned char>>&& forwardedStreamCtr,
                        unsigned long newId, unsigned int newScheduleTiles,
                        unsigned long newActivationTile, unsigned int currentTile) {
         currentSchedule = std::move(newSchedule);
         bufCtr = std::move(forwardedStreamCtr);
+        scheduleStreams.clear();
+        for(auto& e : currentSchedule) {
+            const REF_PTR_STREAM& s = e.getStream();
+            if(s && std::find(scheduleStreams.begin(), scheduleStreams.end(), s) == scheduleStreams.end())
+                scheduleStreams.push_back(s);
+        }
+        // Each stream is in pendingNotify at most once, so the bound streams
+        // plus the ones still pending from the old schedule always fit, and
+        // deferNotify() never allocates during the slots
+        pendingNotify.reserve(pendingNotify.size() + scheduleStreams.size());
         setScheduleID(newId);
         setScheduleTiles(newScheduleTiles);
         slotIndex = 0;
@@ -152,8 +173,10 @@ private:
          */
         if(scheduleSlots != 0) {
             slotIndex += n;
-            //Reset sequence numbers across data superframes
-            if(slotIndex >= scheduleSlots) stream.resetSequenceNumbers();
+            //Reset sequence numbers across data superframes, through the
+            //bound streams so that the StreamManager mutex is not needed
+            if(slotIndex >= scheduleSlots)
+                for(auto& s : scheduleStreams) s->resetSequenceNumber();
             while (slotIndex >= scheduleSlots) {
                 slotIndex -= scheduleSlots;
                 dataSuperframeNumber++;
@@ -162,8 +185,45 @@ private:
             slotIndex = 0;
         }
     }
+    /* Account the time spent after the radio activity of a slot that
+       started at slotStart and kept the radio busy for radioBusy ns */
+    void calibrateProcessing(long long slotStart, long long radioBusy) {
+        if(calibrate)
+            ctx.getSlotCalibration().add(SlotCalibration::DATA_PROCESS,
+                                         miosix::getTime() - slotStart - radioBusy);
+    }
     // Check streamId inside packet without extracting it
-    bool checkStreamId(Packet pkt, StreamId streamId);
+    bool checkStreamId(const Packet& pkt, StreamId streamId);
+    // Check pan header, authentication tag and streamId of a packet
+    // received for a stream, decrypting it if needed. The nonce of the
+    // stream OCB must have already been set
+    bool verifyStreamPacket(Packet& pkt, Stream *s, StreamId id);
+    /* With the SME fast path, append pending SMEs to a packet of a stream
+     * directed to the master, in the bytes left free by the stream.
+     * Return the number of bytes appended */
+    unsigned int putSMEs(Packet& pkt, StreamId id);
+    /* Remove the SMEs appended by putSMEs() from a packet that is kept to
+     * be sent again */
+    void removeSMEs(Packet& pkt, unsigned int size);
+    /* Remove the SMEs appended to a received packet, if any, so that its
+     * panHeader and tag can be checked. The SMEs are returned in smes.
+     * Return false if the appended SMEs are malformed */
+    bool extractSMEs(Packet& pkt, std::vector<StreamManagementElement>& smes);
+    /* Enqueue the SMEs extracted from a valid packet to be forwarded toward
+     * the master */
+    void enqueueSMEs(const std::vector<StreamManagementElement>& smes);
+    /* Stream bound to a schedule element by the StreamManager, or nullptr if
+       the stream did not exist at schedule application or has been removed */
+    static Stream *boundStream(const ExplicitScheduleElement& e) {
+        const REF_PTR_STREAM& s = e.getStream();
+        if(!s || s->isDetached()) return nullptr;
+        return s.get();
+    }
+    /* Expected panHeader sequence number field of the packets of a stream,
+       it is the stream tag when using the compact header */
+    unsigned char panSeqNo(StreamId streamId) const {
+        return compactHeader ? streamId.getCompactTag() : 0xff;
+    }
 
     /* Sets the schedule lenght or DataSuperframeSize */
     void setScheduleTiles(unsigned int newScheduleTiles) {
@@ -180,10 +240,25 @@ private:
     bool lastTransmission(StreamId id);
     void resetBufCtr(StreamId id);
 
+    /* Called after a stream slot, to notify the application later */
+    void deferNotify(const REF_PTR_STREAM& s) {
+        if(s->notificationPending() == false) return;
+        pollNotify = true;
+        if(std::find(pendingNotify.begin(), pendingNotify.end(), s) == pendingNotify.end())
+            pendingNotify.push_back(s);
+    }
+    /* Called at the end of every data slot, outside the timing critical part */
+    void notifyStreams();
+
     const NetworkConfiguration& config;
 
     /* Constant value from NetworkConfiguration */
     const unsigned short panId;
+    const bool compactHeader;
+    const bool combineCopies;
+    const bool earlyTermination;
+    const bool calibrate;
+    const bool smeFastPath;
     /* NetworkId of this node */
     unsigned char myId;
 
@@ -207,6 +282,14 @@ private:
      * group ends */
     std::map<StreamId, std::pair<unsigned char, unsigned char>> bufCtr;
 
+    /* Streams bound to currentSchedule, each listed once */
+    std::vector<REF_PTR_STREAM> scheduleStreams;
+    /* Streams that still have to wake up application threads, kept out of
+     * the slots so that the MAC never waits for the application */
+    std::vector<REF_PTR_STREAM> pendingNotify;
+    /* Set when threads blocked in StreamManager::waitAny() need a wakeup */
+    bool pollNotify = false;
+
     /**
      * Time needed to transmit a packet with size equal to the maximum allowed.
      */
@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "../scheduler/schedule_element.h"
+#include "../stream/stream.h"
+#include "../util/packet_pool.h"
+
+namespace mxnet {
+
+/**
+ * Action performed by a node in one data slot, obtained by expanding the
+ * schedule. SENDSTREAM and RECVSTREAM elements are bound to the Stream they
+ * refer to, SENDBUFFER and RECVBUFFER elements to the relay buffer
+ */
+class ExplicitScheduleElement {
+public:
+    ExplicitScheduleElement() {
+        action = Action::SLEEP;
+        stream = StreamInfo();
+    }
+    ExplicitScheduleElement(Action action, StreamInfo stream) :
+        action(action), stream(stream) {}
+    
+    Action getAction() const { return action; }
+    StreamId getStreamId() const { return stream.getStreamId(); }
+    StreamInfo getStreamInfo() const { return stream; }
+    
+    void setBuffer(const PooledPacket& buffer) { this->buffer=buffer; }
+    const PooledPacket& getBuffer() const { return buffer; }
+
+    /**
+     * Bind a SENDSTREAM or RECVSTREAM element to the stream it refers to.
+     * Called by StreamManager when the schedule is applied
+     */
+    void setStream(const REF_PTR_STREAM& s) { streamPtr=s; }
+    /**
+     * \return the stream bound to this element, or an empty pointer if the
+     * stream did not exist when the schedule was applied
+     */
+    const REF_PTR_STREAM& getStream() const { return streamPtr; }
+private:
+    Action action;
+    StreamInfo stream;
+    PooledPacket buffer;
+    REF_PTR_STREAM streamPtr;
+};
+
+} /* namespace mxnet */
@@ -28,6 +28,7 @@
 
 #include "dynamic_schedule_distribution.h"
 #include "../data_phase/dataphase.h"
+#include "../uplink_phase/uplink_phase.h"
 #include "../tdmh.h"
 #include "../util/packet.h"
 #include "../util/debug_settings.h"
@@ -141,6 +142,7 @@ void DynamicScheduleDownlinkPhase::desync()
     //TODO: check that dataPhase and streamManager DO CLEAR their schedule
     header = ScheduleHeader();
     schedule.clear();
+    uplinkNodes.clear();
     received.clear();
     incompleteScheduleCounter = 0;
 
@@ -447,6 +449,8 @@ void DynamicScheduleDownlinkPhase::initSchedule(SchedulePacket& spkt)
     header = spkt.getHeader();
     currentScheduleID = header.getScheduleID();
     schedule = spkt.getElements();
+    uplinkNodes.clear();
+    extractUplinkNodes(schedule);
     // Resize the received bool vector to the size of the new schedule
     received.clear();
     received.resize(header.getTotalPacket(), 0);
@@ -489,6 +493,7 @@ void DynamicScheduleDownlinkPhase::appendToSchedule(SchedulePacket& spkt, bool b
     // first time these elements are being received
     if(received.at(nextHeader.getCurrentPacket()) == 0) {
         std::vector<ScheduleElement> elements = spkt.getElements();
+        extractUplinkNodes(elements);
         schedule.insert(schedule.end(), elements.begin(), elements.end());
     }
     // Set current packet as received
@@ -524,6 +529,7 @@ void DynamicScheduleDownlinkPhase::setEmptySchedule(long long slotStart) {
 void DynamicScheduleDownlinkPhase::applyEmptySchedule(long long slotStart) {
     header = ScheduleHeader();
     schedule.clear();
+    uplinkNodes.clear();
     received.clear();
 
 #ifdef CRYPTO
@@ -535,6 +541,9 @@ void DynamicScheduleDownlinkPhase::applyEmptySchedule(long long slotStart) {
     ctx.getKeyManager()->applyRekeying();
 #endif
 
+    // Without the uplink nodes only the discovery uplink slots can be used
+    ctx.getUplink()->setUplinkGroups(std::vector<std::vector<unsigned char>>());
+
     auto currentTile = ctx.getCurrentTile(slotStart);
     dataPhase->applySchedule(std::vector<ExplicitScheduleElement>(),
                              std::map<StreamId, std::pair<unsigned char, unsigned char>>(),
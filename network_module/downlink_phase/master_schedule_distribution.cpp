@@ -155,10 +155,13 @@ void MasterScheduleDownlinkPhase::getScheduleAndComputeActivation(long long slot
 {
     unsigned long id;
     unsigned int tiles;
-    schedule_comp.getSchedule(schedule,id,tiles);
+    std::vector<std::vector<unsigned char>> groups;
+    schedule_comp.getSchedule(schedule,id,tiles,groups);
+    uplinkNodes = UplinkNodesElement::fromGroups(groups);
     unsigned int currentTile = ctx.getCurrentTile(slotStart);
     //NOTE: An empty schedule still requires 1 packet to send the scheduleHeader
-    unsigned int numPackets = std::max<unsigned int>(1,(schedule.size()+packetCapacity-1) / packetCapacity);
+    unsigned int numElements = schedule.size() + uplinkNodes.size();
+    unsigned int numPackets = std::max<unsigned int>(1,(numElements+packetCapacity-1) / packetCapacity);
 
     //Initialize sendingRounds
     sendingRounds = numPackets * scheduleRepetitions;
@@ -352,6 +355,13 @@ unsigned int MasterScheduleDownlinkPhase::getNumDownlinksForProcessing() {
     // leave at least one slot to change state.
     unsigned int hashesPerSlot = streamMgr->getMaxHashesPerSlot();
     rekeyingSlots = align(maxStreams, hashesPerSlot) / hashesPerSlot;
+    // With background rekeying keys are computed by a low priority thread,
+    // and the slots only let the MAC help it. Reserve all of them only if
+    // the last time the thread was starved and keys were left to activation
+    if(ctx.getNetworkConfig().getBackgroundRekeying() &&
+       streamMgr->getRekeyingProgress().completedAtActivation == 0 &&
+       rekeyingSlots > backgroundRekeyingSlots)
+        rekeyingSlots = backgroundRekeyingSlots;
 #else
     rekeyingSlots = 0;
 #endif
@@ -370,11 +380,12 @@ void MasterScheduleDownlinkPhase::sendSchedulePkt(long long slotStart)
     // Add ScheduleHeader to SchedulePacket
     spkt.setHeader(header);
 
-    // Add schedule elements to SchedulePacket
+    // Add schedule elements to SchedulePacket, followed by uplink nodes
     unsigned int sched = 0;
-    for(sched = 0; (sched < packetCapacity) && (position < schedule.size()); sched++)
+    for(sched = 0; (sched < packetCapacity) && (position < schedule.size() + uplinkNodes.size()); sched++)
     {
-        spkt.putElement(schedule[position]);
+        if(position < schedule.size()) spkt.putElement(schedule[position]);
+        else spkt.putElement(uplinkNodes[position - schedule.size()]);
         position++;
     }
     // Add info elements to SchedulePacket
@@ -95,6 +95,8 @@ private:
 
     unsigned char rekeyingSlots = 0;
     unsigned char expansionSlots = 0;
+    // Rekeying slots reserved with background rekeying
+    static const unsigned char backgroundRekeyingSlots = 2;
     
     unsigned char totalAdvanceSlots = 0;
 
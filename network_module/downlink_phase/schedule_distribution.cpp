@@ -29,6 +29,7 @@
 #include "schedule_distribution.h"
 #include "timesync/networktime.h"
 #include "../data_phase/dataphase.h"
+#include "../uplink_phase/uplink_phase.h"
 #include "../tdmh.h"
 
 #include "../stream/stream_wakeup_data.h"
@@ -80,13 +81,18 @@ void ScheduleDownlinkPhase::applyNewSchedule(long long slotStart) {
         printExplicitSchedule(myID, true, explicitSchedule);
     }
     
+    // NOTE: the StreamManager binds the explicit schedule to the streams,
+    // so it has to be called before passing the schedule to the DataPhase
+    streamMgr->applySchedule(schedule, explicitSchedule);
+
     // Apply schedule to DataPhase
     dataPhase->applySchedule(std::move(explicitSchedule),
                              std::move(scheduleExpander.getForwardedStreams()), 
                              schId, header.getScheduleTiles(),
                              header.getActivationTile(), currentTile);
-    
-    streamMgr->applySchedule(schedule);
+
+    // The uplink round-robin changes at the same tile in all nodes
+    ctx.getUplink()->setUplinkGroups(UplinkNodesElement::toGroups(uplinkNodes));
 #ifdef CRYPTO
     if (ENABLE_CRYPTO_REKEYING_DBG) {
         auto myID = ctx.getNetworkId();
@@ -111,6 +117,14 @@ void ScheduleDownlinkPhase::applyNewSchedule(long long slotStart) {
                                                              - ctx.getNetworkConfig().getCallbacksExecutionTime());
 }
 
+void ScheduleDownlinkPhase::extractUplinkNodes(std::vector<ScheduleElement>& elements) {
+    auto isUplinkNodes = [](ScheduleElement& s) {
+        return s.getType() == DownlinkElementType::UPLINK_NODES;
+    };
+    std::copy_if(elements.begin(), elements.end(), std::back_inserter(uplinkNodes), isUplinkNodes);
+    elements.erase(std::remove_if(elements.begin(), elements.end(), isUplinkNodes), elements.end());
+}
+
 void ScheduleDownlinkPhase::applySameSchedule(long long slotStart) {
     int schId = header.getScheduleID();
     unsigned int currentTile = ctx.getCurrentTile(slotStart);
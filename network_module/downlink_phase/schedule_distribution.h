@@ -113,6 +113,12 @@ protected:
     void applyNewSchedule(long long slotStart);
     void applySameSchedule(long long slotStart);
 
+    /**
+     * Move the UPLINK_NODES elements from a list of received elements to
+     * uplinkNodes
+     */
+    void extractUplinkNodes(std::vector<ScheduleElement>& elements);
+
 #ifndef _MIOSIX
     /**
      * Print the implicit schedule and explicit schedule of all nodes
@@ -167,6 +173,9 @@ protected:
     ScheduleHeader header;
     // Copy of last computed/received schedule
     std::vector<ScheduleElement> schedule;
+    // UPLINK_NODES elements distributed with the schedule, kept apart as
+    // they are not expanded
+    std::vector<ScheduleElement> uplinkNodes;
 
     // Number of schedule distribution slots need to distribute the schedule
     unsigned int sendingRounds;
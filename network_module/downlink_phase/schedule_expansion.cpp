@@ -30,7 +30,8 @@
 
 namespace mxnet {
 
-ScheduleExpander::ScheduleExpander(MACContext& c) : ctx(c), netConfig(c.getNetworkConfig()), streamMgr(c.getStreamManager()) {
+ScheduleExpander::ScheduleExpander(MACContext& c) : ctx(c), netConfig(c.getNetworkConfig()), streamMgr(c.getStreamManager()),
+                                                    pool(c.getPacketPool()) {
     // rounded to lower bound
     expansionsPerSlot = ctx.getDownlinkSlotDuration() / singleExpansionTime;
 
@@ -67,7 +68,7 @@ void ScheduleExpander::startExpansion(const std::vector<ScheduleElement>& schedu
     explicitSchedule.resize(scheduleSlots, ExplicitScheduleElement());
 
     forwardedStreamCtr = std::map<StreamId, std::pair<unsigned char, unsigned char>>();
-    buffers            = std::map<unsigned int, std::shared_ptr<Packet>>();
+    buffers            = std::map<unsigned int, PooledPacket>();
     uniqueStreams      = std::set<unsigned int>();
 
     // Count unique streams in schedule and
@@ -180,7 +181,7 @@ void ScheduleExpander::expandSchedule(const std::vector<ScheduleElement>& schedu
         // Period is normally expressed in tiles, get period in slots
         auto periodSlots = toInt(e.getPeriod()) * slotsInTile;
         Action action = Action::SLEEP;
-        std::shared_ptr<Packet> buffer;
+        PooledPacket buffer;
         // Send from stream case
         if(e.getSrc() == nodeID && e.getTx() == nodeID)
             action = Action::SENDSTREAM;
@@ -223,8 +224,9 @@ void ScheduleExpander::expandSchedule(const std::vector<ScheduleElement>& schedu
                 //May happen because of redundancy, in this case we'll happily share the buffer
                 buffer=it->second;
             } else {
-                buffer=std::shared_ptr<Packet>(new Packet);
-                buffers[key]=buffer;
+                buffer=pool.allocate(PoolClass::RELAY);
+                if(buffer) buffers[key]=buffer;
+                else print_dbg("[SD] Error: expandSchedule more than maxRelayedStreams relayed\n");
             }
         }
         
@@ -30,6 +30,7 @@
 
 #include "../mac_context.h"
 #include "../scheduler/schedule_element.h"
+#include "../data_phase/explicit_schedule_element.h"
 #include "../stream/stream_wakeup_data.h"
 #include <vector>
 
@@ -175,7 +176,7 @@ private:
     std::vector<ExplicitScheduleElement> explicitSchedule;
 
     // 
-    std::map<unsigned int, std::shared_ptr<Packet>> buffers;
+    std::map<unsigned int, PooledPacket> buffers;
 
     // Keep track of which streams have already been added to streams wakeup lists
     // (since only unique streams have to be added, without considering their redundancy)
@@ -198,6 +199,8 @@ private:
     const MACContext& ctx;
     const NetworkConfiguration& netConfig;
     StreamManager* const streamMgr;
+    // Relay buffers are allocated from here, to avoid heap allocations
+    PacketPool& pool;
 
     // Maximum number of elements in the inmplicit schedule
     // that can be expanded during a downlink slot
@@ -50,14 +50,25 @@ MACContext::~MACContext() {
 #endif
 }
     
+unsigned int MACContext::packetPoolSize(const NetworkConfiguration& config) {
+    const unsigned int depth = config.getStreamQueueDepth();
+    // Relay buffers are counted twice, as the ones of the old and the new
+    // schedule exist at the same time while the new one is expanded
+    return config.getMaxNodeStreams() * Stream::poolFootprint(config, depth, depth) +
+           2 * config.getMaxRelayedStreams();
+}
+
 MACContext::MACContext(const MediumAccessController& mac, Transceiver& transceiver, const NetworkConfiguration& config) :
                 mac(mac), transceiverConfig(config.getBaseFrequency(), config.getTxPower(), true, false),
                 networkConfig(config), networkId(config.getStaticNetworkId()), transceiver(transceiver),
-                pm(miosix::PowerManager::instance()), streamMgr(*this, config, networkId),
+                pm(miosix::PowerManager::instance()), packetPool(packetPoolSize(config)),
+                streamMgr(*this, config, networkId, packetPool),
                 controlSuperframe(networkConfig.getControlSuperframeStructure()),
                 sendTotal(0), sendErrors(0), rcvTotal(0), rcvErrors(0),
                 running(false)
 {
+    // Always succeeds, the pool is sized for it
+    packetPool.reserve(2 * config.getMaxRelayedStreams(), PoolClass::RELAY);
     calculateDurations();
 }
 
@@ -114,6 +125,8 @@ void MACContext::sendAt(const void* pkt, int size, long long ns) {
         if (ENABLE_RADIO_EXCEPTION_DBG)
             print_dbg("%s\n", e.what());
     }
+    if (ENABLE_SLOT_TIMING_DBG)
+        slotTiming.radioActivity(getTime());
     if (++sendTotal & 1 << 31) {
         sendTotal >>= 1;
         sendErrors >>= 1;
@@ -129,6 +142,8 @@ void MACContext::sendAt(const void* pkt, int size, long long ns, std::function<v
             print_dbg("%s\n", e.what());
         cbk(e);
     }
+    if (ENABLE_SLOT_TIMING_DBG)
+        slotTiming.radioActivity(getTime());
     if (++sendTotal & 1 << 31) {
         sendTotal >>= 1;
         sendErrors >>= 1;
@@ -144,6 +159,8 @@ RecvResult MACContext::recv(void* pkt, int size, long long timeout, Transceiver:
         if (ENABLE_RADIO_EXCEPTION_DBG)
             print_dbg("%s\n", e.what());
     }
+    if (ENABLE_SLOT_TIMING_DBG)
+        slotTiming.radioActivity(getTime());
     if (++rcvTotal & (1 << 31)) {
         rcvTotal >>= 1;
         rcvErrors >>= 1;
@@ -161,6 +178,8 @@ RecvResult MACContext::recv(void *pkt, int size, long long timeout, std::functio
             print_dbg("%s\n", e.what());
         cbk(e);
     }
+    if (ENABLE_SLOT_TIMING_DBG)
+        slotTiming.radioActivity(getTime());
     if (++rcvTotal & (1 << 31)) {
         rcvTotal >>= 1;
         rcvErrors >>= 1;
@@ -198,12 +217,20 @@ void MACContext::run()
         {
             if(tileCounter==0 && controlSuperframeCounter==0)
             {
+                if(ENABLE_SLOT_TIMING_DBG)
+                    slotTiming.begin(SlotTiming::TIMESYNC_DOWNLINK, currentNextDeadline, getTime());
                 timesync->execute(currentNextDeadline);
+                if(ENABLE_SLOT_TIMING_DBG)
+                    slotTiming.end(downlinkSlotDuration, getTime());
                 currentNextDeadline = timesync->getSlotframeStart();
             } else {
                 // Send a notify to the scheduler thread, to begin scheduling
                 beginScheduling();
+                if(ENABLE_SLOT_TIMING_DBG)
+                    slotTiming.begin(SlotTiming::SCHEDULE_DOWNLINK, currentNextDeadline, getTime());
                 scheduleDistribution->run(currentNextDeadline);
+                if(ENABLE_SLOT_TIMING_DBG)
+                    slotTiming.end(downlinkSlotDuration, getTime());
 #ifdef CRYPTO
                 if(keyMgr->periodicUpdate()) {
                     timesync->forceDesync();
@@ -214,7 +241,11 @@ void MACContext::run()
             dataSlots = numDataSlotInDownlinkTile;
             data->advanceBy(downlink_slots);
         } else {
+            if(ENABLE_SLOT_TIMING_DBG)
+                slotTiming.begin(SlotTiming::UPLINK, currentNextDeadline, getTime());
             uplink->run(currentNextDeadline);
+            if(ENABLE_SLOT_TIMING_DBG)
+                slotTiming.end(uplinkSlotDuration, getTime());
             currentNextDeadline += uplinkSlotDuration;
             dataSlots = numDataSlotInUplinkTile;
             data->advanceBy(uplink_slots);
@@ -222,7 +253,11 @@ void MACContext::run()
 
         for(unsigned i = 0; i < dataSlots; i++)
         {
+            if(ENABLE_SLOT_TIMING_DBG)
+                slotTiming.begin(SlotTiming::DATA, currentNextDeadline, getTime());
             data->run(currentNextDeadline);
+            if(ENABLE_SLOT_TIMING_DBG)
+                slotTiming.end(dataSlotDuration, getTime());
             currentNextDeadline += dataSlotDuration;
         }
         /* Call periodicUpdate to Streams and Servers */
@@ -233,7 +268,16 @@ void MACContext::run()
         {
             tileCounter=0;
             if(++controlSuperframeCounter >= networkConfig.getNumSuperframesPerClockSync())
+            {
                 controlSuperframeCounter=0;
+                // Print the calibrated profile once per clock sync period
+                if(networkConfig.getCalibrateSlotTiming())
+                    slotCalibration.print();
+                if(ENABLE_SLOT_TIMING_DBG) {
+                    slotTiming.publish();
+                    slotTiming.print();
+                }
+            }
         }
     }
     transceiver.turnOff();
@@ -33,6 +33,9 @@
 #include "interfaces-impl/transceiver.h"
 #include "interfaces-impl/power_manager.h"
 #include "stream/stream_manager.h"
+#include "util/packet_pool.h"
+#include "util/slot_calibration.h"
+#include "util/slot_timing.h"
 #include "downlink_phase/timesync/networktime.h"
 #include <functional>
 #include <stdexcept>
@@ -204,6 +207,18 @@ public:
      */
     StreamManager* getStreamManager() { return &streamMgr; }
 
+    /**
+     * @return the pool from which stream and relay buffers are allocated
+     */
+    PacketPool& getPacketPool() { return packetPool; }
+
+    /**
+     * @return the processing time measurements of the MAC phases, only
+     * collected if calibrateSlotTiming is enabled
+     */
+    SlotCalibration& getSlotCalibration() { return slotCalibration; }
+    SlotTiming& getSlotTiming() { return slotTiming; }
+
     /**
      * @return the number of slots (of data slot size) in a generic tile
      */
@@ -318,7 +333,11 @@ protected:
     unsigned short networkId;
     miosix::Transceiver& transceiver;
     miosix::PowerManager& pm;
+    // NOTE: declared before streamMgr, as streams hold packets of the pool
+    PacketPool packetPool;
     StreamManager streamMgr;
+    SlotCalibration slotCalibration;
+    SlotTiming slotTiming;
 #ifdef CRYPTO
     KeyManager* keyMgr = nullptr;
 #endif
@@ -342,6 +361,13 @@ private:
     unsigned rcvTotal;
     unsigned rcvErrors;
 
+    /**
+     * \return the number of packets to preallocate for stream and relay
+     * buffers, enough for maxNodeStreams streams with queues of
+     * streamQueueDepth packets, each also relayed by this node
+     */
+    static unsigned int packetPoolSize(const NetworkConfiguration& config);
+
     volatile bool running;
     const bool sleepDeep=false; //TODO: make it configurable
     bool ready = false;
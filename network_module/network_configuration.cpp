@@ -71,7 +71,8 @@ NetworkConfiguration::NetworkConfiguration(unsigned char maxHops, unsigned short
         unsigned short maxRoundsWeakLinkBecomesDead, 
         short minNeighborRSSI, short minWeakNeighborRSSI,
         unsigned char maxMissedTimesyncs, bool channelSpatialReuse,
-        bool useWeakTopologies,
+        bool useWeakTopologies, bool compactDataHeader, bool combineRedundantCopies,
+        bool earlyTermination, bool calibrateSlotTiming, bool adaptiveUplink, bool burstUplink, bool deltaTopologies, bool sparseTopologies, bool concurrentUplink, bool smeFastPath, bool backgroundRekeying,
 #ifdef CRYPTO
         bool authenticateControlMessages, bool encryptControlMessages,
         bool authenticateDataMessages, bool encryptDataMessages,
@@ -79,7 +80,10 @@ NetworkConfiguration::NetworkConfiguration(unsigned char maxHops, unsigned short
         unsigned int masterChallengeAuthenticationTimeout,
         unsigned int rekeyingPeriod,
 #endif
-        ControlSuperframeStructure controlSuperframe) :
+        ControlSuperframeStructure controlSuperframe,
+        SlotTimingProfile slotTiming,
+        unsigned short maxNodeStreams, unsigned char streamQueueDepth,
+        unsigned short maxRelayedStreams) :
     maxHops(maxHops), hopBits(BitwiseOps::bitsForRepresentingCount(maxHops)),
     numUplinkPerSuperframe(controlSuperframe.countUplinkSlots()), numDownlinkPerSuperframe(controlSuperframe.countDownlinkSlots()),
     staticNetworkId(networkId), staticHop(staticHop), maxNodes(maxNodes),
@@ -92,6 +96,17 @@ NetworkConfiguration::NetworkConfiguration(unsigned char maxHops, unsigned short
     minNeighborRSSI(minNeighborRSSI), minWeakNeighborRSSI(minWeakNeighborRSSI),
     channelSpatialReuse(channelSpatialReuse),
     useWeakTopologies(useWeakTopologies),
+    compactDataHeader(compactDataHeader),
+    combineRedundantCopies(combineRedundantCopies),
+    earlyTermination(earlyTermination),
+    calibrateSlotTiming(calibrateSlotTiming),
+    adaptiveUplink(adaptiveUplink),
+    burstUplink(burstUplink),
+    deltaTopologies(deltaTopologies),
+    sparseTopologies(sparseTopologies),
+    concurrentUplink(concurrentUplink),
+    smeFastPath(smeFastPath),
+    backgroundRekeying(backgroundRekeying),
 #ifdef CRYPTO
     authenticateControlMessages(authenticateControlMessages | encryptControlMessages),
     encryptControlMessages(encryptControlMessages),
@@ -102,6 +117,10 @@ NetworkConfiguration::NetworkConfiguration(unsigned char maxHops, unsigned short
     rekeyingPeriod(rekeyingPeriod),
 #endif
     controlSuperframe(controlSuperframe),
+    slotTiming(slotTiming),
+    maxNodeStreams(maxNodeStreams),
+    streamQueueDepth(streamQueueDepth),
+    maxRelayedStreams(maxRelayedStreams),
     controlSuperframeDuration(tileDuration * controlSuperframe.size()),
     numSuperframesPerClockSync(clockSyncPeriod / controlSuperframeDuration) {
     validate();
@@ -110,14 +129,38 @@ NetworkConfiguration::NetworkConfiguration(unsigned char maxHops, unsigned short
 void NetworkConfiguration::validate() const {
     const int totAvailableBytes = getFirstUplinkPacketCapacity(*this) +
         (numUplinkPackets - 1) * getOtherUplinkPacketCapacity(*this);
-    auto topologySize = guaranteedTopologies * TopologyElement::maxSize(
-                                getNeighborBitmaskSize(), useWeakTopologies);
+    auto topologySize = guaranteedTopologies * (getVariableSizeTopologies() ?
+        TopologyElement::maxEncodedSize(getNeighborBitmaskSize(), useWeakTopologies) :
+        TopologyElement::maxSize(getNeighborBitmaskSize(), useWeakTopologies));
     if(topologySize > totAvailableBytes) {
         throwLogicError("guaranteedTopologies size of %d exceeds UplinkMessage available space of %d",topologySize,totAvailableBytes);
     }
     if(clockSyncPeriod % controlSuperframeDuration != 0)
         throwLogicError("control superframe (%lld) does not divide clock sync period (%lld)",
                         controlSuperframeDuration, clockSyncPeriod);
+    // The uplink header uses a bit of the hop field to flag a sparse topology
+    if(sparseTopologies && maxHops >= 64)
+        throwLogicError("Configuration error: sparseTopologies requires maxHops < 64");
+    // Concurrent uplink senders are distributed with the adaptive round-robin
+    if(concurrentUplink && !adaptiveUplink)
+        throwLogicError("Configuration error: concurrentUplink requires adaptiveUplink");
+#ifdef CRYPTO
+    // The FCS of the corrupted copies is not available to the MAC, the
+    // combined packet can only be checked by verifying its tag
+    if(combineRedundantCopies && !authenticateDataMessages)
+        throwLogicError("Configuration error: combineRedundantCopies requires authenticateDataMessages");
+#else
+    if(combineRedundantCopies)
+        throwLogicError("Configuration error: combineRedundantCopies requires authenticateDataMessages");
+#endif
+#ifdef CRYPTO
+    // SMEs piggybacked on data packets are outside of the data packet tag,
+    // and relays can't recompute the tag of the packets they forward
+    if(smeFastPath && (authenticateControlMessages || authenticateDataMessages))
+        throwLogicError("Configuration error: smeFastPath requires authenticateControlMessages and authenticateDataMessages to be disabled");
+#endif
+    if(maxNodeStreams == 0 || streamQueueDepth == 0)
+        throwLogicError("Configuration error: maxNodeStreams and streamQueueDepth must be at least 1");
     // maxNodes must be a multiple of 8 because otherwise the RuntimeBitset won't work correctly
     if((maxNodes % 8) != 0)
       throwLogicError("Configuration error: maxNodes must be a multiple of 8");
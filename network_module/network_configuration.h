@@ -94,6 +94,45 @@ private:
     const int sz;
 };
 
+/**
+ * Processing time budgets of the MAC phases, excluding the time the radio
+ * spends transmitting. The default constructed profile selects the built-in
+ * estimates, a calibrated profile can be obtained by running the network with
+ * calibrateSlotTiming enabled, see SlotCalibration.
+ * NOTE: all nodes of a network must use the same profile
+ */
+class SlotTimingProfile
+{
+public:
+    /**
+     * Default constructor, use the built-in estimates
+     */
+    SlotTimingProfile() : dataProcessingTime(0), uplinkPacketTime(0) {}
+
+    /**
+     * \param dataProcessingTime processing time of a data slot in ns, added to
+     * the radio time of the largest data packet. 0 to use the built-in estimate
+     * \param uplinkPacketTime time in ns needed to receive and process each
+     * packet of an uplink message. 0 to use the built-in estimate
+     */
+    SlotTimingProfile(long long dataProcessingTime, long long uplinkPacketTime)
+        : dataProcessingTime(dataProcessingTime), uplinkPacketTime(uplinkPacketTime) {}
+
+    /**
+     * \return the processing time of a data slot, or 0 if not calibrated
+     */
+    long long getDataProcessingTime() const { return dataProcessingTime; }
+
+    /**
+     * \return the time needed for each uplink packet, or 0 if not calibrated
+     */
+    long long getUplinkPacketTime() const { return uplinkPacketTime; }
+
+private:
+    long long dataProcessingTime;
+    long long uplinkPacketTime;
+};
+
 
 class NetworkConfiguration {
 public:
@@ -109,6 +148,17 @@ public:
             short minNeighborRSSI, short minWeakNeighborRSSI,
             unsigned char maxMissedTimesyncs,
             bool channelSpatialReuse, bool useWeakTopologies,
+            bool compactDataHeader,
+            bool combineRedundantCopies,
+            bool earlyTermination,
+            bool calibrateSlotTiming,
+            bool adaptiveUplink,
+            bool burstUplink,
+            bool deltaTopologies,
+            bool sparseTopologies,
+            bool concurrentUplink,
+            bool smeFastPath,
+            bool backgroundRekeying,
 #ifdef CRYPTO
             bool authenticateControlMessages, bool encryptControlMessages,
             bool authenticateDataMessages, bool encryptDataMessages,
@@ -116,7 +166,10 @@ public:
             unsigned int masterChallengeAuthenticationTimeout,
             unsigned int rekeyingPeriod,
 #endif
-            ControlSuperframeStructure controlSuperframe=ControlSuperframeStructure());
+            ControlSuperframeStructure controlSuperframe=ControlSuperframeStructure(),
+            SlotTimingProfile slotTiming=SlotTimingProfile(),
+            unsigned short maxNodeStreams=8, unsigned char streamQueueDepth=2,
+            unsigned short maxRelayedStreams=16);
 
     /**
      * @return the reference frequency for the protocol.
@@ -185,6 +238,39 @@ public:
         return controlSuperframe;
     }
 
+    /**
+     * @return the processing time budgets used to size the slots
+     */
+    SlotTimingProfile getSlotTimingProfile() const {
+        return slotTiming;
+    }
+
+    /**
+     * @return the number of streams a node is expected to have open at the
+     * same time, used to size the packet pool
+     */
+    unsigned short getMaxNodeStreams() const {
+        return maxNodeStreams;
+    }
+
+    /**
+     * @return the transmit and receive queue depth every stream can be
+     * given with setQueueDepth(), used to size the packet pool. Streams can
+     * go deeper only if other streams use less than this depth
+     */
+    unsigned char getStreamQueueDepth() const {
+        return streamQueueDepth;
+    }
+
+    /**
+     * @return the number of streams of other nodes a node can forward, used
+     * to size the relay buffers of the packet pool. Streams relayed beyond
+     * this number are not forwarded by the node
+     */
+    unsigned short getMaxRelayedStreams() const {
+        return maxRelayedStreams;
+    }
+
     /**
      * @return the number of topology messages that is guaranteed to be forwarded in an uplink message.
      */
@@ -321,6 +407,118 @@ public:
         return useWeakTopologies;
     }
 
+    /**
+     * @return true if data packets carry an 8 bit stream tag in the
+     * IEEE 802.15.4 sequence number field instead of the full StreamId.
+     * The stream owning a data slot is already known from the schedule,
+     * so this saves sizeof(StreamId) bytes of every data packet
+     */
+    bool getCompactDataHeader() const {
+        return compactDataHeader;
+    }
+
+    /**
+     * @return true if the redundant copies of a data packet that failed the
+     * CRC check are kept and combined, to recover the packet when no copy
+     * of the period is received correctly. Requires authenticateDataMessages,
+     * as only the tag can tell if the combined packet is correct
+     */
+    bool getCombineRedundantCopies() const {
+        return combineRedundantCopies;
+    }
+
+    /**
+     * @return true if nodes stop listening to the redundant copies of a data
+     * packet once a valid copy has been received in the current period.
+     * Only the receive side is covered: senders, relays included, get no
+     * feedback from the next hop and still transmit every copy
+     */
+    bool getEarlyTermination() const {
+        return earlyTermination;
+    }
+
+    /**
+     * @return true if the processing time of the MAC phases is measured to
+     * compute a calibrated SlotTimingProfile, which is printed periodically
+     */
+    bool getCalibrateSlotTiming() const {
+        return calibrateSlotTiming;
+    }
+
+    /**
+     * @return true if the uplink round-robin only cycles through the nodes
+     * known to the master, distributed with the schedule, with a periodic
+     * discovery slot for the other node IDs
+     */
+    bool getAdaptiveUplink() const {
+        return adaptiveUplink;
+    }
+
+    /**
+     * @return true if the packets of a multi-packet uplink message are sent
+     * back to back and verified once the whole burst has been received
+     */
+    bool getBurstUplink() const {
+        return burstUplink;
+    }
+
+    /**
+     * @return true if forwarded topologies can be sent as a list of changes
+     * against the last full topology sent for the same node, which makes
+     * TopologyElements variable sized
+     */
+    bool getDeltaTopologies() const {
+        return deltaTopologies;
+    }
+
+    /**
+     * @return true if topologies can be sent as a list of neighbor IDs instead
+     * of a bitmask, whichever is smaller, which makes TopologyElements
+     * variable sized. Requires maxHops to be less than 64
+     */
+    bool getSparseTopologies() const {
+        return sparseTopologies;
+    }
+
+    /**
+     * @return true if the master assigns the same uplink slot to multiple
+     * nodes that are at least three hops apart in the topology, so that an
+     * uplink round lasts as many slots as the colors needed by the topology
+     * instead of the number of nodes. Requires adaptiveUplink
+     */
+    bool getConcurrentUplink() const {
+        return concurrentUplink;
+    }
+
+    /**
+     * @return true if pending SMEs are also forwarded toward the master in
+     * the spare bytes of data packets of streams directed to the master,
+     * instead of waiting for the uplink slot of each hop. The piggybacked
+     * SMEs are not authenticated, so it requires both control and data
+     * message authentication to be disabled
+     */
+    bool getSmeFastPath() const {
+        return smeFastPath;
+    }
+
+    /**
+     * @return true if the next keys of streams are computed by a low priority
+     * thread as soon as rekeying starts. Only a few downlink slots are reserved
+     * to compute them, unless the thread of the master could not keep up with
+     * the last rekeying, and nodes start expanding the schedule as soon as
+     * their keys are ready
+     */
+    bool getBackgroundRekeying() const {
+        return backgroundRekeying;
+    }
+
+    /**
+     * @return true if TopologyElements are variable sized
+     */
+    bool getVariableSizeTopologies() const {
+        return deltaTopologies || sparseTopologies;
+    }
+
 #ifdef CRYPTO
     /**
      * @return true if control messages are authenticated
@@ -408,6 +606,17 @@ private:
     const short minWeakNeighborRSSI;
     const bool channelSpatialReuse;
     const bool useWeakTopologies;
+    const bool compactDataHeader;
+    const bool combineRedundantCopies;
+    const bool earlyTermination;
+    const bool calibrateSlotTiming;
+    const bool adaptiveUplink;
+    const bool burstUplink;
+    const bool deltaTopologies;
+    const bool sparseTopologies;
+    const bool concurrentUplink;
+    const bool smeFastPath;
+    const bool backgroundRekeying;
 #ifdef CRYPTO
     const bool authenticateControlMessages;
     const bool encryptControlMessages;
@@ -419,6 +628,10 @@ private:
 #endif
 
     const ControlSuperframeStructure controlSuperframe;
+    const SlotTimingProfile slotTiming;
+    const unsigned short maxNodeStreams;
+    const unsigned char streamQueueDepth;
+    const unsigned short maxRelayedStreams;
     const unsigned long long controlSuperframeDuration;
 
     unsigned numSuperframesPerClockSync;
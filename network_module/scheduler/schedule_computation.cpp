@@ -186,11 +186,20 @@ bool ScheduleComputation::reschedule()
     bool scheduleChanged = false;
 
     /* NOTE: Here we prioritize established streams over new ones */
-    /* If topology changed or a stream was removed:
+    /* If topology changed, a stream was removed or its redundancy changed:
         clear current schedule and reschedule established streams */
     Schedule newSchedule;
-    if(graph_changed || stream_snapshot.wasRemoved()) {
+    if(graph_changed || stream_snapshot.wasRemoved() || stream_snapshot.wasChanged()) {
         newSchedule = scheduleEstablishedStreams(schedule.id + 1);
+        // A stream whose redundancy was raised may no longer fit, schedule
+        // it again with the previous redundancy instead of closing it
+        if(stream_snapshot.wasChanged()) {
+            auto reverted = stream_snapshot.revertFailedRaises(newSchedule.schedule);
+            if(reverted.empty() == false) {
+                stream_collection.revertRaises(reverted);
+                newSchedule = scheduleEstablishedStreams(schedule.id + 1);
+            }
+        }
         scheduleChanged = true;
     }
     // Otherwise continue scheduling from the last schedule
@@ -223,13 +232,35 @@ bool ScheduleComputation::reschedule()
         stream_collection.applyChanges(changes);
         
         // If the only changes are REJECT, they are dealt with using info
-        // elements and the schedule hasn't really changed.
-        scheduleChanged = false;
+        // elements and the schedule hasn't really changed, unless the
+        // redundancy of established streams was changed
+        scheduleChanged = stream_snapshot.wasChanged();
         for(auto change : changes)
             if(change.second != StreamChange::REJECT) scheduleChanged = true;
         if((SCHEDULER_DETAILED_DBG || SCHEDULER_SUMMARY_DBG) && !scheduleChanged)
             puts("[SC] No schedule changes, not sending");
     }
+
+    // With adaptive uplink, a change in the set of nodes, or in the groups
+    // sharing an uplink slot, requires sending the schedule even if no stream
+    // changed
+    if(netconfig.getAdaptiveUplink())
+    {
+        std::vector<unsigned char> nodes;
+        for(unsigned int i = 0; i < netconfig.getMaxNodes(); i++)
+            if(i == 0 || network_graph.hasNode(i)) nodes.push_back(i);
+        if(netconfig.getConcurrentUplink())
+            newSchedule.uplinkGroups = computeUplinkGroups(nodes);
+        else
+            newSchedule.uplinkGroups.push_back(std::move(nodes));
+        if(newSchedule.uplinkGroups != schedule.uplinkGroups)
+        {
+            if(SCHEDULER_DETAILED_DBG || SCHEDULER_SUMMARY_DBG)
+                printf("[SC] Uplink groups changed (%u groups)\n",
+                       static_cast<unsigned int>(newSchedule.uplinkGroups.size()));
+            scheduleChanged = true;
+        }
+    }
     
     //If schedule has really changed, send it
     if(scheduleChanged)
@@ -374,7 +405,8 @@ std::pair<std::list<ScheduleElement>, unsigned int> ScheduleComputation::routeAn
 }
 
 void ScheduleComputation::getSchedule(std::vector<ScheduleElement>& sched,
-                                      unsigned long& id, unsigned int& tiles) {
+                                      unsigned long& id, unsigned int& tiles,
+                                      std::vector<std::vector<unsigned char>>& uplinkGroups) {
     // Mutex lock to access schedule (shared with ScheduleDownlink).
 #ifdef _MIOSIX
     miosix::Lock<miosix::Mutex> lck(sched_mutex);
@@ -386,6 +418,7 @@ void ScheduleComputation::getSchedule(std::vector<ScheduleElement>& sched,
     std::copy(schedule.schedule.begin(),schedule.schedule.end(),std::back_inserter(sched));
     id = schedule.id;
     tiles = schedule.tiles;
+    uplinkGroups = schedule.uplinkGroups;
 }
 
 std::pair<std::list<ScheduleElement>, unsigned int> ScheduleComputation::scheduleStreams(
@@ -636,6 +669,64 @@ bool ScheduleComputation::checkInterferenceConflict(const ScheduleElement& new_t
 }
 
 
+std::vector<std::vector<unsigned char>> ScheduleComputation::computeUplinkGroups(
+        const std::vector<unsigned char>& nodes) {
+    // Two nodes can share an uplink slot if they are not neighbors and have
+    // no common neighbor, so that no node hears both of them. Use the same
+    // graph as the interference checks of the data phase
+    GRAPH_TYPE& graph = useWeakTopologies ? weak_graph : network_graph;
+    const unsigned int maxNodes = netconfig.getMaxNodes();
+    std::vector<std::vector<bool>> conflicts(maxNodes, std::vector<bool>(maxNodes, false));
+    for(auto node : nodes) {
+        for(auto neighbor : graph.getEdges(node)) {
+            conflicts[node][neighbor] = true;
+            for(auto twoHop : graph.getEdges(neighbor))
+                if(twoHop != node) conflicts[node][twoHop] = true;
+        }
+    }
+    auto fits = [&](const std::vector<unsigned char>& group, unsigned char node) {
+        for(auto other : group)
+            if(conflicts[node][other] || conflicts[other][node]) return false;
+        return true;
+    };
+
+    // Keep the current groups while they are still valid, as every change
+    // needs to be distributed with a schedule
+    std::vector<unsigned char> currentNodes;
+    bool valid = true;
+    for(auto& group : schedule.uplinkGroups) {
+        for(unsigned int i = 0; i < group.size(); i++) {
+            for(unsigned int j = 0; j < i; j++)
+                if(conflicts[group[i]][group[j]] || conflicts[group[j]][group[i]]) valid = false;
+            currentNodes.push_back(group[i]);
+        }
+    }
+    std::sort(currentNodes.begin(), currentNodes.end());
+    if(valid && currentNodes == nodes) return schedule.uplinkGroups;
+
+    // Greedy coloring, starting from the nodes with the most conflicts
+    std::vector<unsigned char> sorted(nodes);
+    auto degree = [&](unsigned char node) {
+        return std::count(conflicts[node].begin(), conflicts[node].end(), true);
+    };
+    std::stable_sort(sorted.begin(), sorted.end(), [&](unsigned char a, unsigned char b) {
+        return degree(a) > degree(b);
+    });
+    std::vector<std::vector<unsigned char>> groups;
+    for(auto node : sorted) {
+        auto it = std::find_if(groups.begin(), groups.end(),
+            [&](const std::vector<unsigned char>& group) { return fits(group, node); });
+        if(it == groups.end()) groups.push_back({node});
+        else it->push_back(node);
+    }
+    for(auto& group : groups) std::sort(group.begin(), group.end());
+    if(SCHEDULER_DETAILED_DBG)
+        printf("[SC] %u nodes in %u uplink groups\n",
+               static_cast<unsigned int>(nodes.size()),
+               static_cast<unsigned int>(groups.size()));
+    return groups;
+}
+
 void ScheduleComputation::printSchedule(const Schedule& sched) {
     printf("ID  TX  RX  PER OFF\n");
     for(auto& elem : sched.schedule) {
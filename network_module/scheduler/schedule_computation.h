@@ -60,6 +60,7 @@ public:
         std::swap(id, rhs.id);
         std::swap(tiles, rhs.tiles);
         std::swap(linksCausingInterference, rhs.linksCausingInterference);
+        uplinkGroups.swap(rhs.uplinkGroups);
     }
 
     std::set<std::pair<unsigned char, unsigned char>> getLinksCausingInterference() {
@@ -80,6 +81,12 @@ public:
      * an interference conflict to arise with respect to the current schedule.
      * */
     std::set<std::pair<unsigned char, unsigned char>> linksCausingInterference;
+
+    /* When adaptive uplink is on, the nodes taking part in the uplink
+     * round-robin, distributed together with the schedule. Each group shares
+     * an uplink slot, and is sorted by node ID. Without concurrent uplink
+     * there is a single group, whose nodes take one slot each */
+    std::vector<std::vector<unsigned char>> uplinkGroups;
 };
 
 class ScheduleComputation {
@@ -95,8 +102,10 @@ public:
     /**
      * Used by the ScheduleDownlink class to get the latest schedule
      * @return a copy of the Schedule class containing schedule, size, id
+     * and the groups of nodes taking part in the uplink round-robin
      */
-    void getSchedule(std::vector<ScheduleElement>& sched, unsigned long& id, unsigned int& tiles);
+    void getSchedule(std::vector<ScheduleElement>& sched, unsigned long& id, unsigned int& tiles,
+                     std::vector<std::vector<unsigned char>>& uplinkGroups);
     
     /**
      * Used by the ScheduleDownlink class to know if a schedule needs to be sent
@@ -198,6 +207,13 @@ private:
 
     bool checkInterferenceConflict(const ScheduleElement& new_transmission, const ScheduleElement& old_transmission);
 
+    /**
+     * @return the nodes grouped so that nodes in the same group are at least
+     * three hops apart, and can share an uplink slot. The groups of the
+     * current schedule are kept if still valid
+     */
+    std::vector<std::vector<unsigned char>> computeUplinkGroups(const std::vector<unsigned char>& nodes);
+
     void printSchedule(const Schedule& sched);
 
     void printStreams(const std::vector<MasterStreamInfo>& stream_list);
@@ -28,6 +28,7 @@
 #include "schedule_element.h"
 #include "../util/packet.h"
 #include <stdexcept>
+#include <algorithm>
 
 namespace mxnet {
 
@@ -48,7 +49,8 @@ void ScheduleElement::serialize(Packet& pkt) const {
             pkt.put(&params, sizeof(StreamParameters));
             pkt.put(&content, sizeof(ScheduleElementPkt));
             break;
-        case DownlinkElementType::RESPONSE: {
+        case DownlinkElementType::RESPONSE:
+        case DownlinkElementType::UPLINK_NODES: {
             pkt.put(&nodeId, sizeof(unsigned char));
             pkt.put(response, sizeof(response));
             unsigned char t = static_cast<unsigned char>(type)<<4;
@@ -71,6 +73,7 @@ void ScheduleElement::deserialize(Packet& pkt) {
             pkt.get(&content, sizeof(ScheduleElementPkt));
             break;
         case DownlinkElementType::RESPONSE:
+        case DownlinkElementType::UPLINK_NODES:
             pkt.get(&nodeId, sizeof(unsigned char));
             pkt.get(response, sizeof(response));
             pkt.discard(sizeof(unsigned char));
@@ -107,45 +110,41 @@ void ScheduleElement::print()
             print_dbg("RESPONSE (%d,%d,%d,%d)\n",
                    id.src,id.dst,id.srcPort,id.dstPort);
             break;
+        case DownlinkElementType::UPLINK_NODES:
+            print_dbg("UPLINK_NODES from %d\n", nodeId);
+            break;
     }
 }
 
-void SchedulePacket::serialize(Packet& pkt) const {
-    pkt.putPanHeader(panId);
-    header.serialize(pkt);
-    for(auto e : elements)
-        e.serialize(pkt);
-}
-
-void SchedulePacket::deserialize(Packet& pkt) {
-    pkt.removePanHeader();
-    header.deserialize(pkt);
-    auto count = pkt.size() / ScheduleElement::maxSize();
-    elements.clear();
-    elements.reserve(count);
-    for(unsigned int i=0; i < count; i++) {
-        ScheduleElement elem;
-        elem.deserialize(pkt);
-        elements.push_back(elem);
+std::vector<ScheduleElement> UplinkNodesElement::fromGroups(const std::vector<std::vector<unsigned char>>& groups) {
+    std::vector<ScheduleElement> result;
+    for(unsigned int g = 0; g < groups.size(); g++) {
+        std::vector<UplinkNodesElement> elements;
+        for(auto node : groups[g]) {
+            unsigned char first = node - node % nodesPerElement;
+            if(elements.empty() || elements.back().getFirstNode() != first)
+                elements.push_back(UplinkNodesElement(g, first));
+            elements.back().addNode(node);
+        }
+        result.insert(result.end(), elements.begin(), elements.end());
     }
+    return result;
 }
 
-std::size_t SchedulePacket::size() const {
-    return panHeaderSize +
-        header.size() +
-        elements.size();
-}
-
-unsigned int SchedulePacket::getPacketCapacity() {
-#ifdef CRYPTO
-    const unsigned int authTagSize = 16;
-    return (MediumAccessController::maxControlPktSize -
-            (authTagSize + panHeaderSize + ScheduleHeader::maxSize()))
-        / ScheduleElement::maxSize();
-#else
-    return (MediumAccessController::maxControlPktSize - (panHeaderSize + ScheduleHeader::maxSize()))
-        / ScheduleElement::maxSize();
-#endif
+std::vector<std::vector<unsigned char>> UplinkNodesElement::toGroups(const std::vector<ScheduleElement>& elements) {
+    std::vector<std::vector<unsigned char>> result;
+    for(auto& s : elements) {
+        UplinkNodesElement e(s);
+        if(e.getGroup() >= result.size()) result.resize(e.getGroup() + 1);
+        auto& group = result[e.getGroup()];
+        for(unsigned int id = e.getFirstNode(); id < e.getFirstNode() + nodesPerElement && id < 256; id++)
+            if(e.hasNode(id)) group.push_back(id);
+    }
+    for(auto& group : result) {
+        std::sort(group.begin(), group.end());
+        group.erase(std::unique(group.begin(), group.end()), group.end());
+    }
+    return result;
 }
 
 } /* namespace mxnet */
@@ -42,7 +42,8 @@ enum class DownlinkElementType
 {
     SCHEDULE_ELEMENT    =0,
     INFO_ELEMENT        =1,
-    RESPONSE            =2  // Response to a challenge for master authentication
+    RESPONSE            =2, // Response to a challenge for master authentication
+    UPLINK_NODES        =3  // Nodes taking part in the uplink round-robin
 };
 
 /* Possible actions to do in a dataphase slot */
@@ -181,14 +182,16 @@ public:
     unsigned int getKey() const { return id.getKey(); }
 
     /**
-     * Used by ResponseElement
-     * @return the network ID of the node that requested the challenge
+     * Used by ResponseElement and UplinkNodesElement
+     * @return the network ID of the node that requested the challenge, or
+     * the first node ID of an UplinkNodesElement
      */
     unsigned char getNodeId() const { return nodeId; }
 
     /**
-     * Used by ResponseElement
-     * @return a pointer to the 8-byte buffer containing the response
+     * Used by ResponseElement and UplinkNodesElement
+     * @return a pointer to the 8-byte buffer containing the response, or
+     * the node bitmask
      */
     const unsigned char *getResponseBytes() const { return response; }
 
@@ -262,6 +265,58 @@ public:
 
 };
 
+/**
+ * Carries a group of nodes sharing a slot of the uplink round-robin, as its
+ * index followed by a bitmask of 56 node IDs starting from firstNode. A group
+ * with nodes spanning more than 56 IDs takes multiple elements. Serialized
+ * like a ResponseElement.
+ */
+class UplinkNodesElement : public ScheduleElement {
+public:
+    static const unsigned int nodesPerElement = 8 * (sizeof(response) - 1);
+
+    UplinkNodesElement(unsigned char group, unsigned char firstNode) {
+        type = DownlinkElementType::UPLINK_NODES;
+        nodeId = firstNode;
+        memset(response, 0, sizeof(response));
+        response[0] = group;
+    }
+
+    UplinkNodesElement(ScheduleElement s) {
+        type = DownlinkElementType::UPLINK_NODES;
+        nodeId = s.getNodeId();
+        memcpy(response, s.getResponseBytes(), sizeof(response));
+    }
+
+    unsigned char getGroup() const { return response[0]; }
+
+    unsigned char getFirstNode() const { return nodeId; }
+
+    void addNode(unsigned char id) {
+        unsigned int i = id - nodeId;
+        response[1 + i / 8] |= 1 << (i % 8);
+    }
+
+    bool hasNode(unsigned char id) const {
+        unsigned int i = id - nodeId;
+        return i < nodesPerElement && (response[1 + i / 8] & (1 << (i % 8)));
+    }
+
+    /**
+     * \param groups the groups of nodes sharing an uplink slot, in
+     * round-robin order, each sorted by node ID
+     * \return the elements encoding the groups
+     */
+    static std::vector<ScheduleElement> fromGroups(const std::vector<std::vector<unsigned char>>& groups);
+
+    /**
+     * \param elements the UPLINK_NODES elements of a schedule, in any order
+     * \return the groups they encode, in round-robin order, each sorted by
+     * node ID
+     */
+    static std::vector<std::vector<unsigned char>> toGroups(const std::vector<ScheduleElement>& elements);
+};
+
 class SchedulePacket : public SerializableMessage {
 public:
     SchedulePacket(unsigned short panId) : panId(panId) {}
@@ -294,26 +349,5 @@ private:
     std::vector<ScheduleElement> elements;
 };
 
-class ExplicitScheduleElement {
-public:
-    ExplicitScheduleElement() {
-        action = Action::SLEEP;
-        stream = StreamInfo();
-    }
-    ExplicitScheduleElement(Action action, StreamInfo stream) :
-        action(action), stream(stream) {}
-    
-    Action getAction() const { return action; }
-    StreamId getStreamId() const { return stream.getStreamId(); }
-    StreamInfo getStreamInfo() const { return stream; }
-    
-    void setBuffer(std::shared_ptr<Packet> buffer) { this->buffer=buffer; }
-    std::shared_ptr<Packet> getBuffer() { return buffer; }
-private:
-    Action action;
-    StreamInfo stream;
-    std::shared_ptr<Packet> buffer;
-};
-
 
 } /* namespace mxnet */
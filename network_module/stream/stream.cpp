@@ -29,7 +29,9 @@
 #include "../network_configuration.h"
 #include "../mac_context.h"
 #include "../util/debug_settings.h"
+#include "../util/packet_combining.h"
 #include <algorithm>
+#include <cstring>
 
 namespace mxnet {
 
@@ -75,6 +77,401 @@ void Stream::wakeup() {
 }
 
 int Stream::write(const void* data, int size) {
+    StreamIoVec iov = { const_cast<void*>(data), size };
+    return doWrite(&iov, 1, true);
+}
+
+int Stream::tryWrite(const void* data, int size) {
+    StreamIoVec iov = { const_cast<void*>(data), size };
+    return doWrite(&iov, 1, false);
+}
+
+int Stream::writev(const StreamIoVec* iov, int iovcnt) {
+    return doWrite(iov, iovcnt, true);
+}
+
+int Stream::read(void* data, int maxSize) {
+    StreamIoVec iov = { data, maxSize };
+    return doRead(&iov, 1, true);
+}
+
+int Stream::tryRead(void* data, int maxSize) {
+    StreamIoVec iov = { data, maxSize };
+    return doRead(&iov, 1, false);
+}
+
+int Stream::readv(const StreamIoVec* iov, int iovcnt) {
+    return doRead(iov, iovcnt, true);
+}
+
+int Stream::borrowWrite(void** buf) {
+
+    if (hasSendCallback) {
+        return -3;
+    }
+    // The fragment header has to be put by the stream
+    if(fragmentation) {
+        return -1;
+    }
+
+    PooledPacket pkt;
+    if(newTxPacket(pkt) == false) {
+        return -1;
+    }
+    *buf = pkt->writableData();
+    int capacity = pkt->available();
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(tx_mutex);
+#else
+        std::unique_lock<std::mutex> lck(tx_mutex);
+#endif
+        // A previously borrowed and not committed buffer is discarded
+        txBorrowed = std::move(pkt);
+    }
+    return capacity;
+}
+
+int Stream::commitWrite(int size) {
+    PooledPacket pkt;
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(tx_mutex);
+#else
+        std::unique_lock<std::mutex> lck(tx_mutex);
+#endif
+        pkt.swap(txBorrowed);
+    }
+    // Nothing borrowed
+    if(!pkt) {
+        return -1;
+    }
+    // The application gave up sending the buffer
+    if(size < 0) {
+        return 0;
+    }
+    try {
+        pkt->commit(size);
+    }
+    // Committing more than the borrowed capacity
+    catch(std::range_error& ){
+        return -1;
+    }
+    int result = pushTxPacket(std::move(pkt), true);
+    return result < 0 ? result : size;
+}
+
+int Stream::borrowRead(const void** buf) {
+    // Fragmented messages are reassembled, there is no packet to lend
+    if(fragmentation) {
+        return -1;
+    }
+    PooledPacket pkt;
+    int result = popRxPacket(pkt, true);
+    if(result < 0) {
+        return result;
+    }
+    try {
+        removeStreamHeader(*pkt);
+    }
+    // Received wrong size packet
+    catch(std::range_error& ){
+        return -1;
+    }
+    *buf = pkt->data();
+    int size = pkt->size();
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(rx_mutex);
+#else
+        std::unique_lock<std::mutex> lck(rx_mutex);
+#endif
+        // A previously borrowed buffer is returned to the pool
+        rxBorrowed = std::move(pkt);
+    }
+    return size;
+}
+
+int Stream::releaseRead() {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(rx_mutex);
+#else
+    std::unique_lock<std::mutex> lck(rx_mutex);
+#endif
+    if(!rxBorrowed) {
+        return -1;
+    }
+    rxBorrowed.reset();
+    return 0;
+}
+
+int Stream::doWrite(const StreamIoVec* iov, int iovcnt, bool block) {
+
+    if (hasSendCallback) {
+        return -3;
+    }
+    if(fragmentation) {
+        return doWriteFragmented(iov, iovcnt, block);
+    }
+    // Don't fill a packet that can't be enqueued, pushTxPacket() checks again
+    if(block == false && info.getStatus() == StreamStatus::ESTABLISHED && txQueue.size() >= txDepth) {
+        txOverflows++;
+        return -4;
+    }
+
+    PooledPacket pkt;
+    if(newTxPacket(pkt) == false) {
+        return -1;
+    }
+    int size = 0;
+    try {
+        for(int i = 0; i < iovcnt; i++) {
+            pkt->put(iov[i].base, iov[i].size);
+            size += iov[i].size;
+        }
+    }
+    // Calling write with size too big
+    catch(std::range_error& ){
+        return -1;
+    }
+    int result = pushTxPacket(std::move(pkt), block);
+    return result < 0 ? result : size;
+}
+
+int Stream::doRead(const StreamIoVec* iov, int iovcnt, bool block) {
+    if(fragmentation) {
+        return doReadFragmented(iov, iovcnt, block);
+    }
+    PooledPacket pkt;
+    int result = popRxPacket(pkt, block);
+    if(result < 0) {
+        return result;
+    }
+    int size = 0;
+    try {
+        removeStreamHeader(*pkt);
+        for(int i = 0; i < iovcnt && pkt->size() > 0; i++) {
+            auto chunk = std::min<int>(iov[i].size, pkt->size());
+            pkt->get(iov[i].base, chunk);
+            size += chunk;
+        }
+        return size;
+    }
+    // Received wrong size packet
+    catch(std::range_error& ){
+        return -1;
+    }
+}
+
+int Stream::enableFragmentation(unsigned int maxMessageSize) {
+    if (hasSendCallback || hasRecvCallback) {
+        return -3;
+    }
+    if(maxMessageSize == 0 || maxMessageSize > maxFragments * fragmentPayloadSize()) {
+        return -1;
+    }
+    {
+        // Non blocking writes enqueue all the fragments of a message at once
+        const unsigned int payloadSize = fragmentPayloadSize();
+        unsigned int count = (maxMessageSize + payloadSize - 1) / payloadSize;
+        if(count > maxQueueDepth) count = maxQueueDepth;
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(tx_mutex);
+#else
+        std::unique_lock<std::mutex> lck(tx_mutex);
+#endif
+        if(count > txDepth) {
+            if(reservePool(count, rxDepth) == false)
+                return -2;
+            txDepth = count;
+        }
+    }
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(rx_frag_mutex);
+#else
+        std::unique_lock<std::mutex> lck(rx_frag_mutex);
+#endif
+        reassembly.resize(maxMessageSize);
+        rxFragState = FragmentState::IDLE;
+    }
+    fragmentation = true;
+    return 0;
+}
+
+int Stream::doWriteFragmented(const StreamIoVec* iov, int iovcnt, bool block) {
+    int total = 0;
+    for(int i = 0; i < iovcnt; i++) {
+        if(iov[i].size < 0) return -1;
+        total += iov[i].size;
+    }
+    const int payloadSize = fragmentPayloadSize();
+    // NOTE: an empty message is sent as a single empty fragment
+    const unsigned int count = std::max(1, (total + payloadSize - 1) / payloadSize);
+    if(count > maxFragments) {
+        return -1;
+    }
+
+    // Serialize writers, so that fragments of different messages
+    // are not interleaved
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(tx_frag_mutex);
+#else
+    std::unique_lock<std::mutex> lck(tx_frag_mutex);
+#endif
+    if(block == false && info.getStatus() == StreamStatus::ESTABLISHED) {
+        // All the fragments have to be enqueued at once
+        if(count > txDepth) {
+            return -1;
+        }
+        if(txQueue.size() + count > txDepth) {
+            txOverflows++;
+            return -4;
+        }
+    }
+    unsigned char seq = txMessageSeq++;
+    int iovIndex = 0;
+    int iovOffset = 0;
+    for(unsigned int i = 0; i < count; i++) {
+        PooledPacket pkt;
+        if(newTxPacket(pkt) == false) {
+            // The fragments already sent will be discarded by the receiver
+            return -1;
+        }
+        unsigned char header[fragmentHeaderSize];
+        header[0] = seq;
+        header[1] = i | (i == count - 1 ? lastFragmentFlag : 0);
+        pkt->put(header, sizeof(header));
+        // Gather the fragment payload from the iov buffers
+        int remaining = std::min<int>(payloadSize, total - i * payloadSize);
+        while(remaining > 0) {
+            int n = std::min(remaining, iov[iovIndex].size - iovOffset);
+            pkt->put(static_cast<const unsigned char*>(iov[iovIndex].base) + iovOffset, n);
+            remaining -= n;
+            iovOffset += n;
+            if(iovOffset == iov[iovIndex].size) {
+                iovIndex++;
+                iovOffset = 0;
+            }
+        }
+        int result = pushTxPacket(std::move(pkt), block);
+        if(result < 0) {
+            return result;
+        }
+    }
+    return total;
+}
+
+int Stream::doReadFragmented(const StreamIoVec* iov, int iovcnt, bool block) {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(rx_frag_mutex);
+#else
+    std::unique_lock<std::mutex> lck(rx_frag_mutex);
+#endif
+    for(;;) {
+        PooledPacket pkt;
+        int result = popRxPacket(pkt, block);
+        // A period without data in the middle of a message is not a loss,
+        // the writer may just be late. Lost fragments are detected by
+        // reassemble() from the fragment index, keep waiting for the rest
+        if(result == -1 && rxFragState == FragmentState::REASSEMBLING) {
+            continue;
+        }
+        if(result < 0) {
+            return result;
+        }
+        int size = reassemble(*pkt);
+        if(size < 0) {
+            continue;
+        }
+        // Message complete, scatter it to the application buffers
+        int copied = 0;
+        for(int i = 0; i < iovcnt && copied < size; i++) {
+            int chunk = std::min(iov[i].size, size - copied);
+            memcpy(iov[i].base, reassembly.data() + copied, chunk);
+            copied += chunk;
+        }
+        return copied;
+    }
+}
+
+int Stream::reassemble(Packet& pkt) {
+    unsigned char header[fragmentHeaderSize];
+    try {
+        removeStreamHeader(pkt);
+        pkt.get(header, sizeof(header));
+    }
+    // Received wrong size packet
+    catch(std::range_error& ){
+        return -1;
+    }
+    unsigned char seq = header[0];
+    unsigned int index = header[1] & ~lastFragmentFlag;
+    bool last = (header[1] & lastFragmentFlag) != 0;
+
+    if(rxFragState != FragmentState::IDLE && seq == rxMessageSeq) {
+        // Another fragment of a message that is being discarded
+        if(rxFragState == FragmentState::SKIPPING) {
+            if(last) rxFragState = FragmentState::IDLE;
+            return -1;
+        }
+        // Duplicate fragment
+        if(index < rxNextIndex) {
+            return -1;
+        }
+        // Some fragments in the middle of the message were lost
+        if(index > rxNextIndex) {
+            lostFragments += index - rxNextIndex;
+            droppedMessages++;
+            rxFragState = last ? FragmentState::IDLE : FragmentState::SKIPPING;
+            return -1;
+        }
+    } else {
+        // The tail of the previous message was lost
+        if(rxFragState == FragmentState::REASSEMBLING) {
+            lostFragments++;
+            droppedMessages++;
+        }
+        rxMessageSeq = seq;
+        // The head of this message was lost
+        if(index != 0) {
+            lostFragments += index;
+            droppedMessages++;
+            rxFragState = last ? FragmentState::IDLE : FragmentState::SKIPPING;
+            return -1;
+        }
+        rxFragState = FragmentState::REASSEMBLING;
+        rxNextIndex = 0;
+        reassemblySize = 0;
+    }
+
+    // Message larger than the reassembly buffer
+    if(reassemblySize + pkt.size() > reassembly.size()) {
+        droppedMessages++;
+        rxFragState = last ? FragmentState::IDLE : FragmentState::SKIPPING;
+        return -1;
+    }
+    unsigned int size = pkt.size();
+    pkt.get(reassembly.data() + reassemblySize, size);
+    reassemblySize += size;
+    rxNextIndex++;
+    if(last == false) {
+        return -1;
+    }
+    rxFragState = FragmentState::IDLE;
+    return reassemblySize;
+}
+
+unsigned int Stream::fragmentPayloadSize() const {
+    unsigned int headers = panHeaderSize + fragmentHeaderSize;
+    if(compactHeader == false) headers += sizeof(StreamId);
+#ifdef CRYPTO
+    if(authData) headers += tagSize;
+#endif
+    return Packet::maxSize() - headers;
+}
+
+int Stream::pushTxPacket(PooledPacket&& pkt, bool block) {
 
     if (hasSendCallback) {
         return -3;
@@ -85,38 +482,33 @@ int Stream::write(const void* data, int size) {
 #else
     std::unique_lock<std::mutex> lck(tx_mutex);
 #endif
-    // If we were called twice in a period, wait for the end of the period
-    if (wakeupAdvance == 0) { // only for streams not managed by the StreamWakeupScheduler
-        while((waiting || nextTxPacketReady) && info.getStatus() == StreamStatus::ESTABLISHED) {
+    if(block == false) {
+        if(info.getStatus() == StreamStatus::ESTABLISHED && txQueue.size() >= txDepth) {
+            txOverflows++;
+            return -4;
+        }
+    } else {
+        // If the queue is full, wait for the MAC to dequeue a packet
+        while(txQueue.size() >= txDepth && info.getStatus() == StreamStatus::ESTABLISHED) {
             tx_cv.wait(lck);
         }
+        // If we were called twice in a period, wait for the end of the period
+        if (wakeupAdvance == 0) { // only for streams not managed by the StreamWakeupScheduler
+            while(waiting && info.getStatus() == StreamStatus::ESTABLISHED) {
+                tx_cv.wait(lck);
+            }
+        }
     }
-    
     // The stream was closed
     if(info.getStatus() != StreamStatus::ESTABLISHED) {
         return -2;
     }
-    try {
-        StreamId id = info.getStreamId();
-        nextTxPacket.clear();
-#ifdef CRYPTO
-        if (authData) nextTxPacket.reserveTag();
-#endif
-        // Put panHeader to distinguish TDMH packets from other 802.15.4 packets
-        nextTxPacket.putPanHeader(panId);
-        // Put streamId to distinguish TDMH packets of this streams
-        nextTxPacket.put(&id, sizeof(StreamId));
-        nextTxPacket.put(data, size);
-        nextTxPacketReady = true;
-        return size;
-    }
-    // Calling write with size too big
-    catch(PacketOverflowException& ){
-        return -1;
-    }
+    // Can't fail, the queue size was checked and we are the only producer
+    txQueue.push(std::move(pkt));
+    return 0;
 }
 
-int Stream::read(void* data, int maxSize) {
+int Stream::popRxPacket(PooledPacket& pkt, bool block) {
 
     if (hasRecvCallback) {
         return -3;
@@ -127,87 +519,133 @@ int Stream::read(void* data, int maxSize) {
 #else
     std::unique_lock<std::mutex> lck(rx_mutex);
 #endif
-    // If we were called twice in a period, wait for the end of the period
-    while(alreadyReceivedShared == true && info.getStatus() == StreamStatus::ESTABLISHED) { 
-        rx_cv.wait(lck);
+    // Return queued data, if any, without waiting
+    if(popRxQueues(pkt)) {
+        lastReadPeriod = getRxPeriods();
+        return 0;
     }
-    // The stream was closed
-    if(info.getStatus() != StreamStatus::ESTABLISHED) { 
-        return -2;
+    if(block == false) {
+        // The stream was closed
+        if(info.getStatus() != StreamStatus::ESTABLISHED) {
+            return -2;
+        }
+        return -4;
     }
     // NOTE: read should block if called multiple times per period
     // even if no packet was received
-    alreadyReceivedShared = true;
-
-    if(receivedShared == true) {
-        receivedShared = false;
-        auto size = std::min<int>(maxSize, rxPacketShared.size());
-        try {
-            StreamId id;
-            rxPacketShared.removePanHeader();
-            rxPacketShared.get(&id, sizeof(StreamId));
-            rxPacketShared.get(data, size);
-            rxPacketShared.clear();
-            return size;
-        }
-        // Received wrong size packet
-        catch(PacketUnderflowException& ){
-            return -1;
-        }
+    while(getRxPeriods() == lastReadPeriod && info.getStatus() == StreamStatus::ESTABLISHED) {
+        rx_cv.wait(lck);
     }
+    // The stream was closed
+    if(info.getStatus() != StreamStatus::ESTABLISHED) {
+        return -2;
+    }
+    lastReadPeriod = getRxPeriods();
     // We did not receive any data this round
-    return -1;
+    if(popRxQueues(pkt) == false) {
+        return -1;
+    }
+    return 0;
+}
+
+int Stream::setRedundancyBounds(Redundancy minRed, Redundancy maxRed) {
+    int minCopies = toInt(minRed);
+    int maxCopies = toInt(maxRed);
+    if(minCopies < 0 || maxCopies < 0 || minCopies > maxCopies)
+        return -1;
+    // Lock mutex for concurrent access with periodicUpdate()
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(status_mutex);
+#else
+    std::unique_lock<std::mutex> lck(status_mutex);
+#endif
+    minRedundancy = minRed;
+    maxRedundancy = maxRed;
+    adaptiveRedundancy = true;
+    return 0;
+}
+
+int Stream::setQueueDepth(unsigned int tx, unsigned int rx) {
+    if(tx < 1 || tx > maxQueueDepth || rx < 1 || rx > maxQueueDepth)
+        return -1;
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(tx_mutex);
+#else
+    std::unique_lock<std::mutex> lck(tx_mutex);
+#endif
+    // The MAC keeps using the old receive depth until the next schedule
+    unsigned int macRx = macRxDepth.load(std::memory_order_relaxed);
+    if(reservePool(tx, rx > macRx ? rx : macRx) == false)
+        return -2;
+    txDepth = tx;
+    // A larger queue may unblock a pending write
+#ifdef _MIOSIX
+    tx_cv.signal();
+#else
+    tx_cv.notify_one();
+#endif
+    // Taken by the MAC when the next schedule is applied. Packets already
+    // queued beyond the new depth are kept, and read
+    rxDepth = rx;
+    return 0;
+}
+
+StreamQueueCounters Stream::getQueueCounters() {
+    StreamQueueCounters result;
+    result.txOverflows = txOverflows;
+    result.rxOverflows = rxOverflows;
+    result.lostFragments = lostFragments;
+    result.droppedMessages = droppedMessages;
+    return result;
 }
 
-bool Stream::receivePacket(const Packet& data) {
+unsigned char Stream::pollEvents() {
+    unsigned char events = 0;
+    if(info.getStatus() != StreamStatus::ESTABLISHED)
+        return STREAM_POLLHUP;
+    if(hasRecvCallback == false && (rxQueue.empty() == false || rxLatest.empty() == false))
+        events |= STREAM_POLLIN;
+    if(hasSendCallback == false && txQueue.size() < txDepth)
+        events |= STREAM_POLLOUT;
+    return events;
+}
+
+bool Stream::receivePacket(const PooledPacket& data) {
 #ifdef REDUNDANCY_DEBUG_CHECK
     if(received && rxCount > 0) {
-        if(rxPacket != data)
+        if(*rxPacket != *data)
             print_dbg("[E] Redundant Packet mismatch\n");
     }
 #endif
-    // NOTE: we use a duplicated rxPacket to acquire data before locking the mutex
+    // NOTE: we keep a reference in rxPacket to acquire data before locking the mutex
     rxPacket = data;
     received = true;
+    if(rxCount == 0) firstCopyReceived = true;
 
-    auto res = updateRxPacket();
-
-    // once per period execute receive callback if needed
-    if (rxCount == 0 && hasRecvCallback) {
-        receivePacketWithCallback();
-    }
-
-    return res;
+    return updateRxPacket();
 }
 
 bool Stream::missPacket() {
     // No data to receive
-    auto res = updateRxPacket();
-
-    // once per period execute receive callback if needed
-    if (rxCount == 0 && hasRecvCallback) {
-        receivePacketWithCallback();
-    }
-    
-    return res;
+    return updateRxPacket();
 }
 
-bool Stream::sendPacket(Packet& data) {
+bool Stream::sendPacket(PooledPacket& data) {
     // Stream Redundancy logic
     // NOTE: We update the packet before sending it
     // for the first time of the current period.
     if(txCount == 0) {
         // once per period execute send callback if needed
-        if (hasSendCallback) {
+        if (hasSendCallback)
             sendPacketWithCallback();
-        }
-        updateTxPacket();
+        else
+            updateTxPacket();
     }
     if(++txCount >= redundancyCount) {
         txCount = 0;
         seqNo++;
     }
-    // Copy the txPacket to the DataPhase
+    // Share the txPacket with the DataPhase
     if(txPacketReady)
         data = txPacket;
 
@@ -216,22 +654,16 @@ bool Stream::sendPacket(Packet& data) {
 
 void Stream::receivePacketWithCallback()
 {
-    if (receivedShared) // if something received in the current period
+    if (received) // if something received in the current period
     {
-        receivedShared = false;
+        removeStreamHeader(*rxPacket);
         
-        StreamId id;
-        rxPacketShared.removePanHeader();
-        rxPacketShared.get(&id, sizeof(StreamId));
-        
-        unsigned int dataSize = std::min<unsigned int>(rxPacketShared.maxSize(), rxPacketShared.size());
-        unsigned char bytes[dataSize] = {0};
-        rxPacketShared.get(bytes, dataSize);
-        rxPacketShared.clear();
-        recvCallback(bytes, &dataSize, info.getStatus());
+        // The callback accesses the payload in place, no copy is made
+        unsigned int dataSize = rxPacket->size();
+        recvCallback(rxPacket->data(), &dataSize, info.getStatus());
     }
     else { // if only misses in current period
-        unsigned char bytes[rxPacketShared.maxSize()] = {0};
+        unsigned char bytes[Packet::maxSize()] = {0};
         unsigned int dataSize = 0;
         recvCallback(bytes, &dataSize, info.getStatus());
     }
@@ -239,24 +671,25 @@ void Stream::receivePacketWithCallback()
 
 void Stream::sendPacketWithCallback()
 {
-    unsigned char bytes[nextTxPacket.maxSize()];
+    unsigned char bytes[Packet::maxSize()];
     unsigned int dataSize; // actual data size to be put in packet
     sendCallback(bytes, &dataSize, info.getStatus());
 
-    StreamId id = info.getStreamId();
-    nextTxPacket.clear();
-
+    // The packet is built directly in txPacket, bypassing the queue
+    txPacketReady = false;
+    txPacket = allocatePacket();
+    if(!txPacket) {
+        print_dbg("[E] Stream: packet pool exhausted\n");
+        return;
+    }
 #ifdef CRYPTO
-    if (authData) nextTxPacket.reserveTag();
+    if (authData) txPacket->reserveTag();
 #endif
     // Set data into the DataPhase
-    // Put panHeader to distinguish TDMH packets from other 802.15.4 packets
-    nextTxPacket.putPanHeader(panId);
-    // Put streamId to distinguish TDMH packets of this streams
-    nextTxPacket.put(&id, sizeof(StreamId));
-    nextTxPacket.put(bytes, dataSize);
+    putStreamHeader(*txPacket);
+    txPacket->put(bytes, dataSize);
     
-    nextTxPacketReady = true;
+    txPacketReady = true;
 }
 
 void Stream::addedStream(StreamParameters newParams) {
@@ -461,6 +894,17 @@ void Stream::periodicUpdate(StreamManager* mgr) {
             mgr->enqueueSME(StreamManagementElement(info, SMEType::CLOSED));
         }
         break;
+    case StreamStatus::ESTABLISHED:
+        if(reportReady && adaptiveRedundancy) {
+            // Send DELIVERY_REPORT SME, a newer report overwrites the
+            // previous one if it has not yet been forwarded
+            StreamDeliveryReport report(lastReport.lost, lastReport.rescued,
+                                        minRedundancy, maxRedundancy);
+            mgr->enqueueSME(StreamManagementElement::makeDeliveryReportSME(
+                                info.getStreamId(), report));
+        }
+        reportReady = false;
+        break;
     default:
         break;
     }
@@ -517,6 +961,29 @@ bool Stream::desync() {
     return deletable;
 }
 
+unsigned int Stream::poolFootprint(const NetworkConfiguration& config,
+                                   unsigned int tx, unsigned int rx) {
+    // Besides the queues, the packet being transmitted, the one being
+    // received and the one lent by borrowWrite()
+    unsigned int result = tx + rx + 3;
+    if(config.getCombineRedundantCopies()) result += maxRedundantCopies;
+    return result;
+}
+
+bool Stream::reservePool(unsigned int tx, unsigned int rx) {
+    const unsigned int needed = poolOverhead + tx + rx;
+    if(needed > poolReserved) {
+        // NOTE: when a node has more streams than the pool was sized for,
+        // the stream is created anyway, but it can't allocate packets until
+        // a reservation succeeds
+        if(pool.reserve(needed - poolReserved) == false) return false;
+    } else {
+        pool.unreserve(poolReserved - needed);
+    }
+    poolReserved = needed;
+    return true;
+}
+
 void Stream::updateRedundancy() {
     redundancy = info.getRedundancy();
     // No redundancy: notify after receiving
@@ -535,6 +1002,37 @@ void Stream::updateRedundancy() {
     }
 }
 
+void Stream::putStreamHeader(Packet& pkt) {
+    StreamId id = info.getStreamId();
+    if(compactHeader) {
+        // The stream is known from the schedule, the panHeader sequence
+        // number carries only a truncated hash of the StreamId
+        pkt.putPanHeader(panId, id.getCompactTag());
+    } else {
+        // Put panHeader to distinguish TDMH packets from other 802.15.4 packets
+        pkt.putPanHeader(panId);
+        // Put streamId to distinguish TDMH packets of this streams
+        pkt.put(&id, sizeof(StreamId));
+    }
+}
+
+bool Stream::newTxPacket(PooledPacket& pkt) {
+    pkt = allocatePacket();
+    if(!pkt) {
+        return false;
+    }
+#ifdef CRYPTO
+    if (authData) pkt->reserveTag();
+#endif
+    putStreamHeader(*pkt);
+    return true;
+}
+
+void Stream::removeStreamHeader(Packet& pkt) {
+    pkt.removePanHeader();
+    if(compactHeader == false) pkt.discard(sizeof(StreamId));
+}
+
 void Stream::wakeWriteRead() {
     {
         // Lock mutex for shared access with application thread
@@ -570,7 +1068,7 @@ void Stream::wakeWriteRead() {
     // call both callbacks, if specified, in order to signal to the
     // application the new stream status (application may be stuck waiting
     // on some condition variable or simply a feedback is needed)
-    unsigned char bytes[rxPacketShared.maxSize()] = {0};
+    unsigned char bytes[Packet::maxSize()] = {0};
     unsigned int dataSize = 0;
     if (hasSendCallback) {
         sendCallback(bytes, &dataSize, info.getStatus());
@@ -586,53 +1084,115 @@ bool Stream::updateRxPacket() {
         // Reset received packet counter
         rxCount = 0;
         seqNo++;
-        {
-            // Lock mutex for shared access with application thread
-#ifdef _MIOSIX
-            miosix::Lock<miosix::FastMutex> lck(rx_mutex);
-#else
-            std::unique_lock<std::mutex> lck(rx_mutex);
-#endif
-            // Copy received packet to variabled shared with application
-            rxPacketShared = rxPacket;
-            receivedShared = received;
-            alreadyReceivedShared = false;
-            rxPacket.clear();
-            received = false;
-            // Wake up the read method
-#ifdef _MIOSIX
-            rx_cv.signal();
-#else
-            rx_cv.notify_one();
-#endif
+        if(hasRecvCallback) {
+            // once per period execute receive callback
+            receivePacketWithCallback();
+        } else if(received) {
+            // Hand the received packet over to the application. On overflow
+            // a deeper queue drops the newest packet, so that bursts are
+            // read in order, while a single packet slot keeps the latest.
+            // Neither takes a lock, the MAC never waits for the application
+            unsigned int depth = macRxDepth.load(std::memory_order_relaxed);
+            if(depth == 1) {
+                if(rxLatest.put(std::move(rxPacket))) rxOverflows++;
+            } else if(rxQueue.size() >= depth || rxQueue.push(std::move(rxPacket)) == false) {
+                rxOverflows++;
+            }
+        }
+        // Delivery statistics, see setRedundancyBounds()
+        if(received == false) reportLost++;
+        else if(firstCopyReceived == false) reportRescued++;
+        if(++reportPeriods >= StreamDeliveryReport::deliveryReportPeriods) {
+            lastReport = StreamDeliveryReport(reportLost, reportRescued,
+                                              Redundancy::NONE, Redundancy::NONE);
+            reportReady = true;
+            reportPeriods = 0;
+            reportLost = 0;
+            reportRescued = 0;
         }
+        rxPacket.reset();
+        received = false;
+        firstCopyReceived = false;
+        clearCorruptedCopies();
+        rxPeriods.fetch_add(1, std::memory_order_release);
+        // The read method is woken up later, by notify()
+        rxNotify = true;
 
         return true;
     }
     return false;
 }
 
+void Stream::keepCorruptedCopy(const PooledPacket& pkt, short rssi) {
+    // Transceivers that drop the bytes of a corrupted frame give no copy
+    if(corruptedCount >= maxRedundantCopies || pkt->size() == 0) return;
+    corruptedCopies[corruptedCount] = pkt;
+    corruptedRssi[corruptedCount] = rssi;
+    corruptedCount++;
+}
+
+PooledPacket Stream::combineCorruptedCopies() {
+    PooledPacket result;
+    if(received) return result;
+    if(corruptedCount == 3) {
+        result = allocatePacket();
+        if(result && combineMajority(*result, *corruptedCopies[0],
+                                     *corruptedCopies[1], *corruptedCopies[2]))
+            return result;
+    }
+    // The error may be in the CRC bytes only, try the strongest copy
+    if(corruptedCount > 0)
+        result = corruptedCopies[strongestCopy(corruptedRssi, corruptedCount)];
+    else
+        result.reset();
+    return result;
+}
+
+void Stream::clearCorruptedCopies() {
+    for(unsigned int i = 0; i < corruptedCount; i++)
+        corruptedCopies[i].reset();
+    corruptedCount = 0;
+}
+
 void Stream::updateTxPacket() {
-    // Lock mutex for shared access with application thread
-#ifdef _MIOSIX
-    miosix::Lock<miosix::FastMutex> lck(tx_mutex);
-#else
-    std::unique_lock<std::mutex> lck(tx_mutex);
-#endif
-    // Packet for next period is ready
-    if(nextTxPacketReady == true) {
-        txPacket = nextTxPacket;
-        txPacketReady = true;
-        nextTxPacketReady = false;
+    // The queue is popped without locking, the write method is woken up
+    // later, by notify()
+    txPacketReady = txQueue.pop(txPacket);
+    if(txPacketReady)
+        txNotify = true;
+    else
+        txPacket.reset();
+}
+
+bool Stream::notify() {
+    // NOTE: the mutex is only tried, if the application is holding it we
+    // retry later rather than making the MAC thread wait for the application.
+    // Taking the mutex before signaling prevents lost wakeups, as the
+    // application checks its wait condition with the mutex locked
 #ifdef _MIOSIX
+    if(txNotify && tx_mutex.tryLock()) {
         tx_cv.signal();
+        tx_mutex.unlock();
+        txNotify = false;
+    }
+    if(rxNotify && rx_mutex.tryLock()) {
+        rx_cv.signal();
+        rx_mutex.unlock();
+        rxNotify = false;
+    }
 #else
+    if(txNotify && tx_mutex.try_lock()) {
         tx_cv.notify_one();
-#endif
+        tx_mutex.unlock();
+        txNotify = false;
     }
-    // Packet for next period is NOT ready
-    else
-        txPacketReady = false;
+    if(rxNotify && rx_mutex.try_lock()) {
+        rx_cv.notify_one();
+        rx_mutex.unlock();
+        rxNotify = false;
+    }
+#endif
+    return txNotify == false && rxNotify == false;
 }
 
 int Server::listen(StreamManager* mgr) {
@@ -30,15 +30,20 @@
 #include "../network_configuration.h"
 #include "../tdmh.h"
 #include "../util/packet.h"
+#include "../util/packet_pool.h"
+#include "../util/spsc_queue.h"
+#include "../util/latest_slot.h"
 #include "stream_management_element.h"
 #ifdef CRYPTO
 #include "../crypto/hash.h"
 #include "../crypto/aes_ocb.h"
 #endif
+#include <atomic>
 #include <list>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <vector>
 #ifdef _MIOSIX
 #include <miosix.h>
 #include <kernel/intrusive.h>
@@ -100,6 +105,65 @@ public:
         //This method should never be called on the base class
         return -1;
     }
+    // Used by derived class Stream
+    virtual int tryWrite(const void* data, int size) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int tryRead(void* data, int maxSize) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int setQueueDepth(unsigned int tx, unsigned int rx) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual StreamQueueCounters getQueueCounters() { return StreamQueueCounters(); }
+    // Used by derived class Stream
+    virtual int writev(const StreamIoVec* iov, int iovcnt) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int readv(const StreamIoVec* iov, int iovcnt) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int borrowWrite(void** buf) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int commitWrite(int size) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int borrowRead(const void** buf) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int releaseRead() {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int enableFragmentation(unsigned int maxMessageSize) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream
+    virtual int setRedundancyBounds(Redundancy minRed, Redundancy maxRed) {
+        //This method should never be called on the base class
+        return -1;
+    }
+    // Used by derived class Stream, returns a bitmask of StreamPollEvent
+    virtual unsigned char pollEvents() { return STREAM_POLLHUP; }
 
     // Used by derived class Stream
     virtual void wait() {}
@@ -112,11 +176,11 @@ public:
 
     // TODO: The base class implementation of these functions should throw an error?
     // Used by derived class Stream 
-    virtual bool receivePacket(const Packet& data) { return false; }
+    virtual bool receivePacket(const PooledPacket& data) { return false; }
     // Used by derived class Stream
     virtual bool missPacket() { return false; }
     // Used by derived class Stream 
-    virtual bool sendPacket(Packet& data) { return false; }
+    virtual bool sendPacket(PooledPacket& data) { return false; }
     // Used by derived class Stream 
     virtual void addedStream(StreamParameters newParams) {}
     // Used by derived class Stream
@@ -213,28 +277,47 @@ protected:
 class Stream : public Endpoint {
 public:
 #ifdef CRYPTO
-    Stream(const NetworkConfiguration& config, int fd, StreamInfo info,
-                                                 const unsigned char key[16]) :
+    Stream(const NetworkConfiguration& config, PacketPool& pool, int fd,
+           StreamInfo info, const unsigned char key[16]) :
             Endpoint(config, fd, info), panId(config.getPanId()),
-            ocb(key), authData(config.getAuthenticateDataMessages())
+            compactHeader(config.getCompactDataHeader()), pool(pool),
+            poolOverhead(poolFootprint(config, 0, 0)), ocb(key), authData(config.getAuthenticateDataMessages())
     {
         updateRedundancy();
+        reservePool(txDepth, rxDepth);
     }
 
-    Stream(const NetworkConfiguration& config, int fd, StreamInfo info) :
+    Stream(const NetworkConfiguration& config, PacketPool& pool, int fd,
+           StreamInfo info) :
             Endpoint(config, fd, info), panId(config.getPanId()),
+            compactHeader(config.getCompactDataHeader()), pool(pool),
+            poolOverhead(poolFootprint(config, 0, 0)),
             authData(config.getAuthenticateDataMessages()) 
     {
         updateRedundancy();
+        reservePool(txDepth, rxDepth);
     }
 #else
-    Stream(const NetworkConfiguration& config, int fd, StreamInfo info) :
-            Endpoint(config, fd, info), panId(config.getPanId())
+    Stream(const NetworkConfiguration& config, PacketPool& pool, int fd,
+           StreamInfo info) :
+            Endpoint(config, fd, info), panId(config.getPanId()),
+            compactHeader(config.getCompactDataHeader()), pool(pool),
+            poolOverhead(poolFootprint(config, 0, 0))
     {
         updateRedundancy();
+        reservePool(txDepth, rxDepth);
     }
 #endif
 
+    ~Stream() {
+        pool.unreserve(poolReserved);
+    }
+
+    // Number of packets of the pool a stream with queues of tx and rx
+    // packets can hold at the same time
+    static unsigned int poolFootprint(const NetworkConfiguration& config,
+                                      unsigned int tx, unsigned int rx);
+
     // Called by StreamManager after creation,
     // used to send CONNECT SME and wait for addedStream()
     int connect(StreamManager* mgr) override;
@@ -244,6 +327,64 @@ public:
 
     // Called by StreamAPI, to get from recvBuffer received data
     int read(void* data, int maxSize) override;
+
+    // Called by StreamAPI, like write() but returns -4 instead of blocking
+    // when the transmit queue is full
+    int tryWrite(const void* data, int size) override;
+
+    // Called by StreamAPI, like read() but returns -4 instead of blocking
+    // when the receive queue is empty
+    int tryRead(void* data, int maxSize) override;
+
+    // Called by StreamAPI, set the number of packets that can be queued
+    // for transmission and after reception, at most maxQueueDepth.
+    // Returns -2 if the packet pool cannot cover the larger queues
+    int setQueueDepth(unsigned int tx, unsigned int rx) override;
+
+    // Called by StreamAPI, returns the number of packets rejected because
+    // a queue was full
+    StreamQueueCounters getQueueCounters() override;
+
+    // Called by StreamAPI, like write() but gathers the packet payload
+    // from multiple buffers
+    int writev(const StreamIoVec* iov, int iovcnt) override;
+
+    // Called by StreamAPI, like read() but scatters the packet payload
+    // to multiple buffers
+    int readv(const StreamIoVec* iov, int iovcnt) override;
+
+    // Called by StreamAPI, lends the payload area of a new packet to the
+    // application, that can write in it and then call commitWrite().
+    // Returns the size of the area, that accounts for headers and tag
+    int borrowWrite(void** buf) override;
+
+    // Called by StreamAPI, enqueues the packet lent by borrowWrite() with
+    // size bytes of payload, or discards it if size is negative
+    int commitWrite(int size) override;
+
+    // Called by StreamAPI, like read() but lends the received payload
+    // instead of copying it. The buffer is valid until releaseRead()
+    // or the next borrowRead() call
+    int borrowRead(const void** buf) override;
+
+    // Called by StreamAPI, returns the buffer lent by borrowRead()
+    int releaseRead() override;
+
+    // Called by StreamAPI, from now on write() splits messages of up to
+    // maxMessageSize bytes across packets sent in the following periods,
+    // and read() reassembles them, detecting lost fragments by their index. Must be enabled on both endpoints.
+    // The transmit queue is enlarged to hold a whole message, returns -2
+    // if the packet pool cannot cover it
+    int enableFragmentation(unsigned int maxMessageSize) override;
+
+    // Called by StreamAPI, lets the master adapt the redundancy of the
+    // stream between minRed and maxRed, based on the delivery statistics
+    // periodically reported by this endpoint if it receives data
+    int setRedundancyBounds(Redundancy minRed, Redundancy maxRed) override;
+
+    // Called by StreamManager, returns the events that would not make
+    // tryRead() or tryWrite() return -4
+    unsigned char pollEvents() override;
     
     // Called by the application in order to wait for the next stream sending slot
     void wait() override;
@@ -265,17 +406,21 @@ public:
         return wakeupAdvance;
     }
 
-    // Called by StreamManager, to put data to recvBuffer
+    // Called by StreamManager, to put data to recvBuffer.
+    // The packet is shared, not copied, so the caller must not modify it
+    // afterwards
     // Return true at the end of each period
-    bool receivePacket(const Packet& data) override;
+    bool receivePacket(const PooledPacket& data) override;
 
     // Called by StreamManager, when we missed an inbound packet
     // Return true if we have data to send
     bool missPacket() override;
 
-    // Called by StreamManager, to get data from sendBuffer
+    // Called by StreamManager, to get data from sendBuffer.
+    // data is set to point to the packet of the stream, that is shared by
+    // all the redundant transmissions of the same period
     // Return true if we have data to send
-    bool sendPacket(Packet& data) override;
+    bool sendPacket(PooledPacket& data) override;
 
     // Called by StreamManager when this stream is present in a received schedule
     void addedStream(StreamParameters newParams) override;
@@ -301,19 +446,72 @@ public:
     // Called by StreamManager, in a periodic way to allow resending SME
     void periodicUpdate(StreamManager* mgr) override;
 
+    // Called by the DataPhase after the timing critical part of a slot,
+    // wakes up the application threads waiting for the packets exchanged
+    // by sendPacket(), receivePacket() and missPacket().
+    // Never blocks, returns false if some notification is still pending
+    // and notify() has to be called again later
+    bool notify();
+
+    // Called by the DataPhase, true if notify() needs to be called
+    bool notificationPending() const { return txNotify || rxNotify; }
+
     // Called by StreamManager after applying a new schedule
-    // Resets the redundancy counters to avoid errors
+    // Resets the redundancy counters to avoid errors, and takes the receive
+    // queue depth the MAC uses until the next schedule
     void resetCounters() {
+        macRxDepth.store(rxDepth.load(std::memory_order_relaxed), std::memory_order_relaxed);
         txCount = 0;
         rxCount = 0;
+        clearCorruptedCopies();
+        // Statistics measured with the old redundancy are no longer relevant
+        reportPeriods = 0;
+        reportLost = 0;
+        reportRescued = 0;
+        firstCopyReceived = false;
+        reportReady = false;
+    }
+
+    // Called by the DataPhase, true if the next receivePacket() or
+    // missPacket() call is for the last redundant copy of the period
+    bool isLastCopy() const { return rxCount + 1u >= redundancyCount; }
+
+    // Called by the DataPhase, true if a valid copy of the packet of the
+    // current period has already been received
+    bool hasReceived() const { return received; }
+
+    // Allocate a packet from the share of the pool reserved by the stream,
+    // used by the stream itself and by the DataPhase to receive. Returns an
+    // empty handle if the stream could not reserve its share
+    PooledPacket allocatePacket() {
+        if(poolReserved == 0) return PooledPacket();
+        return pool.allocate(PoolClass::STREAM);
     }
 
+    // Called by the DataPhase when combining redundant copies, to keep a
+    // copy of the packet of the current period that failed the CRC check
+    void keepCorruptedCopy(const PooledPacket& pkt, short rssi);
+
+    // Called by the DataPhase on the last redundant copy of a period, if no
+    // copy was received correctly. Returns the bitwise majority of three
+    // corrupted copies or else the corrupted copy received with the highest
+    // RSSI. The returned packet must be verified with its OCB tag by the
+    // caller, an empty handle is returned if there is no candidate
+    PooledPacket combineCorruptedCopies();
+
     void resetSequenceNumber() {
         seqNo = 1;
     }
 
     unsigned long long getSequenceNumber() { return seqNo; }
 
+    // Called by StreamManager when the stream is removed from its maps.
+    // The DataPhase may keep referencing the stream through the explicit
+    // schedule, and uses this to stop sending and receiving for it
+    void detach() { detached = true; }
+
+    bool isDetached() const { return detached; }
+
     // Called by StreamManager when the Timesync desynchronizes, used to
     // close the stream system-side in certain conditions
     // Returns true if the Stream class can be deleted
@@ -339,6 +537,11 @@ public:
         ocb_next = std::move(tmp);
     }
 
+    // Set an OCB already initialized with the new key
+    void setNewOCB(AesOcb& next) {
+        ocb_next = std::move(next);
+    }
+
     void applyNewKey() { 
         ocb = std::move(ocb_next);
     }
@@ -348,9 +551,21 @@ public:
 
 private:
     const unsigned short panId;
-
-    Packet txPacket;
-    Packet rxPacket;
+    /* Cached from NetworkConfiguration, see getCompactDataHeader() */
+    const bool compactHeader;
+    /* Pool from which all the packet buffers of the stream are allocated,
+       buffers are passed around by handle and never copied */
+    PacketPool& pool;
+    /* Packets of the pool held by the stream besides its queues, and
+       packets reserved for the stream, see reservePool() */
+    const unsigned int poolOverhead;
+    unsigned int poolReserved = 0;
+
+    /* Maximum depth of the transmit and receive queues */
+    static const unsigned int maxQueueDepth = 8;
+
+    PooledPacket txPacket;
+    PooledPacket rxPacket;
     /* Cached Redundancy Info */
     Redundancy redundancy;
     unsigned int redundancyCount = 0;
@@ -359,17 +574,80 @@ private:
     unsigned char rxCount = 0;
     bool received = false;
     bool txPacketReady = false;
+    /* Delivery statistics, see setRedundancyBounds(). Accessed only by the
+       MAC thread, except the bounds that are protected by status_mutex */
+    bool adaptiveRedundancy = false;
+    Redundancy minRedundancy = Redundancy::NONE;
+    Redundancy maxRedundancy = Redundancy::NONE;
+    bool firstCopyReceived = false;
+    bool reportReady = false;
+    unsigned char reportPeriods = 0;
+    unsigned char reportLost = 0;
+    unsigned char reportRescued = 0;
+    // Statistics of the last complete window, valid if reportReady is true
+    StreamDeliveryReport lastReport;
     /* Variables shared with the application thread */
-    bool receivedShared = false;
+    // Written by the application, read by the MAC
+    SpscQueue<PooledPacket, maxQueueDepth> txQueue;
+    // Written by the MAC, read by the application. With a receive depth of
+    // one the latest packet is handed over in rxLatest instead
+    SpscQueue<PooledPacket, maxQueueDepth> rxQueue;
+    LatestSlot<PooledPacket> rxLatest;
+    // Used queue depth, set by the application
+    unsigned int txDepth = 1;
+    std::atomic<unsigned int> rxDepth{1};
+    // Snapshot of rxDepth used by the MAC, taken by resetCounters()
+    std::atomic<unsigned int> macRxDepth{1};
+    // Incremented by both the application and the MAC thread
+    std::atomic<unsigned int> txOverflows{0};
+    std::atomic<unsigned int> rxOverflows{0};
+    // Number of receive periods elapsed, written only by the MAC
+    std::atomic<unsigned int> rxPeriods{0};
     // NOTE: make sure that the first read waits for data to be present
-    bool alreadyReceivedShared = true;
-    bool nextTxPacketReady = false;
-    Packet rxPacketShared;
-    Packet nextTxPacket;
+    unsigned int lastReadPeriod = 0;
+    /* Fragmentation, see enableFragmentation().
+     * Each fragment starts with the message sequence number and the index
+     * of the fragment, whose most significant bit flags the last fragment */
+    enum class FragmentState : unsigned char {
+        IDLE,         // No message being received
+        REASSEMBLING, // Fragments received in order up to rxNextIndex
+        SKIPPING      // Message with lost fragments, discarding the rest
+    };
+    static const unsigned int fragmentHeaderSize = 2;
+    static const unsigned char lastFragmentFlag = 0x80;
+    static const unsigned int maxFragments = 128;
+    bool fragmentation = false;
+    // Protected by tx_frag_mutex
+    unsigned char txMessageSeq = 0;
+    // Protected by rx_frag_mutex
+    std::vector<unsigned char> reassembly;
+    unsigned int reassemblySize = 0;
+    FragmentState rxFragState = FragmentState::IDLE;
+    unsigned char rxMessageSeq = 0;
+    unsigned int rxNextIndex = 0;
+    std::atomic<unsigned int> lostFragments{0};
+    std::atomic<unsigned int> droppedMessages{0};
+
+    /* Copies of the packet of the current period that failed the CRC check,
+     * see keepCorruptedCopy(). Accessed only by the MAC */
+    static const unsigned int maxRedundantCopies = 3;
+    PooledPacket corruptedCopies[maxRedundantCopies];
+    short corruptedRssi[maxRedundantCopies];
+    unsigned int corruptedCount = 0;
+
+    /* Buffers lent to the application, protected by tx_mutex and rx_mutex */
+    PooledPacket txBorrowed;
+    PooledPacket rxBorrowed;
+    /* Notifications deferred out of the slot, accessed only by the MAC */
+    bool txNotify = false;
+    bool rxNotify = false;
 
     /* Indicate whether the stream is in waiting state or not */
     bool waiting = false;
 
+    /* Set when the stream is removed from the StreamManager */
+    volatile bool detached = false;
+
     // Streams optimization
     unsigned int wakeupAdvance = 0; // ns
     const unsigned int wakeupAdvanceSlackTime = 10000; // ns
@@ -389,16 +667,21 @@ private:
 
     /* Thread synchronization */
 #ifdef _MIOSIX
-    // Protects concurrent access at sendBuffer
+    // Serializes application writers, the MAC only tries to lock it
     miosix::FastMutex tx_mutex;
-    // Protects concurrent access at recvBuffer
+    // Serializes application readers, the MAC only tries to lock it
     miosix::FastMutex rx_mutex;
+    // Serialize fragmented writes and reads, used only by the application
+    miosix::FastMutex tx_frag_mutex;
+    miosix::FastMutex rx_frag_mutex;
     miosix::ConditionVariable connect_cv;
     miosix::ConditionVariable tx_cv;
     miosix::ConditionVariable rx_cv;
 #else
     std::mutex tx_mutex;
     std::mutex rx_mutex;
+    std::mutex tx_frag_mutex;
+    std::mutex rx_frag_mutex;
     std::condition_variable connect_cv;
     std::condition_variable tx_cv;
     std::condition_variable rx_cv;
@@ -409,6 +692,48 @@ private:
 
     // Called by Stream itself, used to update cached redundancy info
     void updateRedundancy();
+    // Called by Stream itself, adjust the packets of the pool reserved for
+    // queues of tx and rx packets. Return false, leaving the reservation
+    // unchanged, if the pool cannot cover them. Called with tx_mutex locked
+    bool reservePool(unsigned int tx, unsigned int rx);
+    // Called by Stream itself, put in the packet the panHeader and either
+    // the StreamId or, with compact header, the stream tag
+    void putStreamHeader(Packet& pkt);
+    // Common implementation of the write methods, if block is false
+    // returns -4 instead of waiting for the queue to have free space
+    int doWrite(const StreamIoVec* iov, int iovcnt, bool block);
+    // Common implementation of the read methods, if block is false
+    // returns -4 instead of waiting for the end of the period
+    int doRead(const StreamIoVec* iov, int iovcnt, bool block);
+    // Implementation of the write and read methods in fragmentation mode
+    int doWriteFragmented(const StreamIoVec* iov, int iovcnt, bool block);
+    int doReadFragmented(const StreamIoVec* iov, int iovcnt, bool block);
+    // Called by doReadFragmented(), add a fragment to the message being
+    // reassembled. Return the message size if complete, -1 otherwise
+    int reassemble(Packet& pkt);
+    // Maximum payload of a fragment, after stream and fragment headers
+    unsigned int fragmentPayloadSize() const;
+    // Called by the write methods, allocates a packet and puts the stream
+    // header in it. Return false if the pool is empty
+    bool newTxPacket(PooledPacket& pkt);
+    // Called by the write methods, push a filled packet in txQueue
+    // Return 0 on success or the error code of write()
+    int pushTxPacket(PooledPacket&& pkt, bool block);
+    // Called by the read methods, pop a packet from rxQueue
+    // Return 0 on success or the error code of read()
+    int popRxPacket(PooledPacket& pkt, bool block);
+    // Called by popRxPacket(), take the oldest received packet. Packets
+    // left in the one not used by the MAC since the last schedule are older
+    bool popRxQueues(PooledPacket& pkt) {
+        if(macRxDepth.load(std::memory_order_relaxed) == 1)
+            return rxQueue.pop(pkt) || rxLatest.take(pkt);
+        return rxLatest.take(pkt) || rxQueue.pop(pkt);
+    }
+    // Called by Stream itself, remove the header added by putStreamHeader()
+    void removeStreamHeader(Packet& pkt);
+    unsigned int getRxPeriods() const {
+        return rxPeriods.load(std::memory_order_acquire);
+    }
     // Called by Stream itself, when the stream status changes and we need to wake up
     // the write and read methods
     void wakeWriteRead();
@@ -419,9 +744,10 @@ private:
     // Used to update internal variables every stream period
     // Return true at the end of each period
     bool updateRxPacket();
-    // Called by Stream::sendPacket() on the first period, and
-    // at the end of every period.
-    // Used to update txPacket, the packet being sent
+    // Called at the end of every period, return the corrupted copies to the pool
+    void clearCorruptedCopies();
+    // Called by Stream::sendPacket() at the start of every period.
+    // Used to update txPacket, the packet being sent, from txQueue
     void updateTxPacket();
 
     void receivePacketWithCallback();
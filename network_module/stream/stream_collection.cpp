@@ -101,6 +101,23 @@ std::map<StreamId, StreamChange> StreamSnapshot::getStreamChanges(const std::lis
     return result;
 }
 
+std::vector<StreamId> StreamSnapshot::revertFailedRaises(const std::list<ScheduleElement>& schedule) {
+    std::vector<StreamId> result;
+    for(auto& pair : collection) {
+        auto& stream = pair.second;
+        if(stream.getStatus() != MasterStreamStatus::ESTABLISHED ||
+           stream.isRaisePending() == false)
+            continue;
+        auto it = std::find_if(schedule.begin(), schedule.end(),
+            [&](const ScheduleElement& el) { return el.getStreamId() == pair.first; });
+        if(it != schedule.end())
+            continue;
+        stream.revertRaise();
+        result.push_back(pair.first);
+    }
+    return result;
+}
+
 void StreamCollection::receiveSMEs(UpdatableQueue<SMEKey,
                                    StreamManagementElement>& smes
 #ifdef CRYPTO
@@ -199,6 +216,25 @@ void StreamCollection::applyChanges(const std::map<StreamId, StreamChange>& chan
     }
 }
 
+void StreamCollection::revertRaises(const std::vector<StreamId>& ids) {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::Mutex> lck(coll_mutex);
+#else
+    std::unique_lock<std::mutex> lck(coll_mutex);
+#endif
+    for(auto& id : ids) {
+        auto it = collection.find(id);
+        if(it == collection.end() || it->second.isRaisePending() == false)
+            continue;
+        auto& stream = it->second;
+        stream.revertRaise();
+        stream.setRaiseHold(reportsHeldAfterRevert);
+        if(SCHEDULER_SUMMARY_DBG)
+            print_dbg("[SC] Stream (%d,%d,%d,%d) redundancy raise does not fit, reverted\n",
+                      id.src,id.dst,id.srcPort,id.dstPort);
+    }
+}
+
 std::vector<MasterStreamInfo> StreamCollection::getStreams() {
 #ifdef _MIOSIX
     miosix::Lock<miosix::Mutex> lck(coll_mutex);
@@ -267,6 +303,9 @@ void StreamCollection::updateStream(MasterStreamInfo& stream, StreamManagementEl
                         print_dbg("[SC] schedule resend due to CONNECT while ESTABLISHED (%d,%d,%d,%d)\n",
                                   id.src,id.dst,id.srcPort,id.dstPort);
                     break;
+                case SMEType::DELIVERY_REPORT:
+                    adaptRedundancy(stream, sme);
+                    break;
                 default:
                     break;
             }
@@ -363,6 +402,54 @@ void StreamCollection::createServer(StreamManagementElement& sme) {
     }
 }
 
+void StreamCollection::adaptRedundancy(MasterStreamInfo& stream, StreamManagementElement& sme) {
+    StreamId id = sme.getStreamId();
+    StreamDeliveryReport report = sme.getDeliveryReport();
+    int minCopies = toInt(report.getMinRedundancy());
+    int maxCopies = toInt(report.getMaxRedundancy());
+    if(minCopies < 0 || maxCopies < minCopies) {
+        print_dbg("[SC] BUG! Invalid redundancy bounds for stream (%d,%d,%d,%d)\n",
+                  id.src,id.dst,id.srcPort,id.dstPort);
+        return;
+    }
+    // A report received after a raise comes from the new schedule
+    stream.clearRaisePending();
+    if(stream.getRaiseHold() > 0)
+        stream.setRaiseHold(stream.getRaiseHold() - 1);
+    int copies = toInt(stream.getRedundancy());
+    int newCopies = copies;
+    // The thresholds to raise and to lower are far apart, so that the
+    // redundancy does not flap between two values
+    if(report.lost * 1000 >= lostPermilleToRaise * StreamDeliveryReport::deliveryReportPeriods) {
+        // Too many packets were lost, add one copy unless a recent raise
+        // did not fit in the schedule
+        stream.setCleanReports(0);
+        if(stream.getRaiseHold() == 0) newCopies++;
+    } else if(report.lost > 0 || report.rescued > 0) {
+        // Few losses, or redundancy is being used, keep it
+        stream.setCleanReports(0);
+    } else if(stream.getCleanReports() + 1 >= cleanReportsToLower) {
+        // Every first copy was received for a while, remove one copy
+        stream.setCleanReports(0);
+        newCopies--;
+    } else {
+        stream.setCleanReports(stream.getCleanReports() + 1);
+    }
+    newCopies = std::max(minCopies, std::min(newCopies, maxCopies));
+    Redundancy redundancy = toRedundancy(newCopies, isSpatial(report.getMaxRedundancy()));
+    if(redundancy == stream.getRedundancy())
+        return;
+    if(SCHEDULER_SUMMARY_DBG)
+        print_dbg("[SC] Stream (%d,%d,%d,%d) redundancy %d -> %d (lost=%d rescued=%d)\n",
+                  id.src,id.dst,id.srcPort,id.dstPort, copies, newCopies,
+                  report.lost, report.rescued);
+    if(newCopies > copies) stream.raiseRedundancy(redundancy);
+    else stream.setRedundancy(redundancy);
+    // Established streams need to be rescheduled with the new redundancy
+    changed_flag = true;
+    modified_flag = true;
+}
+
 StreamParameters StreamCollection::negotiateParameters(StreamParameters& serverParams,
                                                        StreamParameters& clientParams) {
     /* NOTE: during the negotiation we compare the "unsigned int" parameters
@@ -65,10 +65,11 @@ class StreamSnapshot {
 public:
     StreamSnapshot() {};
     StreamSnapshot(std::map<StreamId, MasterStreamInfo> collection, bool modified,
-                   bool removed, bool added) : collection(collection),
-                                               modified_flag(modified),
-                                               removed_flag(removed),
-                                               added_flag(added) {}
+                   bool removed, bool added, bool changed) : collection(collection),
+                                                             modified_flag(modified),
+                                                             removed_flag(removed),
+                                                             added_flag(added),
+                                                             changed_flag(changed) {}
     ~StreamSnapshot() {};
     /**
      * @return the number of Streams saved
@@ -102,6 +103,13 @@ public:
     bool wasAdded() const {
         return added_flag;
     }
+    /**
+     * @return true if the parameters of any established stream were changed
+     * since last time the flag was cleared
+     */
+    bool wasChanged() const {
+        return changed_flag;
+    }
     /**
      * @return a map containing changes to apply on the StreamCollection,
      * based on the comparison of schedule with StreamSnapshot.
@@ -109,6 +117,14 @@ public:
      * different changes to apply on streams, for example establish, reject or close.
      */
     std::map<StreamId, StreamChange> getStreamChanges(const std::list<ScheduleElement>& schedule) const;
+    /**
+     * Revert the redundancy of the established streams whose redundancy was
+     * raised but that are missing from the given schedule, as they would
+     * otherwise be closed
+     * @return the reverted streams, to be passed to
+     * StreamCollection::revertRaises()
+     */
+    std::vector<StreamId> revertFailedRaises(const std::list<ScheduleElement>& schedule);
 
 private:
     /* Map containing information about all Streams and Server in the network */
@@ -117,6 +133,7 @@ private:
     bool modified_flag = false;
     bool removed_flag = false;
     bool added_flag = false;
+    bool changed_flag = false;
 };
 
 /**
@@ -151,6 +168,11 @@ public:
      * Apply changes precomputed by StreamSnaphot::getStreamChanges()
      */
     void applyChanges(const std::map<StreamId, StreamChange>& changes);
+    /**
+     * Revert the redundancy raises precomputed by
+     * StreamSnapshot::revertFailedRaises(), holding off further raises
+     */
+    void revertRaises(const std::vector<StreamId>& ids);
     /**
      * @return vector containing all the streams
      */
@@ -195,7 +217,8 @@ public:
 #else
         std::unique_lock<std::mutex> lck(coll_mutex);
 #endif
-        StreamSnapshot result(collection, modified_flag, removed_flag, added_flag);
+        StreamSnapshot result(collection, modified_flag, removed_flag, added_flag,
+                              changed_flag);
         clearFlags();
         return result;
     }
@@ -209,6 +232,7 @@ private:
         modified_flag = false;
         removed_flag = false;
         added_flag = false;
+        changed_flag = false;
         resend_flag = false;
     }
     /**
@@ -236,6 +260,12 @@ private:
      * NOTE: called with mutex already locked
      */
     void createServer(StreamManagementElement& sme);
+    /**
+     * Called by receiveSMEs(), used to raise or lower the redundancy of an
+     * established Stream based on a DELIVERY_REPORT
+     * NOTE: called with mutex already locked
+     */
+    void adaptRedundancy(MasterStreamInfo& stream, StreamManagementElement& sme);
     /**
      * Called by receiveSMEs(), used to create a new Server in collection
      * NOTE: called with mutex already locked
@@ -250,7 +280,17 @@ private:
     bool modified_flag = false;
     bool removed_flag = false;
     bool added_flag = false;
+    bool changed_flag = false;
     bool resend_flag = false;
+    /* Lost periods in a report, in permille, needed to raise the redundancy.
+       Kept well above a single loss, so that isolated losses do not cause
+       a reschedule */
+    static const unsigned int lostPermilleToRaise = 50;
+    /* Consecutive reports without losses and without rescued periods
+       needed to lower the redundancy */
+    static const unsigned char cleanReportsToLower = 4;
+    /* Reports without raises after a raise that did not fit the schedule */
+    static const unsigned char reportsHeldAfterRevert = 8;
 
     /* Mutex to protect concurrect access at collection and infoQueue
      * from the TDMH thread and the scheduler thread */
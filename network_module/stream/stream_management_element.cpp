@@ -80,6 +80,10 @@ bool StreamManagementElement::validateInPacket(Packet& packet, unsigned int offs
         case SMEType::CHALLENGE:
             if(id.src==0) result = false; //Master does not send challenges
             break;
+        case SMEType::DELIVERY_REPORT:
+            if(id.dst>=maxNodes) result = false;
+            if(!id.isStream()) result = false;
+            break;
         case SMEType::UNINITIALIZED:
             break;
         default:
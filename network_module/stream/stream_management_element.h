@@ -52,6 +52,7 @@ enum class SMEType : unsigned char
     CLOSED = 2,          // Request to close the stream or server
     RESEND_SCHEDULE = 3, // Request to resend the schedule
     CHALLENGE = 4,       // Random bytes challenge to authenticate master at resync
+    DELIVERY_REPORT = 5, // Delivery statistics of a stream, to adapt its redundancy
     UNINITIALIZED = 255  // Default constructed SME, shall never be sent
     //NOTE: when adding new types remember to add them to StreamManagementElement::validateInPacket!
 };
@@ -65,6 +66,7 @@ inline const char *smeTypeToString(SMEType s)
         case SMEType::CLOSED:          return "CLOSED";
         case SMEType::RESEND_SCHEDULE: return "RESEND_SCHEDULE";
         case SMEType::CHALLENGE:       return "CHALLENGE";
+        case SMEType::DELIVERY_REPORT: return "DELIVERY_REPORT";
         case SMEType::UNINITIALIZED:   return "UNINITIALIZED";
         default:                       return "UNKNOWN";
     }
@@ -84,6 +86,7 @@ inline unsigned char smeTypeToClass(SMEType s)
         case SMEType::CLOSED:          return 0;
         case SMEType::RESEND_SCHEDULE: return 1; // Class 1, schedule control
         case SMEType::CHALLENGE:       return 2; // Class 2, crypto
+        case SMEType::DELIVERY_REPORT: return 3; // Class 3, stream statistics
         case SMEType::UNINITIALIZED:   return 255;
         default:                       return 255;
     }
@@ -172,6 +175,23 @@ public:
         return result;
     }
 
+    static StreamManagementElement makeDeliveryReportSME(StreamId id,
+                                                         StreamDeliveryReport report) {
+        StreamManagementElement result;
+        result.type = SMEType::DELIVERY_REPORT;
+        result.id = id;
+        static_assert(sizeof(StreamDeliveryReport)==sizeof(StreamParameters),"");
+        result.parameters = StreamParameters::fromBytes(reinterpret_cast<unsigned char*>(&report));
+#ifdef WITH_SME_SEQNO
+#ifdef _MIOSIX
+        result.seqNo = miosix::atomicAddExchange(&seqCounter,1);
+#else //_MIOSIX
+        result.seqNo = __atomic_add_fetch(&seqCounter,1,__ATOMIC_ACQ_REL);
+#endif //_MIOSIX
+#endif //WITH_SME_SEQNO
+        return result;
+    }
+
     void serialize(Packet& pkt) const override;
     void deserialize(Packet& pkt) override;
     StreamId getStreamId() const { return id; }
@@ -184,6 +204,9 @@ public:
     Period getPeriod() const { return static_cast<Period>(parameters.period); }
     unsigned short getPayloadSize() const { return parameters.payloadSize; }
     SMEType getType() const { return type; }
+    StreamDeliveryReport getDeliveryReport() const {
+        return StreamDeliveryReport::fromBytes(reinterpret_cast<const unsigned char*>(&parameters));
+    }
 
     bool operator ==(const StreamManagementElement& other) const {
         return (id == other.getStreamId() && 
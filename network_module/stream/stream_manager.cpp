@@ -65,6 +65,7 @@ void StreamManager::desync() {
         // after resync()
         smeQueue.clear();
     }
+    wakePollers();
 }
 
 int StreamManager::wait(int fd)
@@ -200,39 +201,124 @@ int StreamManager::connect(unsigned char dst, unsigned char dstPort, StreamParam
 }
 
 int StreamManager::write(int fd, const void* data, int size) {
-    REF_PTR_EP stream;
-    {
-        // Lock stream_manager_mutex to access the shared Stream map
-#ifdef _MIOSIX
-        miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-        std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-        if(!masterTrusted) return -10;
-        auto it = fdt.find(fd);
-        if(it == fdt.end()) return -1;
-        stream = it->second;
+    return withStream(fd, [=](Endpoint& s) { return s.write(data, size); });
+}
+
+int StreamManager::read(int fd, void* data, int maxSize) {
+    return withStream(fd, [=](Endpoint& s) { return s.read(data, maxSize); });
+}
+
+int StreamManager::tryWrite(int fd, const void* data, int size) {
+    return withStream(fd, [=](Endpoint& s) { return s.tryWrite(data, size); });
+}
+
+int StreamManager::tryRead(int fd, void* data, int maxSize) {
+    return withStream(fd, [=](Endpoint& s) { return s.tryRead(data, maxSize); });
+}
+
+int StreamManager::setQueueDepth(int fd, unsigned int txDepth, unsigned int rxDepth) {
+    return withStream(fd, [=](Endpoint& s) { return s.setQueueDepth(txDepth, rxDepth); });
+}
+
+int StreamManager::getQueueCounters(int fd, StreamQueueCounters& counters) {
+    return withStream(fd, [&](Endpoint& s) {
+        counters = s.getQueueCounters();
+        return 0;
+    });
+}
+
+int StreamManager::writev(int fd, const StreamIoVec* iov, int iovcnt) {
+    return withStream(fd, [=](Endpoint& s) { return s.writev(iov, iovcnt); });
+}
+
+int StreamManager::readv(int fd, const StreamIoVec* iov, int iovcnt) {
+    return withStream(fd, [=](Endpoint& s) { return s.readv(iov, iovcnt); });
+}
+
+int StreamManager::enableFragmentation(int fd, unsigned int maxMessageSize) {
+    return withStream(fd, [=](Endpoint& s) { return s.enableFragmentation(maxMessageSize); });
+}
+
+int StreamManager::setRedundancyBounds(int fd, Redundancy minRed, Redundancy maxRed) {
+    return withStream(fd, [=](Endpoint& s) { return s.setRedundancyBounds(minRed, maxRed); });
+}
+
+int StreamManager::borrowWrite(int fd, void** buf) {
+    return withStream(fd, [=](Endpoint& s) { return s.borrowWrite(buf); });
+}
+
+int StreamManager::commitWrite(int fd, int size) {
+    return withStream(fd, [=](Endpoint& s) { return s.commitWrite(size); });
+}
+
+int StreamManager::borrowRead(int fd, const void** buf) {
+    return withStream(fd, [=](Endpoint& s) { return s.borrowRead(buf); });
+}
+
+int StreamManager::releaseRead(int fd) {
+    return withStream(fd, [=](Endpoint& s) { return s.releaseRead(); });
+}
+
+int StreamManager::writeBatch(StreamBatchOp* ops, int count) {
+    if(count < 0 || count > maxBatchSize) return -1;
+    int fds[maxBatchSize];
+    REF_PTR_EP endpoints[maxBatchSize];
+    for(int i = 0; i < count; i++) fds[i] = ops[i].fd;
+    if(lookupBatch(fds, count, endpoints) == false) return -10;
+
+    int done = 0;
+    for(int i = 0; i < count; i++) {
+        if(!endpoints[i]) ops[i].result = -1;
+        else ops[i].result = endpoints[i]->tryWrite(ops[i].data, ops[i].size);
+        if(ops[i].result >= 0) done++;
     }
+    return done;
+}
 
-    return stream->write(data, size);
+int StreamManager::readBatch(StreamBatchOp* ops, int count) {
+    if(count < 0 || count > maxBatchSize) return -1;
+    int fds[maxBatchSize];
+    REF_PTR_EP endpoints[maxBatchSize];
+    for(int i = 0; i < count; i++) fds[i] = ops[i].fd;
+    if(lookupBatch(fds, count, endpoints) == false) return -10;
+
+    int done = 0;
+    for(int i = 0; i < count; i++) {
+        if(!endpoints[i]) ops[i].result = -1;
+        else ops[i].result = endpoints[i]->tryRead(ops[i].data, ops[i].size);
+        if(ops[i].result >= 0) done++;
+    }
+    return done;
 }
 
-int StreamManager::read(int fd, void* data, int maxSize) {
-    REF_PTR_EP stream;
-    {
-        // Lock stream_manager_mutex to access the shared Stream map
+int StreamManager::waitAny(StreamPollFd* fds, int nfds) {
+    if(nfds <= 0 || nfds > maxBatchSize) return -1;
+    int fdList[maxBatchSize];
+    REF_PTR_EP endpoints[maxBatchSize];
+    for(int i = 0; i < nfds; i++) fdList[i] = fds[i].fd;
+    if(lookupBatch(fdList, nfds, endpoints) == false) return -10;
+
+    // NOTE: the events are checked with poll_mutex locked, so a notification
+    // can't be lost between the check and the wait
 #ifdef _MIOSIX
-        miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
+    miosix::Lock<miosix::FastMutex> lck(poll_mutex);
 #else
-        std::unique_lock<std::mutex> lck(stream_manager_mutex);
+    std::unique_lock<std::mutex> lck(poll_mutex);
 #endif
-        if(!masterTrusted) return -10;
-        auto it = fdt.find(fd);
-        if(it == fdt.end()) return -1;
-        stream = it->second;
+    for(;;) {
+        int ready = 0;
+        for(int i = 0; i < nfds; i++) {
+            if(!endpoints[i]) {
+                fds[i].revents = STREAM_POLLNVAL;
+            } else {
+                unsigned char mask = fds[i].events | STREAM_POLLHUP;
+                fds[i].revents = endpoints[i]->pollEvents() & mask;
+            }
+            if(fds[i].revents != 0) ready++;
+        }
+        if(ready > 0) return ready;
+        poll_cv.wait(lck);
     }
-
-    return stream->read(data, maxSize);
 }
 
 StreamInfo StreamManager::getInfo(int fd) {
@@ -281,6 +367,7 @@ void StreamManager::close(int fd) {
             removeStream(id);
         }
     }
+    wakePollers();
 }
 
 int StreamManager::listen(unsigned char port, StreamParameters params) {
@@ -414,55 +501,6 @@ void StreamManager::periodicUpdate() {
     }
 }
 
-bool StreamManager::receivePacket(StreamId id, const Packet& data) {
-    REF_PTR_STREAM stream;
-    {
-        // Lock stream_manager_mutex to access the shared Stream map
-#ifdef _MIOSIX
-        miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-        std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-        auto streamit = streams.find(id);
-        if(streamit == streams.end()) return false;
-        stream = streamit->second;
-    }
-    return stream->receivePacket(data);
-}
-
-bool StreamManager::missPacket(StreamId id) {
-    REF_PTR_STREAM stream;
-    {
-        // Lock stream_manager_mutex to access the shared Stream map
-#ifdef _MIOSIX
-        miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-        std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-        auto streamit = streams.find(id);
-        if(streamit == streams.end()) return false;
-        stream = streamit->second;
-    }
-    return stream->missPacket();
-}
-
-bool StreamManager::sendPacket(StreamId id, Packet& data) {
-    REF_PTR_STREAM stream;
-    {
-        // Lock stream_manager_mutex to access the shared Stream map
-#ifdef _MIOSIX
-        miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-        std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-        // Check if a stream with these parameters is not present
-        auto streamit = streams.find(id);
-        if(streamit == streams.end()) return false;
-        stream = streamit->second;
-    }
-    return stream->sendPacket(data);
-}
-
 void StreamManager::setSchedule(const std::vector<ScheduleElement>& schedule, const ScheduleHeader& header) {
 #ifdef _MIOSIX
     miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
@@ -546,7 +584,8 @@ void StreamManager::setStreamsWakeupLists(const std::vector<StreamWakeupInfo>& c
     wakeupScheduler.setStreamsWakeupLists(currList, nextList);
 }
 
-void StreamManager::applySchedule(const std::vector<ScheduleElement>& schedule) {
+void StreamManager::applySchedule(const std::vector<ScheduleElement>& schedule,
+                                  std::vector<ExplicitScheduleElement>& explicitSchedule) {
 #ifdef _MIOSIX
     miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
 #else
@@ -586,6 +625,19 @@ void StreamManager::applySchedule(const std::vector<ScheduleElement>& schedule)
         s->resetCounters();
     }
 
+    // Bind the explicit schedule to the streams, the DataPhase will keep them
+    // referenced until the next schedule is applied
+    for(auto& element : explicitSchedule) {
+        Action action = element.getAction();
+        if(action != Action::SENDSTREAM && action != Action::RECVSTREAM)
+            continue;
+        auto streamit = streams.find(element.getStreamId());
+        if(streamit != streams.end())
+            element.setStream(streamit->second);
+    }
+    // Stream status may have changed, make waitAny() check it again
+    wakePollers();
+
 #ifdef CRYPTO
     if(config.getAuthenticateDataMessages()) {
         doApplyRekeying();
@@ -672,56 +724,20 @@ void StreamManager::enqueueSME(StreamManagementElement sme) {
     }
 }
 
-void StreamManager::resetSequenceNumbers() {
+bool StreamManager::notifyPollers() {
+    // NOTE: called by the MAC thread, so the mutex is only tried
 #ifdef _MIOSIX
-    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
+    if(poll_mutex.tryLock() == false) return false;
+    poll_cv.broadcast();
 #else
-    std::unique_lock<std::mutex> lck(stream_manager_mutex);
+    if(poll_mutex.try_lock() == false) return false;
+    poll_cv.notify_all();
 #endif
-
-    for(auto& s : streams) {
-        REF_PTR_STREAM stream = s.second;
-        stream->resetSequenceNumber();
-    }
-}
-
-unsigned long long StreamManager::getSequenceNumber(StreamId id) {
-    REF_PTR_STREAM stream;
-
-#ifdef _MIOSIX
-    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-    std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-
-    auto it = streams.find(id);
-    if(it == streams.end()) {
-        print_dbg("BUG: stream does not exist!\n");
-        return 0;
-    } else {
-        stream = it->second;
-        return stream->getSequenceNumber();
-    }
+    poll_mutex.unlock();
+    return true;
 }
 
 #ifdef CRYPTO
-AesOcb& StreamManager::getStreamOCB(StreamId id) {
-    REF_PTR_STREAM stream;
-
-#ifdef _MIOSIX
-    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
-#else
-    std::unique_lock<std::mutex> lck(stream_manager_mutex);
-#endif
-    auto it = streams.find(id);
-    if(it == streams.end()) {
-        printf("BUG: Stream not present in StreamManager!\n");
-        return emptyOCB;
-    }
-    stream = it->second;
-    return it->second->getOCB();
-}
-
 void StreamManager::startRekeying() {
     if (config.getAuthenticateDataMessages()) {
 #ifdef _MIOSIX
@@ -756,13 +772,66 @@ void StreamManager::applyRekeying() {
 }
 
 bool StreamManager::needToContinueRekeying() {
-    // No need to lock mutex as these bools are never changed by other threads
+    // No need to lock mutex as these are never changed by other threads
     if(!rekeyingInProgress) return false;
-    else return !rekeyingSnapshot.empty();
+    return !rekeyingSnapshot.empty();
+}
+
+RekeyingProgress StreamManager::getRekeyingProgress() {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
+#else
+    std::unique_lock<std::mutex> lck(stream_manager_mutex);
+#endif
+    RekeyingProgress result;
+    result.inProgress = rekeyingInProgress;
+    result.total = rekeyingTotal;
+    result.remaining = rekeyingInProgress ? rekeyingSnapshot.size() : 0;
+    result.completedAtActivation = rekeyedAtActivation;
+    return result;
 }
 
 #endif //ifdef CRYPTO
 
+int StreamManager::lookupStream(int fd, REF_PTR_EP& endpoint) {
+    // Lock stream_manager_mutex to access the shared Stream map
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
+#else
+    std::unique_lock<std::mutex> lck(stream_manager_mutex);
+#endif
+    if(!masterTrusted) return -10;
+    auto it = fdt.find(fd);
+    if(it == fdt.end()) return -1;
+    endpoint = it->second;
+    return 0;
+}
+
+bool StreamManager::lookupBatch(const int* fds, int count, REF_PTR_EP* endpoints) {
+    // Lock stream_manager_mutex to access the shared Stream map
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(stream_manager_mutex);
+#else
+    std::unique_lock<std::mutex> lck(stream_manager_mutex);
+#endif
+    if(!masterTrusted) return false;
+    for(int i = 0; i < count; i++) {
+        auto it = fdt.find(fds[i]);
+        if(it != fdt.end()) endpoints[i] = it->second;
+    }
+    return true;
+}
+
+void StreamManager::wakePollers() {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(poll_mutex);
+    poll_cv.broadcast();
+#else
+    std::unique_lock<std::mutex> lck(poll_mutex);
+    poll_cv.notify_all();
+#endif
+}
+
 int StreamManager::allocateClientPort() {
     for(unsigned int i = 0; i < maxPorts; i++) {
         if(clientPorts[i] == false) {
@@ -783,7 +852,7 @@ void StreamManager::freeClientPort(unsigned char port) {
 
 std::pair<int,REF_PTR_STREAM> StreamManager::addStream(StreamInfo streamInfo) {
     int fd = fdcounter++;
-    REF_PTR_STREAM stream = REF_PTR_STREAM (new Stream(config, fd, streamInfo)); 
+    REF_PTR_STREAM stream = REF_PTR_STREAM (new Stream(config, pool, fd, streamInfo)); 
     StreamId streamId = streamInfo.getStreamId();
 
     streams[streamId] = stream;
@@ -808,6 +877,8 @@ void StreamManager::removeStream(StreamId id) {
 
     auto stream = streamit->second;
     int fd = stream->getFd();
+    // The DataPhase may still be referencing the stream through the schedule
+    stream->detach();
     streams.erase(id);
     fdt.erase(fd);
     freeClientPort(id.srcPort);
@@ -894,10 +965,35 @@ void StreamManager::doStartRekeying() {
                   myId);
     }
     rekeyingInProgress = true;
-    rekeyingSnapshot = std::queue<StreamId>();
+    rekeyingSnapshot.clear();
     for (auto s : nextScheduleStreams) {
-        rekeyingSnapshot.push(s);
+        // Only the streams of this node need a key
+        if (streams.find(s) != streams.end())
+            rekeyingSnapshot.push_back(s);
     }
+    rekeyingTotal = rekeyingSnapshot.size();
+    rekeyingHandedOver = false;
+    if (!backgroundRekeying || rekeyingSnapshot.empty()) return;
+    /* Hand the snapshot over to the rekeying thread. If the thread holds the
+     * mutex, all keys are computed by continueRekeying and applyRekeying */
+#ifdef _MIOSIX
+    if (!rekeying_mutex.tryLock()) return;
+#else
+    if (!rekeying_mutex.try_lock()) return;
+#endif
+    rekeyingEpoch++;
+    rekeyingJob.assign(rekeyingSnapshot.begin(), rekeyingSnapshot.end());
+    rekeyingJobNext = 0;
+    rekeyingJobHash = secondBlockStreamHash;
+    rekeyingResults.clear();
+    rekeyingResults.reserve(rekeyingJob.size());
+    rekeyingHandedOver = true;
+#ifdef _MIOSIX
+    rekeying_cv.signal();
+#else
+    rekeying_cv.notify_one();
+#endif
+    rekeying_mutex.unlock();
 }
 
 void StreamManager::doContinueRekeying() {
@@ -905,23 +1001,23 @@ void StreamManager::doContinueRekeying() {
         print_dbg("N=%d BUG: call to doContinueRekeying without starting rekeying first\n",
                   myId);
     }
+    collectRekeyingResults();
+    /* Take streams from the back, the rekeying thread works from the front */
     unsigned i=0;
     while (i < maxHashesPerSlot && !rekeyingSnapshot.empty()) {
-        StreamId id = rekeyingSnapshot.front();
-        rekeyingSnapshot.pop();
+        StreamId id = rekeyingSnapshot.back();
+        rekeyingSnapshot.pop_back();
         /* precompute rekeying for this stream */
         auto it = streams.find(id);
         if (it != streams.end()) {
-            unsigned char streamIdBlock[16] = {0};
             unsigned char newKey[16];
-            memcpy(streamIdBlock, &id, sizeof(StreamId));
-            secondBlockStreamHash.digestBlock(newKey, streamIdBlock);
-
-            REF_PTR_STREAM stream = it->second;
+            computeStreamKey(newKey, id, secondBlockStreamHash);
             it->second->setNewKey(newKey);
+            secureClearBytes(newKey, 16);
             i++; 
         }
     }
+    if (rekeyingSnapshot.empty()) collectRekeyingResults();
 }
 
 void StreamManager::doApplyRekeying() {
@@ -930,6 +1026,30 @@ void StreamManager::doApplyRekeying() {
                   myId);
     }
 
+    /* complete the keys that the rekeying thread did not reach yet. The
+     * downlink slots reserved for rekeying are also used to compute keys,
+     * so this only happens if the thread was starved */
+    rekeyedAtActivation = 0;
+    if (backgroundRekeying) {
+        collectRekeyingResults();
+        while (!rekeyingSnapshot.empty()) {
+            StreamId id = rekeyingSnapshot.front();
+            rekeyingSnapshot.pop_front();
+            auto it = streams.find(id);
+            if (it != streams.end()) {
+                unsigned char newKey[16];
+                computeStreamKey(newKey, id, secondBlockStreamHash);
+                it->second->setNewKey(newKey);
+                secureClearBytes(newKey, 16);
+                rekeyedAtActivation++;
+            }
+        }
+        // Withdraw the job from the thread. If the thread holds the mutex, it
+        // is withdrawn at the next handover
+        collectRekeyingResults();
+        rekeyingHandedOver = false;
+    }
+
     /* reset all sequence numbers */
     for(auto& s : streams) {
         REF_PTR_STREAM stream = s.second;
@@ -942,6 +1062,109 @@ void StreamManager::doApplyRekeying() {
     }
     rekeyingInProgress = false;
 }
+
+void StreamManager::collectRekeyingResults() {
+    if (!rekeyingHandedOver) return;
+#ifdef _MIOSIX
+    if (!rekeying_mutex.tryLock()) return;
+#else
+    if (!rekeying_mutex.try_lock()) return;
+#endif
+    /* Results follow the order of the job. A key whose stream is no longer at
+     * the front of the snapshot was already computed from the back */
+    for (auto& r : rekeyingResults) {
+        if (rekeyingSnapshot.empty() || !(rekeyingSnapshot.front() == r.first)) continue;
+        rekeyingSnapshot.pop_front();
+        auto it = streams.find(r.first);
+        if (it != streams.end()) it->second->setNewOCB(r.second);
+    }
+    rekeyingResults.clear();
+    if (rekeyingSnapshot.empty()) {
+        // Withdraw the remaining job
+        rekeyingEpoch++;
+        rekeyingJob.clear();
+        rekeyingJobNext = 0;
+        rekeyingHandedOver = false;
+    }
+    rekeying_mutex.unlock();
+}
+
+void StreamManager::computeStreamKey(unsigned char key[16], StreamId id,
+                                     SingleBlockMPHash& hash) {
+    unsigned char streamIdBlock[16] = {0};
+    memcpy(streamIdBlock, &id, sizeof(StreamId));
+    hash.digestBlock(key, streamIdBlock);
+}
+
+void StreamManager::startRekeyingThread() {
+    backgroundRekeying = config.getBackgroundRekeying() &&
+                         config.getAuthenticateDataMessages();
+    if (!backgroundRekeying || rkthread != nullptr) return;
+#ifdef _MIOSIX
+    // Lowest priority, so that it only runs while the other threads are idle
+    rkthread = miosix::Thread::create(&StreamManager::rekeyingThreadLauncher, 2048,
+                                      0, this, miosix::Thread::JOINABLE);
+#else
+    rkthread = new std::thread(&StreamManager::rekeyingThread, this);
+#endif
+}
+
+void StreamManager::stopRekeyingThread() {
+    if (rkthread == nullptr) return;
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(rekeying_mutex);
+        stopRekeying = true;
+        rekeying_cv.signal();
+#else
+        std::unique_lock<std::mutex> lck(rekeying_mutex);
+        stopRekeying = true;
+        rekeying_cv.notify_one();
+#endif
+    }
+    rkthread->join();
+#ifndef _MIOSIX
+    delete rkthread;
+#endif
+    rkthread = nullptr;
+}
+
+void StreamManager::rekeyingThread() {
+    for (;;) {
+        StreamId id;
+        unsigned int epoch;
+        // Copy of rekeyingJobHash, cleared by its destructor
+        SingleBlockMPHash hash;
+        {
+#ifdef _MIOSIX
+            miosix::Lock<miosix::FastMutex> lck(rekeying_mutex);
+#else
+            std::unique_lock<std::mutex> lck(rekeying_mutex);
+#endif
+            while (!stopRekeying && rekeyingJobNext >= rekeyingJob.size())
+                rekeying_cv.wait(lck);
+            if (stopRekeying) return;
+            id = rekeyingJob[rekeyingJobNext++];
+            epoch = rekeyingEpoch;
+            hash = rekeyingJobHash;
+        }
+        /* Compute the key without holding the mutex, as this thread can be
+         * preempted for long */
+        unsigned char newKey[16];
+        computeStreamKey(newKey, id, hash);
+        AesOcb ocb(newKey);
+        secureClearBytes(newKey, 16);
+        {
+#ifdef _MIOSIX
+            miosix::Lock<miosix::FastMutex> lck(rekeying_mutex);
+#else
+            std::unique_lock<std::mutex> lck(rekeying_mutex);
+#endif
+            if (epoch == rekeyingEpoch)
+                rekeyingResults.push_back(std::make_pair(id, std::move(ocb)));
+        }
+    }
+}
 #endif // #ifdef CRYPTO
 
 } /* namespace mxnet */
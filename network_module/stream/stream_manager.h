@@ -34,12 +34,15 @@
 #include "stream.h"
 #include "stream_wakeup_scheduler.h"
 #include "../scheduler/schedule_element.h"
+#include "../data_phase/explicit_schedule_element.h"
 #include "../util/updatable_queue.h"
+#include "../util/packet_pool.h"
 // For cryptography
 #ifdef CRYPTO
 #include "../crypto/hash.h"
 #include "../crypto/aes_ocb.h"
-#include <queue>
+#include <deque>
+#include <vector>
 #endif
 // For thread synchronization
 #ifdef _MIOSIX
@@ -47,6 +50,8 @@
 #include <kernel/intrusive.h>
 #else
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <memory>
 #endif
 #include <map>
@@ -61,6 +66,24 @@
 
 namespace mxnet {
 
+#ifdef CRYPTO
+/**
+ * Progress of the rekeying of the streams of a node
+ */
+struct RekeyingProgress {
+    // Rekeying started and not yet applied
+    bool inProgress;
+    // Streams to rekey
+    unsigned int total;
+    // Streams whose next key is not computed yet
+    unsigned int remaining;
+    // Keys left to applyRekeying() the last time, with background rekeying.
+    // Nonzero if the rekeying thread and the reserved downlink slots were
+    // not enough
+    unsigned int completedAtActivation;
+};
+#endif
+
 /**
  * The class StreamManager contains Stream and Server classes related
  * to the node it is running on.
@@ -74,8 +97,9 @@ namespace mxnet {
 
 class StreamManager {
 public:
-    StreamManager(const MACContext& ctx, const NetworkConfiguration& config, unsigned char myId) 
-                        : ctx(ctx), config(config), myId(myId), wakeupScheduler(ctx, config, *this) {
+    StreamManager(const MACContext& ctx, const NetworkConfiguration& config, unsigned char myId,
+                  PacketPool& pool)
+                        : ctx(ctx), config(config), myId(myId), pool(pool), wakeupScheduler(ctx, config, *this) {
         // Initialize clientPorts to false (all ports unused)
         clientPorts.reserve(maxPorts);
         for (unsigned int i = 0; i < maxPorts; ++i) {
@@ -86,9 +110,15 @@ public:
 #endif
 
         wakeupScheduler.start();
+#ifdef CRYPTO
+        startRekeyingThread();
+#endif
     }
 
     ~StreamManager() {
+#ifdef CRYPTO
+        stopRekeyingThread();
+#endif
         desync();
     }
 
@@ -138,6 +168,54 @@ public:
     // Gets data received from a stream, return the number of bytes received
     int read(int fd, void* data, int maxSize);
 
+    // Like write, but returns -4 instead of blocking if the stream queue is full
+    int tryWrite(int fd, const void* data, int size);
+
+    // Like read, but returns -4 instead of blocking if no data was received
+    int tryRead(int fd, void* data, int maxSize);
+
+    // Set the number of packets a stream can queue for transmission and reception
+    int setQueueDepth(int fd, unsigned int txDepth, unsigned int rxDepth);
+
+    // Get the number of packets lost because a stream queue was full
+    int getQueueCounters(int fd, StreamQueueCounters& counters);
+
+    // Like write, but the data is gathered from iovcnt buffers
+    int writev(int fd, const StreamIoVec* iov, int iovcnt);
+
+    // Like read, but the data is scattered to iovcnt buffers
+    int readv(int fd, const StreamIoVec* iov, int iovcnt);
+
+    // Make a stream split and reassemble messages larger than one packet
+    int enableFragmentation(int fd, unsigned int maxMessageSize);
+
+    // Let the master adapt the redundancy of a stream within the given bounds
+    int setRedundancyBounds(int fd, Redundancy minRed, Redundancy maxRed);
+
+    // Lends the payload area of the next packet of a stream, see Stream::borrowWrite
+    int borrowWrite(int fd, void** buf);
+
+    // Sends the packet lent by borrowWrite
+    int commitWrite(int fd, int size);
+
+    // Like read, but lends the received payload instead of copying it
+    int borrowRead(int fd, const void** buf);
+
+    // Returns the payload lent by borrowRead
+    int releaseRead(int fd);
+
+    // Calls tryWrite on count streams, looking up all of them at once.
+    // Returns the number of successful operations
+    int writeBatch(StreamBatchOp* ops, int count);
+
+    // Calls tryRead on count streams, looking up all of them at once.
+    // Returns the number of successful operations
+    int readBatch(StreamBatchOp* ops, int count);
+
+    // Wait until at least one of the nfds streams has one of the requested
+    // events, returns the number of streams with revents set
+    int waitAny(StreamPollFd* fds, int nfds);
+
     // Returns a StreamInfo, containing stream status and parameters
     StreamInfo getInfo(int fd);
 
@@ -167,16 +245,6 @@ public:
     // that are currently in a loop (e.g. send SME after timeout)
     void periodicUpdate();
 
-    // Used by the DataPhase class to put received data in the right buffer
-    bool receivePacket(StreamId id, const Packet& data);
-
-    // Used by the DataPhase class when an incoming packet is missed
-    bool missPacket(StreamId id);
-
-    // Used by the DataPhase class to get data to sent from the right buffer
-    // Return true if we have data to send
-    bool sendPacket(StreamId id, Packet& data);
-
     /**
      * Used by ScheduleDistribution to prepare for schedule application.
      * This method is meant to be called with the same schedule as applySchedule.
@@ -201,8 +269,12 @@ public:
      * new schedule. When crypto is on, it applies new keys to all streams. Such
      * keys are meant to be precomputed before applying the schedule, by calling
      * continueRekeying() the appropriate number of times.
+     * The SENDSTREAM and RECVSTREAM elements of the explicit schedule are
+     * bound to the corresponding Stream, so that the DataPhase can access
+     * streams without looking them up and without locking the StreamManager.
      */
-    void applySchedule(const std::vector<ScheduleElement>& schedule);
+    void applySchedule(const std::vector<ScheduleElement>& schedule,
+                       std::vector<ExplicitScheduleElement>& explicitSchedule);
 
     // Used by ScheduleDistribution to apply received info elements
     void applyInfoElements(const std::vector<InfoElement>& infos);
@@ -218,21 +290,14 @@ public:
     void enqueueSME(StreamManagementElement sme);
 
     /**
-     * Reset sequence numbers of all known streams.
-     * Called by dataphase at the start of a new data superframe.
+     * Called by the DataPhase after notifying streams, to wake up the
+     * threads blocked in waitAny().
+     * Never blocks, returns false if it has to be called again later
      */
-    void resetSequenceNumbers();
-
-    /**
-     * Get the current sequence number of a stream.
-     * Called by dataphase to use the sequence number for crypto.
-     */
-    unsigned long long getSequenceNumber(StreamId id);
+    bool notifyPollers();
 
 #ifdef CRYPTO
 
-    AesOcb& getStreamOCB(StreamId id);
-
     /**
      * Stream keys are derived from the master key as: 
      *      Hash(masterKey||streamId)
@@ -257,7 +322,8 @@ public:
 
     /**
      * Called directly by ScheduleDistribution phase in downlink tiles reserved for
-     * rekeying.
+     * rekeying. With background rekeying, it installs the keys computed by the
+     * rekeying thread, and computes some of those it did not reach yet.
      */
     void continueRekeying();
     
@@ -273,6 +339,12 @@ public:
      */
     bool needToContinueRekeying();
 
+    /**
+     * @return the progress of the current rekeying, or of the last one if it
+     * has already been applied
+     */
+    RekeyingProgress getRekeyingProgress();
+
     /**
      * Called by KeyManager when connecting, to inform the StreamManager that no streams
      * or servers should be opened or accepted.
@@ -348,6 +420,30 @@ private:
     // NOTE: to be called with the mutex locked
     void removeServer(unsigned char port);
 
+    // Looks up the endpoint of fd.
+    // Returns 0 on success, -10 if the master is not trusted or -1 if
+    // fd is not open
+    int lookupStream(int fd, REF_PTR_EP& endpoint);
+
+    // Looks up the endpoint of fd and calls f on it, without holding
+    // stream_manager_mutex as f may block.
+    // Returns the result of f or the error of lookupStream()
+    template<typename F>
+    int withStream(int fd, F f) {
+        REF_PTR_EP endpoint;
+        int error = lookupStream(fd, endpoint);
+        if(error != 0) return error;
+        return f(*endpoint);
+    }
+
+    // Looks up the endpoints of count fds, at most maxBatchSize, setting
+    // to nullptr the ones not found.
+    // Returns false if the master is not trusted
+    bool lookupBatch(const int* fds, int count, REF_PTR_EP* endpoints);
+
+    // Used after stream status changes to make waitAny() check them again
+    void wakePollers();
+
     // Prints StreamId and status of a given Stream 
     void printStreamStatus(StreamId id, StreamStatus status);
 
@@ -361,6 +457,8 @@ private:
     const NetworkConfiguration& config;
     /* NetworkId of this node */
     unsigned char myId;
+    /* Pool from which stream buffers are allocated */
+    PacketPool& pool;
     /* Counter used to assign progressive file-descriptors to Streams and Servers*/
     int fdcounter = 1;
 
@@ -372,6 +470,8 @@ private:
     std::map<unsigned char, REF_PTR_SERVER> servers;
 
     const unsigned int maxPorts = 16;
+    /* Maximum number of streams in a batch call or in waitAny */
+    static const int maxBatchSize = 32;
     /* Vector containing the current availability of source ports
      * 0= port free, 1= port used */
     std::vector<bool> clientPorts;
@@ -405,6 +505,31 @@ private:
 
     void doApplyRekeying();
 
+    /**
+     * With background rekeying, install the keys computed so far by the
+     * rekeying thread, and stop it if the snapshot is empty. Does nothing
+     * if rekeying_mutex is held by the rekeying thread
+     */
+    void collectRekeyingResults();
+
+    /**
+     * Compute the key of a stream for the next master key.
+     * \param hash a copy of secondBlockStreamHash, so that it can be used
+     * by the rekeying thread
+     */
+    static void computeStreamKey(unsigned char key[16], StreamId id,
+                                 SingleBlockMPHash& hash);
+
+    /**
+     * With background rekeying, start the thread computing the keys of the
+     * rekeyingJob as soon as rekeying starts
+     */
+    void startRekeyingThread();
+
+    void stopRekeyingThread();
+
+    void rekeyingThread();
+
     /**
      * Stream keys are derived from the master key as: 
      *      Hash(masterKey||streamId)
@@ -434,14 +559,50 @@ private:
      * is happening without schedule change, it means the user (ScheduleDistribution)
      * is calling startRekeying() directly, and the snapshot will be identical to the
      * one computed when the schedule was first received.
-     * Elements of the snapshot are gradually removed as continueRekeying() is called
-     * to rekey streams. The rekeying process finishes once this queue is empty.
+     * Elements of the snapshot are gradually removed from the back as continueRekeying()
+     * is called to rekey streams, and from the front as the keys computed by the
+     * rekeying thread are installed. The rekeying process finishes once it is empty.
+     * Only accessed by the MAC thread.
      */
-    std::queue<StreamId> rekeyingSnapshot;
-
-    /* Return this OCB to dataphase for safety in case dataphase asks for the OCB
-     * of a stream that does not exist */
-    AesOcb emptyOCB;
+    std::deque<StreamId> rekeyingSnapshot;
+
+    /*
+     * With background rekeying, the rekeying thread works on its own copy of
+     * the snapshot and of secondBlockStreamHash, and never accesses the
+     * streams. These are protected by rekeying_mutex, that the rekeying thread
+     * never holds while computing a key and the MAC thread only tries to lock,
+     * so the MAC thread never waits for the low priority thread.
+     * The keys computed by the thread are queued in the order of the job, and
+     * installed by the MAC thread
+     */
+    std::vector<StreamId> rekeyingJob;
+    unsigned int rekeyingJobNext = 0;
+    SingleBlockMPHash rekeyingJobHash;
+    std::vector<std::pair<StreamId, AesOcb>> rekeyingResults;
+    // Incremented when a job is handed over or withdrawn, so that a key
+    // computed for a previous job is discarded
+    unsigned int rekeyingEpoch = 0;
+    bool stopRekeying = false;
+    // Whether the current rekeying was handed over to the thread, only
+    // accessed by the MAC thread
+    bool rekeyingHandedOver = false;
+    // Streams in the snapshot when rekeying started
+    unsigned int rekeyingTotal = 0;
+    // Keys completed by applyRekeying() the last time, with background rekeying
+    unsigned int rekeyedAtActivation = 0;
+    bool backgroundRekeying = false;
+#ifdef _MIOSIX
+    miosix::FastMutex rekeying_mutex;
+    miosix::ConditionVariable rekeying_cv;
+    miosix::Thread* rkthread = nullptr;
+    static void rekeyingThreadLauncher(void *arg) {
+        reinterpret_cast<StreamManager*>(arg)->rekeyingThread();
+    }
+#else
+    std::mutex rekeying_mutex;
+    std::condition_variable rekeying_cv;
+    std::thread* rkthread = nullptr;
+#endif
 #endif
 
     bool masterTrusted = true;
@@ -456,11 +617,17 @@ private:
 
     miosix::ConditionVariable trust_cv;
 
+    // Mutex and condition variable used by waitAny
+    miosix::FastMutex poll_mutex;
+    miosix::ConditionVariable poll_cv;
 #else
     mutable std::mutex stream_manager_mutex;
     mutable std::mutex sme_mutex;
 
     std::condition_variable trust_cv;
+
+    std::mutex poll_mutex;
+    std::condition_variable poll_cv;
 #endif
 
     /** 
@@ -57,6 +57,20 @@ inline int toInt(Redundancy x)
     }
 }
 
+/* True if the redundant copies follow more than one path */
+inline bool isSpatial(Redundancy x)
+{
+    return x == Redundancy::DOUBLE_SPATIAL || x == Redundancy::TRIPLE_SPATIAL;
+}
+
+/* Convert a number of copies from 1 to 3 to the corresponding Redundancy */
+inline Redundancy toRedundancy(int copies, bool spatial)
+{
+    if(copies <= 1) return Redundancy::NONE;
+    if(copies == 2) return spatial ? Redundancy::DOUBLE_SPATIAL : Redundancy::DOUBLE;
+    return spatial ? Redundancy::TRIPLE_SPATIAL : Redundancy::TRIPLE;
+}
+
 enum class Period
 {
 //  P0dot1,        //  0.1*tileDuration (currently unsupported)
@@ -172,6 +186,43 @@ public:
     unsigned int direction:2;
 } __attribute__((packed));
 
+/* Delivery statistics of a stream measured by a receiving endpoint over the
+   last deliveryReportPeriods periods, sent to the master in place of the
+   StreamParameters of a DELIVERY_REPORT SME together with the redundancy
+   bounds declared by the application */
+class StreamDeliveryReport {
+public:
+    StreamDeliveryReport() : lost(0), rescued(0), minRedundancy(0),
+                             maxRedundancy(0), unused(0) {}
+    StreamDeliveryReport(unsigned int lost, unsigned int rescued,
+                         Redundancy minRed, Redundancy maxRed) : unused(0) {
+        this->lost = lost < maxCount ? lost : maxCount;
+        this->rescued = rescued < maxCount ? rescued : maxCount;
+        minRedundancy=static_cast<unsigned int>(minRed);
+        maxRedundancy=static_cast<unsigned int>(maxRed);
+    }
+
+    Redundancy getMinRedundancy() const { return static_cast<Redundancy>(minRedundancy); }
+    Redundancy getMaxRedundancy() const { return static_cast<Redundancy>(maxRedundancy); }
+
+    static StreamDeliveryReport fromBytes(const unsigned char *bytes) {
+        StreamDeliveryReport result;
+        memcpy(&result,bytes,sizeof(result));
+        return result;
+    }
+
+    static const unsigned int deliveryReportPeriods = 32;
+    static const unsigned int maxCount = 15;
+
+    // Periods in which no copy of the packet was received (saturating)
+    unsigned int lost:4;
+    // Periods in which the first copy was lost but a later one was received
+    unsigned int rescued:4;
+    unsigned int minRedundancy:3;
+    unsigned int maxRedundancy:3;
+    unsigned int unused:2;
+} __attribute__((packed));
+
 class StreamId {
 public:
     StreamId() : src(0),dst(0),srcPort(0),dstPort(0) {}
@@ -214,6 +265,19 @@ public:
     bool isStream() const {
         return !isServer();
     }
+    /**
+     * @return an 8 bit truncated hash of the StreamId, used in place of the
+     * full StreamId by data packets sent with the compact header.
+     * Different streams may share the same tag, as the stream owning a data
+     * slot is known from the schedule and the tag is only a sanity check
+     */
+    unsigned char getCompactTag() const {
+        unsigned int key = getKey();
+        key ^= key >> 13;
+        key *= 0x5bd1e995;
+        key ^= key >> 15;
+        return key & 0xff;
+    }
     static StreamId fromBytes(unsigned char bytes[3]) {
         static_assert(sizeof(StreamId)==3,"");
         return StreamId(bytes[0], bytes[1], bytes[2]&0xf, bytes[2]>>4);
@@ -287,6 +351,60 @@ protected:
     StreamStatus status;
 };
 
+/**
+ *  Counters of the data lost by a stream
+ */
+struct StreamQueueCounters {
+    StreamQueueCounters() : txOverflows(0), rxOverflows(0), lostFragments(0),
+                            droppedMessages(0) {}
+    // Packets rejected by tryWrite()
+    unsigned int txOverflows;
+    // Received packets dropped because the application did not read them
+    unsigned int rxOverflows;
+    // Fragments not received, with fragmentation enabled
+    unsigned int lostFragments;
+    // Messages discarded because incomplete, with fragmentation enabled
+    unsigned int droppedMessages;
+};
+
+/**
+ *  Buffer descriptor used by the vectored stream API
+ */
+struct StreamIoVec {
+    void* base;
+    int size;
+};
+
+/**
+ *  Operation on one stream performed by the batch stream API
+ */
+struct StreamBatchOp {
+    int fd;
+    void* data;
+    int size;
+    // Set to what tryWrite() or tryRead() would return for this stream
+    int result;
+};
+
+/* Events reported by waitAny */
+enum StreamPollEvent : unsigned char {
+    STREAM_POLLIN   = 1, // Data can be read without blocking
+    STREAM_POLLOUT  = 2, // Data can be written without blocking
+    STREAM_POLLHUP  = 4, // Stream no longer established, always reported
+    STREAM_POLLNVAL = 8  // Invalid fd, always reported
+};
+
+/**
+ *  Stream to be waited for by waitAny
+ */
+struct StreamPollFd {
+    int fd;
+    // Bitmask of StreamPollEvent to wait for
+    unsigned char events;
+    // Bitmask of StreamPollEvent that occurred, set by waitAny
+    unsigned char revents;
+};
+
 /**
  *  MasterStreamInfo is used to save the status of a Stream internally to TDMH
  */
@@ -295,7 +413,11 @@ public:
     MasterStreamInfo() {}
     MasterStreamInfo(MasterStreamInfo info, MasterStreamStatus st) : id(info.id),
                                                    parameters(info.parameters),
-                                                   status(st) {}
+                                                   status(st),
+                                                   cleanReports(info.cleanReports),
+                                                   raiseHold(info.raiseHold),
+                                                   raisePending(info.raisePending),
+                                                   previousRedundancy(info.previousRedundancy) {}
 
     MasterStreamInfo(StreamId id, StreamParameters params, MasterStreamStatus status) : id(id),
                                                                             parameters(params),
@@ -316,11 +438,44 @@ public:
     void setStatus(MasterStreamStatus s) { status=s; }
     void setRedundancy(Redundancy r) { parameters.redundancy=static_cast<unsigned int>(r); }
     void setPeriod(Period p) { parameters.period=static_cast<unsigned int>(p); }
+    unsigned char getCleanReports() const { return cleanReports; }
+    void setCleanReports(unsigned char c) { cleanReports=c; }
+    unsigned char getRaiseHold() const { return raiseHold; }
+    void setRaiseHold(unsigned char h) { raiseHold=h; }
+    /**
+     * Raise the redundancy, remembering the current one in case the stream
+     * does not fit in the schedule with the new redundancy
+     */
+    void raiseRedundancy(Redundancy r) {
+        previousRedundancy=parameters.redundancy;
+        raisePending=true;
+        setRedundancy(r);
+    }
+    /**
+     * @return true if the redundancy was raised and the stream has not been
+     * scheduled with the new redundancy yet
+     */
+    bool isRaisePending() const { return raisePending; }
+    void clearRaisePending() { raisePending=false; }
+    /**
+     * Go back to the redundancy before the pending raise
+     */
+    void revertRaise() {
+        parameters.redundancy=previousRedundancy;
+        raisePending=false;
+    }
 
 protected:
     StreamId id;
     StreamParameters parameters;
     MasterStreamStatus status;
+    // Consecutive delivery reports without losses, used to lower redundancy
+    unsigned char cleanReports = 0;
+    // Delivery reports to wait before raising again after a raise that did
+    // not fit in the schedule
+    unsigned char raiseHold = 0;
+    bool raisePending = false;
+    unsigned char previousRedundancy = 0;
 };
 
 
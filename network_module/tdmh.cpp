@@ -72,6 +72,111 @@ int read(int fd, void* data, int maxSize) {
     return streamManager->read(fd, data, maxSize);
 }
 
+int tryWrite(int fd, const void* data, int size) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->tryWrite(fd, data, size);
+}
+
+int tryRead(int fd, void* data, int maxSize) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->tryRead(fd, data, maxSize);
+}
+
+int setQueueDepth(int fd, unsigned int txDepth, unsigned int rxDepth) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->setQueueDepth(fd, txDepth, rxDepth);
+}
+
+int getQueueCounters(int fd, StreamQueueCounters& counters) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->getQueueCounters(fd, counters);
+}
+
+int writev(int fd, const StreamIoVec* iov, int iovcnt) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->writev(fd, iov, iovcnt);
+}
+
+int readv(int fd, const StreamIoVec* iov, int iovcnt) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->readv(fd, iov, iovcnt);
+}
+
+int enableFragmentation(int fd, unsigned int maxMessageSize) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->enableFragmentation(fd, maxMessageSize);
+}
+
+int setRedundancyBounds(int fd, Redundancy minRed, Redundancy maxRed) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->setRedundancyBounds(fd, minRed, maxRed);
+}
+
+int borrowWrite(int fd, void** buf) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->borrowWrite(fd, buf);
+}
+
+int commitWrite(int fd, int size) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->commitWrite(fd, size);
+}
+
+int borrowRead(int fd, const void** buf) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->borrowRead(fd, buf);
+}
+
+int releaseRead(int fd) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->releaseRead(fd);
+}
+
+int writeBatch(StreamBatchOp* ops, int count) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->writeBatch(ops, count);
+}
+
+int readBatch(StreamBatchOp* ops, int count) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->readBatch(ops, count);
+}
+
+int waitAny(StreamPollFd* fds, int nfds) {
+    StreamManager* streamManager = getStreamManager();
+    if(streamManager == nullptr)
+        return -1;
+    return streamManager->waitAny(fds, nfds);
+}
+
 int wait(int fd) {
     StreamManager* streamManager = getStreamManager();
     if(streamManager == nullptr)
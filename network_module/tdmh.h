@@ -55,6 +55,70 @@ int write(int fd, const void* data, int size);
 // Gets data received from a stream, return the number of bytes received
 int read(int fd, void* data, int maxSize);
 
+// Like write, but returns -4 instead of blocking if the stream queue is full
+int tryWrite(int fd, const void* data, int size);
+
+// Like read, but returns -4 instead of blocking if no data is available
+int tryRead(int fd, void* data, int maxSize);
+
+// Set the number of packets a stream can queue for transmission and
+// reception (default 1), making write and read non-blocking for bursts.
+// The reception depth takes effect when the next schedule is applied.
+// Returns -2 if the packet pool, sized by NetworkConfiguration for
+// maxNodeStreams streams of streamQueueDepth packets, cannot cover them
+int setQueueDepth(int fd, unsigned int txDepth, unsigned int rxDepth);
+
+// Get the number of packets lost because a stream queue was full
+int getQueueCounters(int fd, StreamQueueCounters& counters);
+
+// Like write, but the data to be sent is gathered from iovcnt buffers
+int writev(int fd, const StreamIoVec* iov, int iovcnt);
+
+// Like read, but the data received is scattered to iovcnt buffers
+int readv(int fd, const StreamIoVec* iov, int iovcnt);
+
+// Make write split messages of up to maxMessageSize bytes across packets
+// sent in the following stream periods, and read reassemble them. Must be
+// called on both endpoints of the stream, before exchanging data. Periods
+// without data between fragments are tolerated, lost fragments are detected
+// from their index and reported by getQueueCounters. The transmit queue
+// is enlarged to hold a whole message, returns -2 if the pool cannot cover it
+int enableFragmentation(int fd, unsigned int maxMessageSize);
+
+// Let the master raise or lower the redundancy of a stream between minRed
+// and maxRed, based on the delivery statistics periodically reported by the
+// endpoints receiving data. Spatial redundancy is used if maxRed is spatial
+int setRedundancyBounds(int fd, Redundancy minRed, Redundancy maxRed);
+
+// Lends to the application the payload area of the next packet of a stream,
+// to be filled in place and then sent with commitWrite. Sets buf and returns
+// the maximum payload size, accounting for headers and authentication tag
+int borrowWrite(int fd, void** buf);
+
+// Sends size bytes of the payload area lent by borrowWrite, blocking like
+// write. A negative size discards the lent packet
+int commitWrite(int fd, int size);
+
+// Like read, but sets buf to point to the received payload instead of
+// copying it. The payload is valid until releaseRead is called
+int borrowRead(int fd, const void** buf);
+
+// Returns to TDMH the payload lent by borrowRead
+int releaseRead(int fd);
+
+// Calls tryWrite on multiple streams at once, the result of each write is
+// stored in ops[i].result. Returns the number of successful writes
+int writeBatch(StreamBatchOp* ops, int count);
+
+// Calls tryRead on multiple streams at once, the result of each read is
+// stored in ops[i].result. Returns the number of successful reads
+int readBatch(StreamBatchOp* ops, int count);
+
+// Wait until at least one of the given streams can be read or written
+// without blocking, as requested in fds[i].events. Returns the number of
+// streams with fds[i].revents set
+int waitAny(StreamPollFd* fds, int nfds);
+
 // Put a stream in "waiting state", wait for it to be woken up at its assigned sending slot
 int wait(int fd);
 
@@ -27,6 +27,7 @@
  ***************************************************************************/
 
 #include "../util/debug_settings.h"
+#include "../util/trace.h"
 #include "dynamic_uplink_phase.h"
 #include "../downlink_phase/timesync/timesync_downlink.h"
 #include "uplink_message.h"
@@ -45,10 +46,10 @@ void DynamicUplinkPhase::execute(long long slotStart)
     auto currentNode = getAndUpdateCurrentNode();
     
     if (ENABLE_UPLINK_DYN_VERB_DBG)
-         print_dbg("[U] N=%u NT=%lld\n", currentNode, NetworkTime::fromLocalTime(slotStart).get());
+        trace_dbg(TraceEvent::UPLINK_SLOT, currentNode, 0, 0, NetworkTime::fromLocalTime(slotStart).get());
     
     if (currentNode == myId) sendMyUplink(slotStart);
-    else receiveUplink(slotStart, currentNode);
+    else if (currentNode < nodesCount) receiveUplink(slotStart, currentNode);
 }
 
 void DynamicUplinkPhase::sendMyUplink(long long slotStart)
@@ -65,13 +66,13 @@ void DynamicUplinkPhase::sendMyUplink(long long slotStart)
         SendUplinkMessage message(ctx.getNetworkConfig(), ctx.getHop(),
                                   myNeighborTable.isBadAssignee(), ctx.getNetworkId(), //NOTE: why the network id?
                                   myNeighborTable.getMyTopologyElement(),
-                                  0, 0
+                                  {}, 0
 #ifdef CRYPTO
                                   , keyManager.getUplinkOCB()
 #endif
                                   );
         if(ENABLE_UPLINK_DYN_INFO_DBG)
-            print_dbg("[U] N=%u -> @%llu\n", ctx.getNetworkId(), NetworkTime::fromLocalTime(slotStart).get());
+            trace_dbg(TraceEvent::UPLINK_SENT, ctx.getNetworkId(), 0, 0, NetworkTime::fromLocalTime(slotStart).get());
 
         ctx.configureTransceiver(ctx.getTransceiverConfig());
 #ifdef CRYPTO
@@ -99,7 +100,7 @@ void DynamicUplinkPhase::sendMyUplink(long long slotStart)
                                   myNeighborTable.isBadAssignee(),
                                   myNeighborTable.getBestPredecessor(),
                                   myNeighborTable.getMyTopologyElement(),
-                                  topologyQueue.size(), smeQueue.size()
+                                  getTopologySizes(), smeQueue.size()
 #ifdef CRYPTO
                                   , keyManager.getUplinkOCB()
 #endif
@@ -110,10 +111,33 @@ void DynamicUplinkPhase::sendMyUplink(long long slotStart)
             }
         }
         if(ENABLE_UPLINK_DYN_INFO_DBG)
-            print_dbg("[U] N=%u -> @%llu\n", ctx.getNetworkId(), NetworkTime::fromLocalTime(slotStart).get());
+            trace_dbg(TraceEvent::UPLINK_SENT, ctx.getNetworkId(), 0, 0, NetworkTime::fromLocalTime(slotStart).get());
 
-        ctx.configureTransceiver(ctx.getTransceiverConfig());
-        for(int i = 0; i < message.getNumPackets(); i++)
+        if(burst)
+        {
+            // Serialize and encrypt the whole burst in advance, so that
+            // packets can be sent back to back
+            std::vector<Packet> packets(message.getNumPackets());
+            for(int i = 0; i < message.getNumPackets(); i++)
+            {
+                message.serializeTopologiesAndSMEs(topologyQueue,smeQueue);
+#ifdef CRYPTO
+                if(ctx.getNetworkConfig().getAuthenticateControlMessages()) {
+                    unsigned int seqNo = i + 1;
+                    message.setIV(tileNumber, seqNo, masterIndex);
+                }
+#endif
+                message.seal(packets[i]);
+            }
+            ctx.configureTransceiver(ctx.getTransceiverConfig());
+            for(auto& p : packets)
+            {
+                p.send(ctx,slotStart);
+                slotStart += packetSpacing;
+            }
+        } else {
+            ctx.configureTransceiver(ctx.getTransceiverConfig());
+            for(int i = 0; i < message.getNumPackets(); i++)
             {
                 message.serializeTopologiesAndSMEs(topologyQueue,smeQueue);
 #ifdef CRYPTO
@@ -123,8 +147,9 @@ void DynamicUplinkPhase::sendMyUplink(long long slotStart)
                 }
 #endif
                 message.send(ctx,slotStart);
-                slotStart += packetArrivalAndProcessingTime + transmissionInterval;
+                slotStart += packetSpacing;
             }
+        }
         ctx.transceiverIdle();
         if(ENABLE_UPLINK_DBG){
             message.printHeader();
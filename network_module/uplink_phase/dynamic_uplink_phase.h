@@ -55,9 +55,10 @@ public:
      */
     void resync() override {
         // Base class status
-        nextNode = nodesCount - 1;
+        resetCurrentNode();
         // Derived class status
         topologyQueue.clear();
+        topologyBases.clear();
         smeQueue.clear();
         myNeighborTable.clear(ctx.getHop());
     };
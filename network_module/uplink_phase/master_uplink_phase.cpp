@@ -29,6 +29,7 @@
 #include "master_uplink_phase.h"
 #include "uplink_message.h"
 #include "../util/debug_settings.h"
+#include "../util/trace.h"
 #include <limits>
 
 using namespace miosix;
@@ -40,10 +41,10 @@ void MasterUplinkPhase::execute(long long slotStart)
     auto currentNode = getAndUpdateCurrentNode();
     
     if(ENABLE_UPLINK_VERB_DBG)
-        print_dbg("[U] N=%u NT=%lld\n", currentNode, NetworkTime::fromLocalTime(slotStart).get());
+        trace_dbg(TraceEvent::UPLINK_SLOT, currentNode, 0, 0, NetworkTime::fromLocalTime(slotStart).get());
 
     if (currentNode == myId) sendMyUplink(slotStart);
-    else receiveUplink(slotStart, currentNode);
+    else if (currentNode < nodesCount) receiveUplink(slotStart, currentNode);
 
     // Consume elements from the topology queue
     topology.handleTopologies(topologyQueue);
@@ -79,13 +80,13 @@ void MasterUplinkPhase::sendMyUplink(long long slotStart)
 #endif
     SendUplinkMessage message(ctx.getNetworkConfig(), 0, false, ctx.getNetworkId(),
                               myNeighborTable.getMyTopologyElement(),
-                              0, 0
+                              {}, 0
 #ifdef CRYPTO
                               , keyManager.getUplinkOCB()
 #endif
                               );
     if(ENABLE_UPLINK_DYN_INFO_DBG)
-        print_dbg("[U] N=%u -> @%llu\n", ctx.getNetworkId(), NetworkTime::fromLocalTime(slotStart).get());
+        trace_dbg(TraceEvent::UPLINK_SENT, ctx.getNetworkId(), 0, 0, NetworkTime::fromLocalTime(slotStart).get());
 
 #ifdef CRYPTO
     if(ctx.getNetworkConfig().getAuthenticateControlMessages()) {
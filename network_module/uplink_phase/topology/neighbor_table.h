@@ -141,6 +141,11 @@ public:
 
     const TopologyElement& getMyTopologyElement() { return myTopologyElement; };
 
+    /**
+     * \return true if the node is a strong or weak neighbor
+     */
+    bool isNeighbor(unsigned char node) { return neighbors[node].getStatus() != Neighbor::Status::UNKNOWN; };
+
 private:
 
     void setHop(unsigned char newHop) { myHop = newHop; }
@@ -42,7 +42,9 @@ void NetworkTopology::handleTopologies(UpdatableQueue<unsigned char,
 
     int numTopologies = topologies.size();
     for(int i=0; i<numTopologies; i++) {
-        doReceivedTopology(topologies.dequeue());
+        auto topology = topologies.dequeue();
+        if(deltaTopologies && resolveDelta(topology) == false) continue;
+        doReceivedTopology(topology);
     }
 
     // Unlock mutex, we finished modifying the graph
@@ -95,6 +97,25 @@ void NetworkTopology::performDelayedChangesChecks()
     addedWhileScheduling.clear();
 }
 
+bool NetworkTopology::resolveDelta(TopologyElement& topology) {
+    // Mutex already locked by caller
+    auto it = topologyBases.find(topology.getId());
+    if(topology.isDelta() == false) {
+        if(it != topologyBases.end()) it->second = topology;
+        else topologyBases.insert(std::make_pair(topology.getId(), topology));
+        return true;
+    }
+    // Deltas whose base was lost are dropped until the next full topology
+    if(it == topologyBases.end() ||
+       it->second.getVersion() != topology.getVersion()) {
+        if(ENABLE_UPLINK_DBG)
+            print_dbg("[U] Topo %03d: delta base missing\n", topology.getId());
+        return false;
+    }
+    topology = it->second.applyDelta(topology);
+    return true;
+}
+
 void NetworkTopology::doReceivedTopology(const TopologyElement& topology) {
     // Mutex already locked by caller
     unsigned char src = topology.getId();
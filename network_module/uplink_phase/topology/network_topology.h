@@ -40,6 +40,7 @@
 #endif
 
 #include <set>
+#include <map>
 #include <vector>
 #include <utility>
 
@@ -61,6 +62,7 @@ public:
     NetworkTopology(const NetworkConfiguration& config) :
         channelSpatialReuse(config.getChannelSpatialReuse()),
         useWeakTopologies(config.getUseWeakTopologies()),
+        deltaTopologies(config.getDeltaTopologies()),
         graph(config.getMaxNodes()),
         weakGraph(config.getMaxNodes()) {}
 
@@ -171,9 +173,18 @@ private:
     /* Method used internally to add or remove arcs of the graph depending on
        the forwarded topology */
     void doReceivedTopology(const TopologyElement& topology);
+
+    /* Method used internally to replace a delta topology with the full
+       topology it encodes, returns false if its base was not received */
+    bool resolveDelta(TopologyElement& topology);
     
     bool channelSpatialReuse;
     bool useWeakTopologies;
+    bool deltaTopologies;
+
+    /* With delta topologies, last full topology received for each node, used
+       as base for the deltas */
+    std::map<unsigned char, TopologyElement> topologyBases;
 
     /* NetworkGraph class containing the complete graph of the network */
     GRAPH_TYPE graph;
@@ -60,4 +60,242 @@ bool TopologyElement::validateInPacket(Packet& packet, unsigned int offset,
     return (packet[offset] < maxNodes);
 }
 
+/**
+ * \return the number of bits set in a bitset
+ */
+static unsigned int countNodes(const RuntimeBitset& bitset) {
+    unsigned int result = 0;
+    for(unsigned int i = 0; i < bitset.bitSize(); i++)
+        if(bitset[i]) result++;
+    return result;
+}
+
+/**
+ * Serialize the nodes in a bitset as a count followed by the node IDs
+ */
+static void putNodeList(Packet& pkt, const RuntimeBitset& nodes) {
+    unsigned char count = countNodes(nodes);
+    pkt.put(&count, sizeof(unsigned char));
+    for(unsigned int i = 0; i < nodes.bitSize(); i++) {
+        unsigned char node = i;
+        if(nodes[i]) pkt.put(&node, sizeof(unsigned char));
+    }
+}
+
+/**
+ * Deserialize a list written by putNodeList(), setting the listed nodes
+ */
+static void getNodeList(Packet& pkt, RuntimeBitset& nodes) {
+    unsigned char count;
+    pkt.get(&count, sizeof(unsigned char));
+    for(int i = 0; i < count; i++) {
+        unsigned char node;
+        pkt.get(&node, sizeof(unsigned char));
+        nodes[node] = true;
+    }
+}
+
+static void putVersionField(Packet& pkt, unsigned short version) {
+    unsigned char bytes[2] = { static_cast<unsigned char>(version >> 8),
+                               static_cast<unsigned char>(version & 0xff) };
+    pkt.put(bytes, sizeof(bytes));
+}
+
+static unsigned short getVersionField(Packet& pkt) {
+    unsigned char bytes[2];
+    pkt.get(bytes, sizeof(bytes));
+    return bytes[0] << 8 | bytes[1];
+}
+
+/**
+ * Validate consecutive lists written by putNodeList()
+ * \return the offset past the last list, or 0 if not valid
+ */
+static unsigned int validateNodeLists(Packet& packet, unsigned int offset,
+                                      unsigned int numLists, unsigned short maxNodes) {
+    for(unsigned int i = 0; i < numLists; i++) {
+        if(offset + 1 > packet.size()) return 0;
+        unsigned int count = packet[offset++];
+        if(offset + count > packet.size()) return 0;
+        for(unsigned int j = 0; j < count; j++)
+            if(packet[offset + j] >= maxNodes) return 0;
+        offset += count;
+    }
+    return offset;
+}
+
+bool TopologyElement::isSparse() const {
+    return neighborsSize(true) < neighborsSize(false);
+}
+
+std::size_t TopologyElement::neighborsSize(bool sparse) const {
+    assert(delta == false);
+    if(sparse == false) {
+        if(weakTop) return neighbors.size() + weakNeighbors.size();
+        else return neighbors.size();
+    }
+    if(weakTop) return 2 + countNodes(neighbors) + countNodes(weakNeighbors);
+    else return 1 + countNodes(neighbors);
+}
+
+void TopologyElement::serializeNeighbors(Packet& pkt, bool sparse) const {
+    assert(delta == false);
+    if(sparse == false) {
+        pkt.put(neighbors.data(), neighbors.size());
+        if(weakTop) pkt.put(weakNeighbors.data(), weakNeighbors.size());
+    } else {
+        putNodeList(pkt, neighbors);
+        if(weakTop) putNodeList(pkt, weakNeighbors);
+    }
+}
+
+void TopologyElement::deserializeNeighbors(Packet& pkt, bool sparse) {
+    assert(neighbors.size()>0);
+    delta = false;
+    if(sparse == false) {
+        pkt.get(neighbors.data(), neighbors.size());
+        if(weakTop) {
+            assert(weakNeighbors.size()>0);
+            pkt.get(weakNeighbors.data(), weakNeighbors.size());
+        }
+    } else {
+        clear();
+        getNodeList(pkt, neighbors);
+        if(weakTop) getNodeList(pkt, weakNeighbors);
+    }
+}
+
+unsigned int TopologyElement::validateNeighborsInPacket(Packet& packet, unsigned int offset,
+                                                        unsigned short maxNodes,
+                                                        bool useWeakTopologies, bool sparse) {
+    unsigned int numBitmasks = useWeakTopologies ? 2 : 1;
+    unsigned int end;
+    if(sparse == false) {
+        end = offset + numBitmasks * ((maxNodes + 7) / 8);
+        if(end > packet.size()) return 0;
+    } else {
+        end = validateNodeLists(packet, offset, numBitmasks, maxNodes);
+        if(end == 0) return 0;
+    }
+    return end - offset;
+}
+
+std::size_t TopologyElement::encodedSize(bool allowSparse) const {
+    // Id and encoding byte
+    std::size_t result = 2 * sizeof(unsigned char);
+    if(delta == false) {
+        if(version != 0) result += sizeof(unsigned short);
+        result += neighborsSize(allowSparse && isSparse());
+    } else {
+        // Base version and node lists
+        result += sizeof(unsigned short) + 2 + countNodes(neighbors) + countNodes(removed);
+        if(weakTop) result += 2 + countNodes(weakNeighbors) + countNodes(weakRemoved);
+    }
+    return result;
+}
+
+void TopologyElement::serializeEncoded(Packet& pkt, bool allowSparse) const {
+    bool sparse = delta == false && allowSparse && isSparse();
+    unsigned char encoding = delta ? deltaFlag : (sparse ? sparseFlag : 0);
+    if(delta == false && version != 0) encoding |= versionFlag;
+    pkt.put(&id, sizeof(unsigned char));
+    pkt.put(&encoding, sizeof(unsigned char));
+    if(delta == false) {
+        if(version != 0) putVersionField(pkt, version);
+        serializeNeighbors(pkt, sparse);
+    } else {
+        putVersionField(pkt, version);
+        putNodeList(pkt, neighbors);
+        putNodeList(pkt, removed);
+        if(weakTop) {
+            putNodeList(pkt, weakNeighbors);
+            putNodeList(pkt, weakRemoved);
+        }
+    }
+}
+
+void TopologyElement::deserializeEncoded(Packet& pkt) {
+    assert(neighbors.size()>0);
+    unsigned char encoding;
+    pkt.get(&id, sizeof(unsigned char));
+    pkt.get(&encoding, sizeof(unsigned char));
+    if((encoding & deltaFlag) == 0) {
+        version = (encoding & versionFlag) ? getVersionField(pkt) : 0;
+        deserializeNeighbors(pkt, encoding & sparseFlag);
+    } else {
+        delta = true;
+        version = getVersionField(pkt);
+        clear();
+        removed = RuntimeBitset(neighbors.bitSize(), 0);
+        getNodeList(pkt, neighbors);
+        getNodeList(pkt, removed);
+        if(weakTop) {
+            weakRemoved = RuntimeBitset(weakNeighbors.bitSize(), 0);
+            getNodeList(pkt, weakNeighbors);
+            getNodeList(pkt, weakRemoved);
+        }
+    }
+}
+
+unsigned int TopologyElement::validateEncodedInPacket(Packet& packet, unsigned int offset,
+                                                      unsigned short maxNodes,
+                                                      bool useWeakTopologies) {
+    if(offset + 2 > packet.size()) return 0;
+    if(packet[offset] >= maxNodes) return 0;
+    unsigned char encoding = packet[offset + 1];
+    unsigned int size;
+    if((encoding & ~(sparseFlag | versionFlag)) == 0) {
+        unsigned int versionSize = (encoding & versionFlag) ? sizeof(unsigned short) : 0;
+        size = validateNeighborsInPacket(packet, offset + 2 + versionSize, maxNodes,
+                                         useWeakTopologies, encoding & sparseFlag);
+        if(size != 0) size += versionSize;
+    } else if(encoding == deltaFlag) {
+        // Skip base version, then added and removed nodes
+        unsigned int numLists = useWeakTopologies ? 4 : 2;
+        unsigned int start = offset + 2 + sizeof(unsigned short);
+        if(start > packet.size()) return 0;
+        unsigned int end = validateNodeLists(packet, start, numLists, maxNodes);
+        size = end == 0 ? 0 : end - offset - 2;
+    } else return 0;
+    if(size == 0) return 0;
+    return size + 2;
+}
+
+TopologyElement TopologyElement::makeDelta(const TopologyElement& base,
+                                           const TopologyElement& current) {
+    unsigned int maxNodes = current.neighbors.bitSize();
+    TopologyElement result(current.id, maxNodes, current.weakTop);
+    result.delta = true;
+    result.version = base.version;
+    result.removed = RuntimeBitset(maxNodes, 0);
+    for(unsigned int i = 0; i < maxNodes; i++) {
+        if(current.neighbors[i] && !base.neighbors[i]) result.neighbors[i] = true;
+        if(!current.neighbors[i] && base.neighbors[i]) result.removed[i] = true;
+    }
+    if(current.weakTop) {
+        result.weakRemoved = RuntimeBitset(maxNodes, 0);
+        for(unsigned int i = 0; i < maxNodes; i++) {
+            if(current.weakNeighbors[i] && !base.weakNeighbors[i]) result.weakNeighbors[i] = true;
+            if(!current.weakNeighbors[i] && base.weakNeighbors[i]) result.weakRemoved[i] = true;
+        }
+    }
+    return result;
+}
+
+TopologyElement TopologyElement::applyDelta(const TopologyElement& delta) const {
+    assert(this->delta == false && delta.delta);
+    TopologyElement result(*this);
+    for(unsigned int i = 0; i < neighbors.bitSize(); i++) {
+        if(delta.neighbors[i]) result.neighbors[i] = true;
+        if(delta.removed[i]) result.neighbors[i] = false;
+    }
+    if(weakTop) {
+        for(unsigned int i = 0; i < weakNeighbors.bitSize(); i++) {
+            if(delta.weakNeighbors[i]) result.weakNeighbors[i] = true;
+            if(delta.weakRemoved[i]) result.weakNeighbors[i] = false;
+        }
+    }
+    return result;
+}
+
 } /* namespace mxnet */
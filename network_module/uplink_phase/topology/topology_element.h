@@ -39,6 +39,18 @@ class Packet;
  * TopologyElement containg a map of the neighbors of a given node on the network
  * and the Id of that node.
  * It is sent from the Dynamic nodes towards the Master node contained in UplinkMessage
+ *
+ * With delta topologies, a TopologyElement can also be a delta, containing the
+ * neighbors added and removed with respect to a base, that is the last full
+ * topology of the same node forwarded by the node that generated the delta.
+ * Full topologies that can be used as a base carry a version, unique for the
+ * node and the forwarder, and deltas carry the version of their base, so that
+ * the master can apply a delta only if it has received the same base.
+ * In a delta the neighbors and weakNeighbors bitmasks contain the added
+ * neighbors, while removed and weakRemoved contain the removed ones.
+ *
+ * With sparse topologies, a full TopologyElement is serialized as lists of
+ * neighbor IDs instead of bitmasks when smaller.
  */
 class TopologyElement : public SerializableMessage {
 public:
@@ -101,6 +113,95 @@ public:
     static bool validateInPacket(Packet& packet, unsigned int offset,
                                  unsigned short maxNodes);
 
+    /**
+     * \return the maximum size in the variable size encoding, that is the one
+     * of a versioned full topology as bitmasks plus the encoding byte, as the
+     * other encodings are only used when smaller
+     */
+    static unsigned short maxEncodedSize(unsigned short bitmaskSize, bool useWeakTopologies) {
+        return maxSize(bitmaskSize, useWeakTopologies) + sizeof(unsigned char) +
+               sizeof(unsigned short);
+    }
+
+    /**
+     * \return true if the neighbors are smaller as lists of IDs than as
+     * bitmasks, as in nodes with few neighbors in large networks
+     */
+    bool isSparse() const;
+
+    /**
+     * \return the size of the neighbors serialized by serializeNeighbors()
+     */
+    std::size_t neighborsSize(bool sparse) const;
+
+    /**
+     * Serialize the neighbors only, as bitmasks or as lists of IDs
+     */
+    void serializeNeighbors(Packet& pkt, bool sparse) const;
+
+    /**
+     * Deserialize the neighbors written by serializeNeighbors()
+     */
+    void deserializeNeighbors(Packet& pkt, bool sparse);
+
+    /**
+     * \return the size of the neighbors serialized by serializeNeighbors() at
+     * the given offset in the packet, or 0 if they are not valid
+     */
+    static unsigned int validateNeighborsInPacket(Packet& packet, unsigned int offset,
+                                                  unsigned short maxNodes,
+                                                  bool useWeakTopologies, bool sparse);
+
+    /**
+     * \param allowSparse if true, full topologies are encoded as lists of IDs
+     * when smaller
+     * \return the size of the variable size encoding, used when delta or
+     * sparse topologies are enabled
+     */
+    std::size_t encodedSize(bool allowSparse) const;
+
+    /**
+     * Serialize with the variable size encoding
+     */
+    void serializeEncoded(Packet& pkt, bool allowSparse) const;
+
+    /**
+     * Deserialize from the variable size encoding. The TopologyElement has to
+     * be constructed with the maxNodes and useWeakTopologies of the network
+     */
+    void deserializeEncoded(Packet& pkt);
+
+    /**
+     * \return the size of the element in the variable size encoding at the
+     * given offset in the packet, or 0 if it is not valid
+     */
+    static unsigned int validateEncodedInPacket(Packet& packet, unsigned int offset,
+                                                unsigned short maxNodes,
+                                                bool useWeakTopologies);
+
+    /**
+     * \param base last full topology of the node that was forwarded
+     * \param current current full topology of the same node
+     * \return a delta that transforms base into current
+     */
+    static TopologyElement makeDelta(const TopologyElement& base,
+                                     const TopologyElement& current);
+
+    /**
+     * \param delta a delta whose base is this full topology
+     * \return the full topology obtained applying the delta
+     */
+    TopologyElement applyDelta(const TopologyElement& delta) const;
+
+    bool isDelta() const { return delta; }
+
+    /**
+     * \return the version of a full topology, 0 if it cannot be used as a
+     * base, or the version of the base of a delta
+     */
+    unsigned short getVersion() const { return version; }
+    void setVersion(unsigned short version) { this->version = version; }
+
     unsigned char getId() const { return id; }
 
     const RuntimeBitset& getNeighbors() const { return neighbors; }
@@ -122,6 +223,17 @@ private:
     RuntimeBitset weakNeighbors;
     /* Whether weak topology bitmask is being used and should be serialized*/
     bool weakTop;
+    /* Whether this is a delta, and the version of the base or of the delta's base */
+    bool delta = false;
+    unsigned short version = 0;
+    /* Neighbors and weak neighbors removed by a delta */
+    RuntimeBitset removed;
+    RuntimeBitset weakRemoved;
+
+    /* Flags in the encoding byte of the variable size encoding */
+    static const unsigned char deltaFlag = 0x80;
+    static const unsigned char sparseFlag = 0x40;
+    static const unsigned char versionFlag = 0x20;
 };
 
 } /* namespace mxnet */
@@ -39,13 +39,15 @@ SendUplinkMessage::SendUplinkMessage(const NetworkConfiguration& config,
                                      unsigned char hop,
                                      bool badFlag, unsigned char assignee,
                                      const TopologyElement& myTopology,
-                                     int availableTopologies, int availableSMEs
+                                     const std::vector<unsigned short>& topologySizes,
+                                     int availableSMEs
 #ifdef CRYPTO
                                      , AesOcb& ocb
 #endif
                                      ) :
     weakTop(config.getUseWeakTopologies()),
-    topologySize(TopologyElement::maxSize(config.getNeighborBitmaskSize(), weakTop)),
+    encodedTopologies(config.getVariableSizeTopologies()),
+    sparseTopologies(config.getSparseTopologies()),
     smeSize(StreamManagementElement::maxSize()),
     panId(config.getPanId())
 #ifdef CRYPTO
@@ -54,7 +56,11 @@ SendUplinkMessage::SendUplinkMessage(const NetworkConfiguration& config,
     encrypt(config.getEncryptControlMessages())
 #endif
 {
-    computePacketAllocation(config, availableTopologies, availableSMEs);
+    // The first packet capacity assumes the sender topology as bitmasks
+    bool sparse = sparseTopologies && myTopology.isSparse();
+    int firstPacketCapacity = getFirstUplinkPacketCapacity(config) +
+        myTopology.neighborsSize(false) - myTopology.neighborsSize(sparse);
+    computePacketAllocation(config, firstPacketCapacity, topologySizes, availableSMEs);
 #ifdef CRYPTO
     if(authenticate) packet.reserveTag();
 #endif
@@ -62,31 +68,27 @@ SendUplinkMessage::SendUplinkMessage(const NetworkConfiguration& config,
     unsigned char hopFlag;
     if(badFlag) hopFlag = hop | 0x80;
     else hopFlag = hop & 0x7F;
+    if(sparse) hopFlag |= UplinkHeader::sparseTopologyFlag;
     header = {hopFlag, assignee, numTopologies, numSMEs};
     packet.put(&header, sizeof(UplinkHeader));
-    auto& neighbors = myTopology.getNeighbors();
-    packet.put(neighbors.data(), neighbors.size());
-    if(weakTop) {
-        auto& weakNeighbors = myTopology.getWeakNeighbors();
-        packet.put(weakNeighbors.data(), weakNeighbors.size());
-    }
+    myTopology.serializeNeighbors(packet, sparse);
 }
 
 void SendUplinkMessage::serializeTopologiesAndSMEs(UpdatableQueue<unsigned char,TopologyElement>& topologies,
                                                   UpdatableQueue<SMEKey,StreamManagementElement>& smes) {
     int remainingBytes = packet.available();
     // Fit topologies in packets
-    int packetTopologies = std::min<int>(numTopologies, remainingBytes / topologySize);
-    for(int i = 0; i < packetTopologies; i++) {
+    while(numTopologies > 0 && topologySizes[nextTopology] <= remainingBytes) {
         auto topology = topologies.dequeue();
-        topology.serialize(packet);
+        if(encodedTopologies) topology.serializeEncoded(packet, sparseTopologies);
+        else topology.serialize(packet);
+        remainingBytes -= topologySizes[nextTopology++];
+        numTopologies--;
     }
-    numTopologies -= packetTopologies;
     // NOTE: Do not put SMEs as long as there are topologies left
     if(numTopologies > 0)
         return;
 
-    remainingBytes -= packetTopologies * topologySize;
     // Fit SMEs in packets
     int packetSMEs = std::min<int>(numSMEs, remainingBytes / smeSize);
     for(int i = 0; i < packetSMEs; i++) {
@@ -97,7 +99,10 @@ void SendUplinkMessage::serializeTopologiesAndSMEs(UpdatableQueue<unsigned char,
 }
 
 void SendUplinkMessage::computePacketAllocation(const NetworkConfiguration& config,
-                                                int availableTopologies, int availableSMEs) {
+                                                int firstPacketCapacity,
+                                                const std::vector<unsigned short>& topologySizes,
+                                                int availableSMEs) {
+    const int availableTopologies = topologySizes.size();
     const int maxPackets = config.getNumUplinkPackets();
     const int guaranteedTopologies = config.getGuaranteedTopologies();
     /* Calculate numTopologies and numSME without considering a topology or SME
@@ -108,36 +113,39 @@ void SendUplinkMessage::computePacketAllocation(const NetworkConfiguration& conf
           - if there is space remaining, try to fit other topologies
     */
     {
-        const int totAvailableBytes = getFirstUplinkPacketCapacity(config) +
+        const int totAvailableBytes = firstPacketCapacity +
             (maxPackets - 1) * getOtherUplinkPacketCapacity(config);
-        numTopologies = std::min(guaranteedTopologies, availableTopologies);
-        const int remainingTopologies = availableTopologies - numTopologies;
-        const int topologyBytes = numTopologies * topologySize;
+        int topologies = std::min(guaranteedTopologies, availableTopologies);
+        int topologyBytes = 0;
+        for(int i = 0; i < topologies; i++) topologyBytes += topologySizes[i];
         const int maxSMEs = (totAvailableBytes - topologyBytes) / smeSize;
         numSMEs = std::min(availableSMEs, maxSMEs);
-        const int unusedBytes = totAvailableBytes - topologyBytes -
+        int unusedBytes = totAvailableBytes - topologyBytes -
             (numSMEs * smeSize);
-        numTopologies += std::min<int>(unusedBytes / topologySize, remainingTopologies);
+        while(topologies < availableTopologies && topologySizes[topologies] <= unusedBytes)
+            unusedBytes -= topologySizes[topologies++];
+        numTopologies = topologies;
     }
 
     /* Try to fit numTopologies and numSME in packet, to get the actual numbers,
        also considering SMEs and Topologies split between two packets */
-    int remainingBytes = getFirstUplinkPacketCapacity(config);
+    int remainingBytes = firstPacketCapacity;
     totPackets = 1;
     // Fit topologies in packets
-    int remainingTopologies = numTopologies;
+    int fittedTopologies = 0;
     for(;;) {
         // NOTE: Do the allocation also for the last packet
-        int packetTopologies = std::min<int>(remainingTopologies, remainingBytes / topologySize);
-        remainingTopologies -= packetTopologies;
-        remainingBytes -= packetTopologies * topologySize;
-        if(remainingTopologies == 0 || totPackets >= maxPackets) break;
+        while(fittedTopologies < numTopologies &&
+              topologySizes[fittedTopologies] <= remainingBytes)
+            remainingBytes -= topologySizes[fittedTopologies++];
+        if(fittedTopologies == numTopologies || totPackets >= maxPackets) break;
         totPackets++;
         remainingBytes = getOtherUplinkPacketCapacity(config);
     }
     /* NOTE: Handling the corner case in which after splitting in packets, we can't
        fit all the topologies */
-    numTopologies -= remainingTopologies;
+    numTopologies = fittedTopologies;
+    this->topologySizes.assign(topologySizes.begin(), topologySizes.begin() + numTopologies);
 
     // Fit SMEs in packets
     int remainingSMEs = numSMEs;
@@ -174,7 +182,16 @@ bool ReceiveUplinkMessage::recv(MACContext& ctx, long long tExpected) {
     auto rcvResult = packet.recv(ctx, tExpected);
     if(rcvResult.error != miosix::RecvResult::ErrorCode::OK)
         return false;
+    return process(ctx, rcvResult);
+}
 
+bool ReceiveUplinkMessage::recv(MACContext& ctx, const Packet& captured,
+                                const miosix::RecvResult& rcvResult) {
+    packet = captured;
+    return process(ctx, rcvResult);
+}
+
+bool ReceiveUplinkMessage::process(MACContext& ctx, const miosix::RecvResult& rcvResult) {
     auto& config = ctx.getNetworkConfig();
 
 #ifdef CRYPTO
@@ -205,6 +222,23 @@ bool ReceiveUplinkMessage::recv(MACContext& ctx, long long tExpected) {
     return true;
 }
 
+/**
+ * Enqueue a variable size topology. A delta never replaces a full topology
+ * that has not been forwarded yet. If the full topology is the base of the
+ * delta, the master needs it unchanged to apply the later deltas, that are
+ * cumulative and so also carry the changes of the dropped one. Otherwise the
+ * delta could not be applied by the master anyway
+ */
+static void enqueueEncodedTopology(UpdatableQueue<unsigned char,TopologyElement>& topologies,
+                                   TopologyElement&& topology) {
+    unsigned char id = topology.getId();
+    if(topology.isDelta()) {
+        auto pending = topologies.find(id);
+        if(pending != nullptr && pending->isDelta() == false) return;
+    }
+    topologies.enqueue(id, std::move(topology));
+}
+
 void ReceiveUplinkMessage::deserializeTopologiesAndSMEs(UpdatableQueue<unsigned char,
                                                         TopologyElement>& topologies,
                                                         UpdatableQueue<SMEKey,
@@ -212,6 +246,11 @@ void ReceiveUplinkMessage::deserializeTopologiesAndSMEs(UpdatableQueue<unsigned
     for(int i = 0; i < getNumPacketTopologies(); i++) {
         //Need to first know maxNodes to be deserialized
         TopologyElement topology(maxNodes, weakTop);
+        if(encodedTopologies) {
+            topology.deserializeEncoded(packet);
+            enqueueEncodedTopology(topologies, std::move(topology));
+            continue;
+        }
         topology.deserialize(packet);
         unsigned char id = topology.getId();
         topologies.enqueue(id, std::move(topology));
@@ -236,8 +275,19 @@ bool ReceiveUplinkMessage::checkFirstPacket(const NetworkConfiguration& config)
     // Extract sender topology
     RuntimeBitset tempSenderTopology(maxNodes);
     RuntimeBitset tempSenderWeakTopology(maxNodes);
-    packet.get(tempSenderTopology.data(), bitsetSize);
-    if(weakTop) packet.get(tempSenderWeakTopology.data(), bitsetSize);
+    if(sparseTopologies) {
+        bool sparse = tempHeader.hop & UplinkHeader::sparseTopologyFlag;
+        if(TopologyElement::validateNeighborsInPacket(packet, 0, maxNodes,
+                                                      weakTop, sparse) == 0)
+            return false;
+        TopologyElement senderTopology(maxNodes, weakTop);
+        senderTopology.deserializeNeighbors(packet, sparse);
+        tempSenderTopology = senderTopology.getNeighbors();
+        if(weakTop) tempSenderWeakTopology = senderTopology.getWeakNeighbors();
+    } else {
+        packet.get(tempSenderTopology.data(), bitsetSize);
+        if(weakTop) packet.get(tempSenderWeakTopology.data(), bitsetSize);
+    }
 
     // Check topologies and SME only if uplink packet has any of them
     if(tempHeader.numTopology != 0 || tempHeader.numSME != 0)
@@ -262,6 +312,7 @@ bool ReceiveUplinkMessage::checkOtherPacket(const NetworkConfiguration& config)
 
 bool ReceiveUplinkMessage::checkTopologiesAndSMEs(const NetworkConfiguration& config,
                                                   UplinkHeader tempHeader) {
+    if(encodedTopologies) return checkEncodedTopologiesAndSMEs(config, tempHeader);
     /* Validate numTopologies and numSME in UplinkHeader
        by trying to extract from an example packet the same number of topologies and SME */
     const int maxPackets = config.getNumUplinkPackets();
@@ -341,4 +392,48 @@ bool ReceiveUplinkMessage::checkTopologiesAndSMEs(const NetworkConfiguration& co
     return true;
 }
 
+bool ReceiveUplinkMessage::checkEncodedTopologiesAndSMEs(const NetworkConfiguration& config,
+                                                         UplinkHeader tempHeader) {
+    /* Topologies are variable sized, so the allocation can not be recomputed
+       from the header, the packet is instead walked element by element,
+       carrying the number of elements still to be received between packets */
+    int topologiesLeft = receivedPackets == 0 ? tempHeader.numTopology : remainingTopologies;
+    int SMEsLeft = receivedPackets == 0 ? tempHeader.numSME : remainingSMEs;
+    unsigned int offset = 0;
+    unsigned int topologiesInPacket = 0;
+    unsigned int SMEsInPacket = 0;
+    while(topologiesLeft > 0 && offset < packet.size()) {
+        unsigned int size = TopologyElement::validateEncodedInPacket(packet, offset,
+                                                                     maxNodes, weakTop);
+        if(size == 0) return false;
+        offset += size;
+        topologiesInPacket++;
+        topologiesLeft--;
+    }
+    // NOTE: SMEs are sent only after all topologies
+    if(topologiesLeft == 0) {
+        while(SMEsLeft > 0 && offset + smeSize <= packet.size()) {
+            if(StreamManagementElement::validateInPacket(packet, offset, maxNodes) == false)
+                return false;
+            offset += smeSize;
+            SMEsInPacket++;
+            SMEsLeft--;
+        }
+    }
+    // Check size of data in packet
+    if(offset != packet.size()) return false;
+    // Only the first packet can be without topologies and SMEs
+    if(receivedPackets > 0 && topologiesInPacket + SMEsInPacket == 0) return false;
+    bool complete = topologiesLeft == 0 && SMEsLeft == 0;
+    if(!complete && receivedPackets + 1 >= config.getNumUplinkPackets()) return false;
+
+    // Write temporary values to class fields
+    totPackets = complete ? receivedPackets + 1 : receivedPackets + 2;
+    remainingTopologies = topologiesLeft;
+    remainingSMEs = SMEsLeft;
+    packetTopologies = topologiesInPacket;
+    packetSMEs = SMEsInPacket;
+    return true;
+}
+
 } /* namespace mxnet */
@@ -36,6 +36,7 @@
 #include "../util/runtime_bitset.h"
 #include "../stream/stream_management_element.h"
 #include "topology/topology_element.h"
+#include <vector>
 
 namespace mxnet {
 
@@ -52,6 +53,9 @@ struct UplinkHeader {
         if(hop & 0x80) return true;
         else return false;
     }
+
+    // With sparse topologies, flags a sender topology sent as lists of IDs
+    static const unsigned char sparseTopologyFlag = 0x40;
 } __attribute__((packed));
 
 /**
@@ -116,13 +120,15 @@ public:
     SendUplinkMessage(const NetworkConfiguration& config, unsigned char hop,
                       bool badFlag, unsigned char assignee,
                       const TopologyElement& myTopology,
-                      int availableTopologies, int availableSMEs,
+                      const std::vector<unsigned short>& topologySizes,
+                      int availableSMEs,
                       AesOcb& ocb);
 #else
     SendUplinkMessage(const NetworkConfiguration& config, unsigned char hop,
                       bool badFlag, unsigned char assignee,
                       const TopologyElement& myTopology,
-                      int availableTopologies, int availableSMEs);
+                      const std::vector<unsigned short>& topologySizes,
+                      int availableSMEs);
 #endif
 
     SendUplinkMessage(const SendUplinkMessage&) = delete;
@@ -145,14 +151,25 @@ public:
      * and prepares the next packet
      */
     void send(MACContext& ctx, long long sendTime) {
+        Packet sealed;
+        seal(sealed);
+        sealed.send(ctx, sendTime);
+    }
+
+    /**
+     * This function completes the current packet of the UplinkMessage, moving
+     * it to out so that it can be sent later, and prepares the next packet.
+     * Used to prepare all the packets of a burst before sending them
+     */
+    void seal(Packet& out) {
 #ifdef CRYPTO
         /**
-         * NOTE: it is important that setIV is called before calling send
+         * NOTE: it is important that setIV is called before calling seal
          */
         if(encrypt) packet.encryptAndPutTag(ocb);
         else if(authenticate) packet.putTag(ocb);
 #endif
-        packet.send(ctx, sendTime);
+        out = packet;
         // Prepare the next packet
         packet.clear();
 #ifdef CRYPTO
@@ -165,9 +182,10 @@ public:
 
     /**
      * @return the hop of the message sender
-     * We use the most significant bit of the hop field as badAssignee flag
+     * We use the most significant bit of the hop field as badAssignee flag,
+     * and with sparse topologies the next one as sparseTopologyFlag
      */
-    unsigned char getHop() const { return header.hop & 0x7F; }
+    unsigned char getHop() const { return header.hop & (sparseTopologies ? 0x3F : 0x7F); }
 
     /**
      * @return the badAssignee flag
@@ -194,11 +212,14 @@ public:
 private:
 
     void computePacketAllocation(const NetworkConfiguration& config,
-                                 int availableTopologies, int availableSMEs);
+                                 int firstPacketCapacity,
+                                 const std::vector<unsigned short>& topologySizes,
+                                 int availableSMEs);
 
     /* Constant values used in the methods */
     bool weakTop;
-    const unsigned int topologySize;
+    bool encodedTopologies;
+    bool sparseTopologies;
     const unsigned int smeSize;
     const unsigned short panId;
     UplinkHeader header;
@@ -216,6 +237,10 @@ private:
        Initialized by the constructor and decremented
        every time a new SME is serialized */
     unsigned char numSMEs;
+    /* Size of the topologies sent in UplinkMessage, in queue order */
+    std::vector<unsigned short> topologySizes;
+    /* Index in topologySizes of the next topology to serialize */
+    int nextTopology = 0;
 
 #ifdef CRYPTO
     AesOcb& ocb;
@@ -231,6 +256,8 @@ public:
         bitsetSize(config.getNeighborBitmaskSize()),
         maxNodes(config.getMaxNodes()),
         weakTop(config.getUseWeakTopologies()),
+        encodedTopologies(config.getVariableSizeTopologies()),
+        sparseTopologies(config.getSparseTopologies()),
         topologySize(TopologyElement::maxSize(bitsetSize, weakTop)),
         smeSize(StreamManagementElement::maxSize()),
         panId(config.getPanId()),
@@ -244,6 +271,8 @@ public:
         bitsetSize(config.getNeighborBitmaskSize()),
         maxNodes(config.getMaxNodes()),
         weakTop(config.getUseWeakTopologies()),
+        encodedTopologies(config.getVariableSizeTopologies()),
+        sparseTopologies(config.getSparseTopologies()),
         topologySize(TopologyElement::maxSize(bitsetSize, weakTop)),
         smeSize(StreamManagementElement::maxSize()),
         panId(config.getPanId()),
@@ -266,7 +295,29 @@ public:
     bool recv(MACContext& ctx, long long tExpected);
 
     /**
-     * @return the number of packets
+     * Listen on the radio for a packet of a burst, without verifying it, so
+     * that the next packet can be received right after it
+     * @return true if a packet is received, that has to be passed to recv()
+     * once the burst is over
+     */
+    static bool capture(MACContext& ctx, long long tExpected, Packet& captured,
+                        miosix::RecvResult& rcvResult) {
+        rcvResult = captured.recv(ctx, tExpected);
+        return rcvResult.error == miosix::RecvResult::ErrorCode::OK;
+    }
+
+    /**
+     * This function processes the next Packet of the UplinkMessage, previously
+     * obtained with capture()
+     * @return true if the packet is valid.
+     */
+    bool recv(MACContext& ctx, const Packet& captured,
+              const miosix::RecvResult& rcvResult);
+
+    /**
+     * @return the number of packets. With variable size topologies it is only
+     * known as packets are received, so it is the number of packets received
+     * so far, plus one if the UplinkMessage is not complete
      */
     int getNumPackets() const { return totPackets; }
 
@@ -282,9 +333,10 @@ public:
 
     /**
      * @return the hop of the message sender
-     * We use the most significant bit of the hop field as badAssignee flag
+     * We use the most significant bit of the hop field as badAssignee flag,
+     * and with sparse topologies the next one as sparseTopologyFlag
      */
-    unsigned char getHop() const { return header.hop & 0x7F; }
+    unsigned char getHop() const { return header.hop & (sparseTopologies ? 0x3F : 0x7F); }
 
     /**
      * @return the badAssignee flag
@@ -333,6 +385,12 @@ public:
 
 private:
 
+    /**
+     * Verifies and checks the packet just received
+     * @return true if the packet is valid
+     */
+    bool process(MACContext& ctx, const miosix::RecvResult& rcvResult);
+
     /**
      * Checks that the values in the first packet header are valid.
      * @return true if UplinkHeader of the received packet is valid, false otherwise
@@ -352,10 +410,20 @@ private:
     bool checkTopologiesAndSMEs(const NetworkConfiguration& config,
                                 UplinkHeader tempHeader);
 
+    /**
+     * Checks the variable size Topologies and SMEs contained into the last
+     * received packet.
+     * @return true if the content of the received packet is valid, false otherwise
+     */
+    bool checkEncodedTopologiesAndSMEs(const NetworkConfiguration& config,
+                                       UplinkHeader tempHeader);
+
     /* Constant values used in the methods */
     const unsigned short bitsetSize;
     const unsigned short maxNodes;
     bool weakTop;
+    bool encodedTopologies;
+    bool sparseTopologies;
     const unsigned int topologySize;
     const unsigned int smeSize;
     const unsigned short panId;
@@ -380,6 +448,10 @@ private:
     unsigned int packetTopologies = 0;
     /* Number of SMEs contained in the current packet */
     unsigned int packetSMEs = 0;
+    /* With variable size topologies, number of topologies and SMEs still to
+       be received in the next packets */
+    int remainingTopologies = 0;
+    int remainingSMEs = 0;
 
 #ifdef CRYPTO
     AesOcb& ocb;
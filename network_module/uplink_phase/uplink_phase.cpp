@@ -28,6 +28,7 @@
 
 #include "uplink_phase.h"
 #include "uplink_message.h"
+#include "../util/trace.h"
 
 namespace mxnet {
 
@@ -52,16 +53,118 @@ void UplinkPhase::alignToNetworkTime(NetworkTime nt)
         if(controlSuperframe.isControlUplink(i)) phase++;
     }
     nextNode = nodesCount - 1 - (phase % nodesCount);
+    uplinkIndex = phase;
 }
 
 unsigned char UplinkPhase::getAndUpdateCurrentNode()
 {
+    if(adaptive)
+    {
+        // The slot owner only depends on the uplink index and on the nodes
+        // of the last applied schedule, that are the same in all nodes
+        long long index = uplinkIndex++;
+        if(index % discoveryInterval == discoveryInterval - 1)
+            return nodesCount - 1 - ((index / discoveryInterval) % nodesCount);
+        if(uplinkGroups.empty()) return nodesCount;
+        long long roundRobinIndex = index - index / discoveryInterval;
+        auto& group = uplinkGroups[roundRobinIndex % uplinkGroups.size()];
+        if(group.size() == 1) return group[0];
+        // Concurrent senders: listen only to a sender that is a neighbor, as
+        // a reception from any other node could not be attributed to it. If
+        // more than one is, the topology known to the master is outdated
+        // and the packets are likely to collide
+        if(std::binary_search(group.begin(), group.end(), myId)) return myId;
+        unsigned char sender = nodesCount;
+        for(auto node : group)
+        {
+            if(myNeighborTable.isNeighbor(node) == false) continue;
+            if(sender != nodesCount) return nodesCount;
+            sender = node;
+        }
+        return sender;
+    }
     auto currentNode = nextNode;
     if (nextNode == 0) nextNode = nodesCount - 1;
     else nextNode--;
     return currentNode;
 }
 
+void UplinkPhase::setUplinkGroups(std::vector<std::vector<unsigned char>>&& groups)
+{
+    if(concurrent)
+    {
+        uplinkGroups = std::move(groups);
+        return;
+    }
+    uplinkGroups.clear();
+    for(auto& group : groups)
+        for(auto node : group) uplinkGroups.push_back({node});
+}
+
+void UplinkPhase::enqueueSenderTopology(unsigned char node, TopologyElement&& topology)
+{
+    // The master consumes its topology queue directly
+    if(deltaTopologies == false || myId == 0)
+    {
+        topologyQueue.enqueue(node, std::move(topology));
+        return;
+    }
+    // A delta can only be applied by the master if it received the base, so
+    // do not replace a base that has not been forwarded yet with a delta
+    auto pending = topologyQueue.find(node);
+    auto it = topologyBases.find(node);
+    if(it != topologyBases.end() && it->second.second < topologyRefreshInterval &&
+       (pending == nullptr || pending->isDelta()))
+    {
+        auto delta = TopologyElement::makeDelta(it->second.first, topology);
+        if(delta.encodedSize(sparseTopologies) < topology.encodedSize(sparseTopologies))
+        {
+            it->second.second++;
+            topologyQueue.enqueue(node, std::move(delta));
+            return;
+        }
+    }
+    // Send a full topology, that becomes the base for the next deltas. Its
+    // version includes this node's ID, as the master may receive bases for
+    // the same node from different forwarders
+    unsigned char counter = ++topologyVersions[node];
+    topology.setVersion(static_cast<unsigned short>(myId) << 8 | counter);
+    if(it != topologyBases.end()) it->second = std::make_pair(topology, 0);
+    else topologyBases.insert(std::make_pair(node, std::make_pair(topology, 0)));
+    topologyQueue.enqueue(node, std::move(topology));
+}
+
+std::vector<StreamManagementElement> UplinkPhase::dequeueSMEs(unsigned int maxSMEs)
+{
+    streamMgr->dequeueSMEs(smeQueue);
+    std::vector<StreamManagementElement> result;
+    while(result.size() < maxSMEs && !smeQueue.empty())
+        result.push_back(smeQueue.dequeue());
+    // Delivery reports are periodic and would be counted twice by the
+    // master if they arrived through both paths
+    for(auto& sme : result)
+        if(sme.getType() != SMEType::DELIVERY_REPORT)
+            smeQueue.enqueue(sme.getKey(), sme);
+    return result;
+}
+
+void UplinkPhase::enqueueSMEs(const std::vector<StreamManagementElement>& smes)
+{
+    for(auto& sme : smes) smeQueue.enqueue(sme.getKey(), sme);
+}
+
+std::vector<unsigned short> UplinkPhase::getTopologySizes() const
+{
+    std::vector<unsigned short> result;
+    result.reserve(topologyQueue.size());
+    topologyQueue.forEach([&](const TopologyElement& topology) {
+        if(deltaTopologies || sparseTopologies)
+            result.push_back(topology.encodedSize(sparseTopologies));
+        else result.push_back(topology.size());
+    });
+    return result;
+}
+
 /**
  * NOTE ON CRYPTOGRAPHY
  *
@@ -99,30 +202,59 @@ void UplinkPhase::receiveUplink(long long slotStart, unsigned char currentNode)
 #endif
     
     ctx.configureTransceiver(ctx.getTransceiverConfig());
-    if(message.recv(ctx, slotStart))
+
+    // In burst mode, capture all packets back to back, stopping at the first
+    // missed one, and process them afterwards
+    std::vector<std::pair<Packet, miosix::RecvResult>> captured;
+    if(burst)
+    {
+        long long tExpected = slotStart;
+        for(int i = 0; i < ctx.getNetworkConfig().getNumUplinkPackets(); i++)
+        {
+            captured.emplace_back();
+            auto& c = captured.back();
+            if(!ReceiveUplinkMessage::capture(ctx, tExpected, c.first, c.second))
+            {
+                captured.pop_back();
+                break;
+            }
+            tExpected += packetSpacing;
+        }
+        ctx.transceiverIdle();
+    }
+    auto receivePacket = [&](int i, long long tExpected) {
+        if(!burst) return message.recv(ctx, tExpected);
+        if(i >= static_cast<int>(captured.size())) return false;
+        return message.recv(ctx, captured[i].first, captured[i].second);
+    };
+
+    if(receivePacket(0, slotStart))
     {
-        auto numPackets = message.getNumPackets();
         TopologyElement senderTopology = message.getSenderTopology(currentNode);
         myNeighborTable.receivedMessage(message.getHop(), message.getRssi(),
                                     message.getBadAssignee(), senderTopology);
         
         if(ENABLE_UPLINK_DYN_INFO_DBG)
-            print_dbg("[U]<-N=%u @%llu %hddBm\n",currentNode,
-                    NetworkTime::fromLocalTime(slotStart).get(),message.getRssi());
+            trace_dbg(TraceEvent::UPLINK_RECEIVED, currentNode, 0, 0,
+                      NetworkTime::fromLocalTime(slotStart).get(), message.getRssi());
         if(ENABLE_TOPOLOGY_DYN_SHORT_SUMMARY)
             print_dbg("<-%d %ddBm\n",currentNode,message.getRssi());
     
         if(message.getAssignee() == myId)
         {
-            topologyQueue.enqueue(currentNode, std::move(senderTopology));
+            enqueueSenderTopology(currentNode, std::move(senderTopology));
             message.deserializeTopologiesAndSMEs(topologyQueue, smeQueue);
+            if(calibrate && !burst)
+                ctx.getSlotCalibration().add(SlotCalibration::UPLINK_PACKET,
+                                             miosix::getTime() - slotStart);
             
-            for(int i = 1; i < numPackets; i++)
+            // NOTE: with variable size topologies the number of packets is
+            // updated as packets are received
+            for(int i = 1; i < message.getNumPackets(); i++)
             {
                 // NOTE: If we fail to receive a Packet of the UplinkMessage,
                 // do not wait for remaining packets
-                // TODO verify that packetArrivalAndProcessingTime + transmissionInterval are correct
-                slotStart += packetArrivalAndProcessingTime + transmissionInterval;
+                slotStart += packetSpacing;
 
 #ifdef CRYPTO
                 if(ctx.getNetworkConfig().getAuthenticateControlMessages()) {
@@ -130,8 +262,11 @@ void UplinkPhase::receiveUplink(long long slotStart, unsigned char currentNode)
                     message.setIV(tileNumber, seqNo, masterIndex);
                 }
 #endif
-                if(message.recv(ctx, slotStart) == false) break;
+                if(receivePacket(i, slotStart) == false) break;
                 message.deserializeTopologiesAndSMEs(topologyQueue, smeQueue);
+                if(calibrate && !burst)
+                    ctx.getSlotCalibration().add(SlotCalibration::UPLINK_PACKET,
+                                                 miosix::getTime() - slotStart);
             }
         }
         
@@ -36,6 +36,9 @@
 #include "../util/updatable_queue.h"
 #include "topology/topology_element.h"
 #include "topology/neighbor_table.h"
+#include <algorithm>
+#include <map>
+#include <vector>
 
 namespace mxnet {
 
@@ -47,6 +50,23 @@ namespace mxnet {
  * send its Uplink Messages, all the other nodes will listen for incoming
  * Uplink Messages constructing their neighbor tables and forwarding them to the
  * master.
+ *
+ * With adaptive uplink the round-robin only cycles through the nodes known to
+ * the master, distributed with the schedule, and one every discoveryInterval
+ * uplink slots is a discovery slot cycling through all node IDs, so that
+ * nodes not yet known to the master, which can not know the round-robin, have
+ * a bounded wait before they can transmit.
+ *
+ * With concurrent uplink the master groups the nodes that are at least three
+ * hops apart, and all the nodes of a group send in the same slot. As no node
+ * can hear two of them, each node listens to the only sender of the group
+ * that is its neighbor, if any, and new links are only discovered in the
+ * discovery slots.
+ *
+ * With burst uplink the packets of a multi-packet uplink message are prepared
+ * in advance and sent back to back, the receiver captures the whole burst and
+ * verifies the packets only after the last one, so that the time between
+ * packets does not include their processing.
  */
 class UplinkPhase : public MACPhase
 {
@@ -60,7 +80,13 @@ public:
     static unsigned long long getDuration(const NetworkConfiguration& netConfig)
     {   
         unsigned char numUplinkPackets = netConfig.getNumUplinkPackets();
-        unsigned long long duration = (packetArrivalAndProcessingTime + transmissionInterval) * numUplinkPackets;
+        unsigned long long duration = getPacketSpacing(netConfig) * numUplinkPackets;
+        // In burst mode the received packets are processed after the burst
+        if(netConfig.getBurstUplink())
+            duration += burstPacketProcessingTime(netConfig) * numUplinkPackets;
+        // A calibrated profile already accounts for crypto
+        if(netConfig.getSlotTimingProfile().getUplinkPacketTime() > 0)
+            return duration;
 #ifdef CRYPTO
         //NOTE: assuming maxControlPktSize is equal to maxDataPktSize == 125
         //NOTE: time reported here is maximum between tx and rx side as when
@@ -76,11 +102,55 @@ public:
         return duration;
     }
 
+    /**
+     * \return the time between the packets of an uplink message
+     */
+    static long long getPacketSpacing(const NetworkConfiguration& netConfig)
+    {
+        // Back to back packets are only spaced by the time needed to wake up
+        // the radio and compensate for the receiver window
+        if(netConfig.getBurstUplink())
+            return MACContext::radioTime(MediumAccessController::maxControlPktSize)
+                 + std::max<long long>(MediumAccessController::sendingNodeWakeupAdvance,
+                                       MediumAccessController::receivingNodeWakeupAdvance
+                                       + netConfig.getMaxAdmittedRcvWindow());
+        long long packetTime = netConfig.getSlotTimingProfile().getUplinkPacketTime();
+        if(packetTime <= 0) packetTime = packetArrivalAndProcessingTime;
+        return packetTime + transmissionInterval;
+    }
+
     /**
      * Align uplink phase to the network time when (re)synchronizing
      */
     void alignToNetworkTime(NetworkTime nt);
 
+    /**
+     * Set the nodes taking part in the adaptive uplink round-robin, called
+     * when a schedule is applied
+     * \param groups the groups of nodes sharing an uplink slot, each sorted
+     * by node ID. Without concurrent uplink the nodes of each group take one
+     * slot each. If empty only the discovery slots are used
+     */
+    void setUplinkGroups(std::vector<std::vector<unsigned char>>&& groups);
+
+    /**
+     * With the SME fast path, get the SMEs to forward toward the master
+     * in the spare bytes of a data packet, including the ones of this node.
+     * Data packets are not acknowledged, so the SMEs are moved to the back
+     * of the queue instead of being removed, and are still forwarded in the
+     * next uplink slot if the data packet is lost. Delivery reports are the
+     * exception, as they are periodic and duplicates would skew them
+     * \param maxSMEs maximum number of SMEs to return
+     */
+    std::vector<StreamManagementElement> dequeueSMEs(unsigned int maxSMEs);
+
+    /**
+     * With the SME fast path, enqueue the SMEs received in a data packet,
+     * that are forwarded like the ones received in uplink messages, or
+     * consumed in the next uplink slot by the master
+     */
+    void enqueueSMEs(const std::vector<StreamManagementElement>& smes);
+
     /**
      * Called when the node clock synchronization error is too high to operate
      * but the node is not desynchronized. ITs purpose is to update the phase
@@ -91,6 +161,23 @@ public:
     //TODO: check the duration calculation, it is currently hardcoded
     static const int transmissionInterval = 1000000; //1ms
     static const int packetArrivalAndProcessingTime = 5000000;//32 us * 127 B + tp = 5ms
+    // With adaptive uplink, one uplink slot every discoveryInterval is a discovery slot
+    static const int discoveryInterval = 4;
+    // With delta topologies, a full topology is forwarded at least every
+    // topologyRefreshInterval deltas, to recover from lost ones
+    static const int topologyRefreshInterval = 8;
+
+    /**
+     * \return the time needed to verify and deserialize a received packet,
+     * that in burst mode is deferred after the end of the burst
+     */
+    static long long burstPacketProcessingTime(const NetworkConfiguration& netConfig)
+    {
+        long long packetTime = netConfig.getSlotTimingProfile().getUplinkPacketTime();
+        if(packetTime <= 0) packetTime = packetArrivalAndProcessingTime;
+        return std::max<long long>(0, packetTime
+                 - MACContext::radioTime(MediumAccessController::maxControlPktSize));
+    }
 
 protected:
     UplinkPhase(MACContext& ctx, StreamManager* const streamMgr) :
@@ -98,7 +185,17 @@ protected:
             streamMgr(streamMgr),
             myId(ctx.getNetworkId()),
             nodesCount(ctx.getNetworkConfig().getMaxNodes()),
+            packetSpacing(getPacketSpacing(ctx.getNetworkConfig())),
+            calibrate(ctx.getNetworkConfig().getCalibrateSlotTiming()),
+            adaptive(ctx.getNetworkConfig().getAdaptiveUplink()),
+            burst(ctx.getNetworkConfig().getBurstUplink()),
+            deltaTopologies(ctx.getNetworkConfig().getDeltaTopologies()),
+            sparseTopologies(ctx.getNetworkConfig().getSparseTopologies()),
+            concurrent(ctx.getNetworkConfig().getConcurrentUplink()),
             nextNode(nodesCount - 1),
+            topologyQueue(nodesCount),
+            smeQueue(nodesCount),
+            topologyVersions(deltaTopologies ? nodesCount : 0, 0),
             myNeighborTable(ctx.getNetworkConfig(),
                             ctx.getNetworkId(),
                             ctx.getHop()) {}
@@ -110,22 +207,61 @@ protected:
      */
     void receiveUplink(long long slotStart, unsigned char currentNode);
 
+    /**
+     * Enqueue the topology of a node whose uplink message was assigned to
+     * this node. With delta topologies, it is enqueued as a delta against the
+     * last full topology forwarded for the same node, if smaller
+     */
+    void enqueueSenderTopology(unsigned char node, TopologyElement&& topology);
+
+    /**
+     * \return the size of the topologies in the queue, in queue order
+     */
+    std::vector<unsigned short> getTopologySizes() const;
+
     /**
      * Called at every execute() or advance() updates the state of the
      * round-robin scheme used for uplink.
-     * \return which node id is expected to transmit in this uplink
+     * \return which node id is expected to transmit in this uplink, or
+     * nodesCount if the uplink slot is unused. With concurrent uplink, this
+     * node if it is one of the senders, otherwise the sender to listen to
      */
     unsigned char getAndUpdateCurrentNode();
+
+    /**
+     * Reset the round-robin state, when (re)synchronizing
+     */
+    void resetCurrentNode() {
+        nextNode = nodesCount - 1;
+        uplinkIndex = 0;
+        uplinkGroups.clear();
+    }
     
     StreamManager* const streamMgr; ///< Used to get SMEs
     const unsigned char myId;       ///< Cached NetworkId of this node
     const unsigned char nodesCount; ///< Cached NetworkConfiguration::getMaxNodes()
+    const long long packetSpacing;  ///< Cached getPacketSpacing()
+    const bool calibrate;           ///< Cached NetworkConfiguration::getCalibrateSlotTiming()
+    const bool adaptive;            ///< Cached NetworkConfiguration::getAdaptiveUplink()
+    const bool burst;               ///< Cached NetworkConfiguration::getBurstUplink()
+    const bool deltaTopologies;     ///< Cached NetworkConfiguration::getDeltaTopologies()
+    const bool sparseTopologies;    ///< Cached NetworkConfiguration::getSparseTopologies()
+    const bool concurrent;          ///< Cached NetworkConfiguration::getConcurrentUplink()
     
     unsigned char nextNode;         ///< Next node to talk in the round-robin
+    long long uplinkIndex = 0;      ///< Number of uplink slots since the network start
+    std::vector<std::vector<unsigned char>> uplinkGroups; ///< Nodes in the adaptive round-robin
     // Queues used in dynamic nodes to collect and forward topologies and sme
-    // and in master node to process received topologies and sme
+    // and in master node to process received topologies and sme.
+    // Sized for one element per node, so that they rarely need to grow
     UpdatableQueue<unsigned char,TopologyElement> topologyQueue;
     UpdatableQueue<SMEKey,StreamManagementElement> smeQueue;
+    // With delta topologies, last full topology forwarded for the nodes whose
+    // uplink messages were assigned to this node, and deltas sent since then
+    std::map<unsigned char, std::pair<TopologyElement, int>> topologyBases;
+    // Version of the last full topology forwarded for each node. Not cleared
+    // on resync, so that the master never confuses an old base with a new one
+    std::vector<unsigned char> topologyVersions;
     NeighborTable myNeighborTable;
 
 
@@ -26,6 +26,7 @@
  ***************************************************************************/
 
 #include "debug_settings.h"
+#include "trace.h"
 #include <cstdarg>
 #include <cstdio>
 #include <stdexcept>
@@ -52,6 +53,7 @@ namespace mxnet {
  */
 const unsigned int maxMessageSize=128;  ///< Max size of individual debug message
 const unsigned int maxQueueSize=2*1024; ///< Max size of queued logging data
+const unsigned int traceRingSize=128;   ///< Max queued trace records, power of 2
 
 class DebugPrinter
 {
@@ -59,6 +61,8 @@ public:
     static DebugPrinter& instance();
     
     void enqueue(const string& s);
+
+    void trace(const TraceRecord& r);
     
 private:
     DebugPrinter(const DebugPrinter&) = delete;
@@ -67,6 +71,8 @@ private:
     DebugPrinter() : thread(Thread::create(threadLauncher,2048,MAIN_PRIORITY,this)) {}
     
     void run();
+
+    bool popTrace(TraceRecord& r);
     
     static void threadLauncher(void *argv);
     
@@ -76,6 +82,13 @@ private:
     queue<string,list<string>> messages;
     unsigned int size=0;
     unsigned int maxSize=0;
+    /* Single producer, single consumer ring buffer of trace records.
+       ringHead is only written by the producer, ringTail by the logger */
+    TraceRecord ring[traceRingSize];
+    unsigned int ringHead=0;
+    unsigned int ringTail=0;
+    unsigned int traceDropped=0;
+    bool idle=false; ///< Logger thread waiting on cv
 };
 
 DebugPrinter& DebugPrinter::instance()
@@ -94,6 +107,34 @@ void DebugPrinter::enqueue(const string& s)
     cv.signal();
 }
 
+void DebugPrinter::trace(const TraceRecord& r)
+{
+    unsigned int head = ringHead;
+    if(head - __atomic_load_n(&ringTail, __ATOMIC_ACQUIRE) >= traceRingSize)
+    {
+        __atomic_add_fetch(&traceDropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    ring[head & (traceRingSize-1)] = r;
+    __atomic_store_n(&ringHead, head+1, __ATOMIC_SEQ_CST);
+    // The mutex is only taken to wake the logger thread when idle, that is
+    // once per burst of records
+    if(__atomic_load_n(&idle, __ATOMIC_SEQ_CST))
+    {
+        Lock<FastMutex> l(mutex);
+        cv.signal();
+    }
+}
+
+bool DebugPrinter::popTrace(TraceRecord& r)
+{
+    unsigned int tail = ringTail;
+    if(tail == __atomic_load_n(&ringHead, __ATOMIC_SEQ_CST)) return false;
+    r = ring[tail & (traceRingSize-1)];
+    __atomic_store_n(&ringTail, tail+1, __ATOMIC_RELEASE);
+    return true;
+}
+
 void DebugPrinter::run()
 {
     if (ENABLE_STACK_STATS_DBG) {
@@ -105,14 +146,36 @@ void DebugPrinter::run()
     for(;;)
     {
         string s;
+        TraceRecord r;
+        bool traced = false;
         {
             Lock<FastMutex> l(mutex);
-            while(messages.empty()) cv.wait(l);
-            s=messages.front();
-            messages.pop();
-            size -= s.size();
+            for(;;)
+            {
+                // Set idle before checking the ring buffer, so that a
+                // record added in the meantime signals the cv
+                __atomic_store_n(&idle, true, __ATOMIC_SEQ_CST);
+                if(popTrace(r)) { traced = true; break; }
+                if(!messages.empty()) break;
+                cv.wait(l);
+            }
+            __atomic_store_n(&idle, false, __ATOMIC_RELAXED);
+            if(!traced)
+            {
+                s=messages.front();
+                messages.pop();
+                size -= s.size();
+            }
         }
-        printf("%s",s.c_str());
+        if(traced)
+        {
+            // Raw record, decoded offline by experiments/scripts/tracedecode.pl
+            // The time is signed, as network time is negative before sync
+            printf("[B] %x %x %x %x %lld %d\n", static_cast<unsigned int>(r.event),
+                   r.node, r.src, r.dst, r.time, r.extra);
+        } else printf("%s",s.c_str());
+        if(unsigned int dropped = __atomic_exchange_n(&traceDropped, 0, __ATOMIC_RELAXED))
+            printf("[L] %u trace records dropped\n", dropped);
         if(++logCounter >= logMaxSize)
         {
             logCounter = 0;
@@ -141,6 +204,12 @@ void print_dbg(const char *fmt, ...)
     DebugPrinter::instance().enqueue(str);
 }
 
+void trace_dbg(TraceEvent event, unsigned char node, unsigned char src,
+               unsigned char dst, long long time, short extra)
+{
+    DebugPrinter::instance().trace({ time, extra, event, node, src, dst });
+}
+
 #else //DEBUG_MESSAGES_IN_SEPARATE_THREAD
 
 void print_dbg(const char *fmt, ...)
@@ -132,6 +132,10 @@ const bool ENABLE_CRYPTO_DOWNLINK_DBG = false;
 //NOTE: this is too verbose. Use only to debug nonces.
 const bool ENABLE_CRYPTO_UPLINK_DBG = false;
 
+//collects per slot timing statistics and slot overruns, printed once per
+//clock sync period and queryable through MACContext::getSlotTiming()
+const bool ENABLE_SLOT_TIMING_DBG = false;
+
 // prints threads stack size and usage
 const bool ENABLE_STACK_STATS_DBG = true;
 
@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <utility>
+
+namespace mxnet {
+
+/**
+ * Single producer single consumer handoff of the latest element only.
+ * A triple buffer: put() never waits for the consumer and replaces the
+ * element not yet taken, if any, while take() never waits for the producer.
+ * Both operations are O(1), wait free and never allocate memory.
+ * \param T type of the elements, must be default constructible
+ */
+template<typename T>
+class LatestSlot {
+public:
+    LatestSlot() : middle(1) {}
+
+    LatestSlot(const LatestSlot&) = delete;
+    LatestSlot& operator=(const LatestSlot&) = delete;
+
+    /**
+     * Called by the producer thread
+     * \param item element to be moved in the slot
+     * \return true if an element not yet taken was replaced
+     */
+    bool put(T&& item) {
+        items[back] = std::move(item);
+        unsigned char prev = middle.exchange(back | fresh, std::memory_order_acq_rel);
+        back = prev & ~fresh;
+        // The replaced element is released here, by the producer
+        items[back] = T();
+        return (prev & fresh) != 0;
+    }
+
+    /**
+     * Called by the consumer thread
+     * \param item the latest element is moved here
+     * \return false if no element was put since the last take()
+     */
+    bool take(T& item) {
+        if(empty()) return false;
+        unsigned char prev = middle.exchange(front, std::memory_order_acq_rel);
+        front = prev & ~fresh;
+        item = std::move(items[front]);
+        items[front] = T();
+        return true;
+    }
+
+    /**
+     * Can be called by both threads
+     * \return true if there is no element to take
+     */
+    bool empty() const {
+        return (middle.load(std::memory_order_acquire) & fresh) == 0;
+    }
+
+private:
+    static const unsigned char fresh = 4;
+
+    std::array<T, 3> items;
+    unsigned char back = 0;             ///< Used only by the producer
+    unsigned char front = 2;            ///< Used only by the consumer
+    std::atomic<unsigned char> middle;  ///< Index exchanged, plus fresh flag
+};
+
+} // namespace mxnet
@@ -75,7 +75,7 @@ void Packet::send(MACContext& ctx, long long sendTime) const {
 #endif
 }
 
-void Packet::waitUntilSendTime(MACContext& ctx, long long sendTime, long long additionalAdvance) const {
+void Packet::waitUntilSendTime(MACContext& ctx, long long sendTime, long long additionalAdvance) {
     auto wuTime = ctx.getTimesync()->getSenderWakeup(sendTime) - additionalAdvance;
     auto now = getTime();
     if (now < wuTime)
@@ -92,7 +92,7 @@ void Packet::sendWithoutWaiting(MACContext& ctx, long long sendTime) const {
 #endif
 }
 
-RecvResult Packet::recv(MACContext& ctx, long long tExpected, function<bool (const Packet& p, RecvResult r)> pred, Transceiver::Correct corr) {
+RecvResult Packet::recv(MACContext& ctx, long long tExpected, function<bool (const Packet& p, RecvResult r)> pred, Transceiver::Correct corr, bool keepCorrupted) {
     RecvResult result;
     long long timeout = infiniteTimeout;
     if(tExpected != infiniteTimeout) {
@@ -128,6 +128,8 @@ RecvResult Packet::recv(MACContext& ctx, long long tExpected, function<bool (con
         dataSize = result.size;
         if(result.error == RecvResult::ErrorCode::OK && pred(*this, result))
             break;
+        if(keepCorrupted && result.error == RecvResult::ErrorCode::CRC_FAIL)
+            break;
     }
     return result;
 }
@@ -140,24 +142,24 @@ bool Packet::operator==(const Packet& rhs) {
     return true;
 }
 
-void Packet::putPanHeader(unsigned short panId) {
+void Packet::putPanHeader(unsigned short panId, unsigned char seqNo) {
     unsigned char panHeader[] = {
                                  0x46, //frame type 0b110 (reserved), intra pan
                                  0x08, //no source addressing, short destination addressing
-                                 0xff, //seq no is reused as packet type (0xff=uplink), or glossy hop count
+                                 seqNo, //seq no is reused as packet type (0xff=uplink), glossy hop count or stream tag
                                  static_cast<unsigned char>(panId>>8),
                                  static_cast<unsigned char>(panId & 0xff), //destination pan ID
     };
     put(&panHeader, sizeof(panHeader));
 }
 
-bool Packet::checkPanHeader(unsigned short panId) {
+bool Packet::checkPanHeader(unsigned short panId, unsigned char seqNo) {
     if(packet.size() < 5)
         return false;
     // Check panHeader inside packet without extracting it
     if(packet.at(0) == 0x46 &&
        packet.at(1) == 0x08 &&
-       packet.at(2) == 0xff &&
+       packet.at(2) == seqNo &&
        packet.at(3) == static_cast<unsigned char>(panId >> 8) &&
        packet.at(4) == static_cast<unsigned char>(panId & 0xff)) {
         return true;
@@ -166,4 +168,16 @@ bool Packet::checkPanHeader(unsigned short panId) {
     }
 }
 
+void Packet::setPanHeaderTrailerFlag(bool flag) {
+    if(dataSize < panHeaderSize)
+        throw range_error("Packet::setPanHeaderTrailerFlag: no panHeader");
+    // Bit 8 of the frame control field, reserved in IEEE 802.15.4-2006
+    if(flag) packet[1] |= 0x01;
+    else packet[1] &= ~0x01;
+}
+
+bool Packet::hasPanHeaderTrailerFlag() const {
+    return dataSize >= panHeaderSize && (packet[1] & 0x01);
+}
+
 } /* namespace mxnet */
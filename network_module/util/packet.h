@@ -81,8 +81,36 @@ public:
 
     void get(void* data, unsigned int size);
 
+    /**
+     * \return a pointer to the free space of the packet, where up to
+     * available() bytes can be written in place of calling put()
+     */
+    unsigned char* writableData() { return packet.data() + dataSize; }
+
+    /**
+     * Add to the packet size bytes written through writableData()
+     */
+    void commit(unsigned int size) {
+        if(size > available())
+            throw PacketOverflowException("Packet::commit: Overflow!");
+        dataSize += size;
+    }
+
+    /**
+     * \return a pointer to the size() bytes available for get(), that can
+     * be accessed in place of calling get()
+     */
+    unsigned char* data() { return packet.data() + dataStart; }
+    const unsigned char* data() const { return packet.data() + dataStart; }
+
     void reserveTag() { reservedSize += tagSize; }
 
+    /**
+     * \return true if space for the tag has been reserved but the tag has
+     * not yet been computed, i.e the packet is still in plaintext
+     */
+    bool hasReservedTag() const { return reservedSize >= tagSize; }
+
     /** 
      * When reading a packet, ignore "size" bytes
      */
@@ -140,7 +168,7 @@ public:
      * @param sendTime time instant to wait for
      * @param additionalAdvance advance time w.r.t. sendTime at which returning
      */
-    void waitUntilSendTime(MACContext& ctx, long long sendTime, long long additionalAdvance = 0) const;
+    static void waitUntilSendTime(MACContext& ctx, long long sendTime, long long additionalAdvance = 0);
 
     /**
      * Send without waiting for the transceiver wakeup time.
@@ -160,7 +188,18 @@ public:
      */
     miosix::RecvResult recv(MACContext& ctx, long long tExpected,
                             std::function<bool (const Packet& p, miosix::RecvResult r)> pred,
-                            miosix::Transceiver::Correct = miosix::Transceiver::Correct::CORR);
+                            miosix::Transceiver::Correct = miosix::Transceiver::Correct::CORR,
+                            bool keepCorrupted = false);
+
+    /*
+     * Like recv(), but a packet that failed the CRC check is kept instead
+     * of being discarded, and is returned with error set to CRC_FAIL
+     */
+    miosix::RecvResult recvKeepCorrupted(MACContext& ctx, long long tExpected) {
+        std::function<bool (const Packet& p, miosix::RecvResult r)> f;
+        f = [](const Packet&, miosix::RecvResult){ return true; };
+        return recv(ctx, tExpected, f, miosix::Transceiver::Correct::CORR, true);
+    }
 
     void encryptAndPutTag(AesOcb& ocb) {
         if(reservedSize < tagSize)
@@ -250,14 +289,30 @@ public:
      * This method Adds to the packet an IEEE 802.15.4 header, containing
      * a given panId, this is useful to distinguish TDMH packets from
      * generic ZigBee or other IEEE 802.15.4 packets
+     * \param seqNo value of the 802.15.4 sequence number field, used by
+     * data packets with compact header to carry the stream tag
      */
-    void putPanHeader(unsigned short panId);
+    void putPanHeader(unsigned short panId, unsigned char seqNo = 0xff);
 
     /**
      * Checks the IEEE 802.15.4 header of the current packet,
+     * \param seqNo expected value of the 802.15.4 sequence number field
      * @return true if current packet is an UplinkPacket, false otherwise
      */
-    bool checkPanHeader(unsigned short panId);
+    bool checkPanHeader(unsigned short panId, unsigned char seqNo = 0xff);
+
+    /**
+     * Sets or clears a reserved bit of the frame control field of the
+     * IEEE 802.15.4 header, used to flag a trailer appended to the packet.
+     * checkPanHeader() fails while the flag is set
+     */
+    void setPanHeaderTrailerFlag(bool flag);
+
+    /**
+     * \return true if the IEEE 802.15.4 header of the current packet flags
+     * a trailer appended to the packet
+     */
+    bool hasPanHeaderTrailerFlag() const;
 
     /**
      * Removes the IEEE 802.15.4 header from the current packet,
@@ -0,0 +1,51 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "packet_combining.h"
+
+namespace mxnet {
+
+bool combineMajority(Packet& result, const Packet& a, const Packet& b, const Packet& c) {
+    if(a.size() != b.size() || b.size() != c.size())
+        return false;
+    const unsigned char *pa = a.data(), *pb = b.data(), *pc = c.data();
+    unsigned char *out = result.writableData();
+    unsigned int size = a.size();
+    for(unsigned int i = 0; i < size; i++)
+        out[i] = (pa[i] & pb[i]) | (pa[i] & pc[i]) | (pb[i] & pc[i]);
+    result.commit(size);
+    return true;
+}
+
+unsigned int strongestCopy(const short *rssi, unsigned int count) {
+    unsigned int best = 0;
+    for(unsigned int i = 1; i < count; i++)
+        if(rssi[i] > rssi[best]) best = i;
+    return best;
+}
+
+} // namespace mxnet
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "packet.h"
+
+namespace mxnet {
+
+/**
+ * Bitwise majority of three copies of a packet that failed the CRC check.
+ * Bit errors are unlikely to hit the same bit in two copies, so the result
+ * is often the packet that was sent. It must be verified by the caller
+ * \param result packet where the combined copy is written, must be empty
+ * \return false, leaving result untouched, if the copies differ in size
+ */
+bool combineMajority(Packet& result, const Packet& a, const Packet& b, const Packet& c);
+
+/**
+ * \param rssi RSSI of each of count copies of a packet
+ * \return the index of the copy received with the highest RSSI, the first
+ * one if more copies have the same RSSI
+ */
+unsigned int strongestCopy(const short *rssi, unsigned int count);
+
+} // namespace mxnet
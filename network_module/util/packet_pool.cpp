@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "packet_pool.h"
+#include <algorithm>
+
+namespace mxnet {
+
+void PooledPacket::reset() {
+    if(slot == nullptr) return;
+#ifdef _MIOSIX
+    bool last = miosix::atomicAddExchange(&slot->refcount, -1) == 1;
+#else
+    bool last = __atomic_sub_fetch(&slot->refcount, 1, __ATOMIC_ACQ_REL) == 0;
+#endif
+    if(last) slot->pool->release(slot);
+    slot = nullptr;
+}
+
+bool PooledPacket::unique() const {
+    if(slot == nullptr) return false;
+#ifdef _MIOSIX
+    return miosix::atomicAddExchange(&slot->refcount, 0) == 1;
+#else
+    return __atomic_load_n(&slot->refcount, __ATOMIC_ACQUIRE) == 1;
+#endif
+}
+
+PacketPool::PacketPool(unsigned int size) : slots(size) {
+    for(auto& s : slots) {
+        s.pool = this;
+        s.nextFree = freeList;
+        freeList = &s;
+    }
+    freeCount = size;
+}
+
+PooledPacket PacketPool::allocate(PoolClass cls) {
+    PacketPoolSlot *slot;
+    const unsigned int c = static_cast<unsigned int>(cls);
+    {
+#ifdef _MIOSIX
+        miosix::Lock<miosix::FastMutex> lck(pool_mutex);
+#else
+        std::unique_lock<std::mutex> lck(pool_mutex);
+#endif
+        if(freeList == nullptr || used[c] >= reserved[c]) return PooledPacket();
+        slot = freeList;
+        freeList = slot->nextFree;
+        freeCount--;
+        used[c]++;
+    }
+    slot->cls = cls;
+    slot->packet.clear();
+    return PooledPacket(slot);
+}
+
+bool PacketPool::reserve(unsigned int count, PoolClass cls) {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(pool_mutex);
+#else
+    std::unique_lock<std::mutex> lck(pool_mutex);
+#endif
+    if(reserved[0] + reserved[1] + count > slots.size()) return false;
+    reserved[static_cast<unsigned int>(cls)] += count;
+    return true;
+}
+
+void PacketPool::unreserve(unsigned int count, PoolClass cls) {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(pool_mutex);
+#else
+    std::unique_lock<std::mutex> lck(pool_mutex);
+#endif
+    unsigned int& r = reserved[static_cast<unsigned int>(cls)];
+    r -= std::min(count, r);
+}
+
+void PacketPool::release(PacketPoolSlot *slot) {
+#ifdef _MIOSIX
+    miosix::Lock<miosix::FastMutex> lck(pool_mutex);
+#else
+    std::unique_lock<std::mutex> lck(pool_mutex);
+#endif
+    slot->nextFree = freeList;
+    freeList = slot;
+    freeCount++;
+    used[static_cast<unsigned int>(slot->cls)]--;
+}
+
+} // namespace mxnet
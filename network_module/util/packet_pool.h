@@ -0,0 +1,204 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "packet.h"
+#include <vector>
+// For thread synchronization
+#ifdef _MIOSIX
+#include <miosix.h>
+#include <interfaces/atomic_ops.h>
+#else
+#include <mutex>
+#endif
+
+namespace mxnet {
+
+class PacketPool;
+
+/**
+ * Users of a PacketPool. Each class can only allocate the packets reserved
+ * for it, so that the buffers used by the MAC to relay the streams of other
+ * nodes and the queues of the streams of this node can't starve each other
+ */
+enum class PoolClass : unsigned char {
+    STREAM = 0, ///< Buffers of the streams of this node
+    RELAY = 1   ///< Buffers of the streams forwarded by this node
+};
+
+/**
+ * A Packet owned by a PacketPool, together with the reference count of the
+ * PooledPacket handles pointing to it
+ */
+struct PacketPoolSlot {
+    Packet packet;
+    int refcount = 0;
+    PoolClass cls = PoolClass::STREAM;
+    PacketPool *pool = nullptr;
+    PacketPoolSlot *nextFree = nullptr;
+};
+
+/**
+ * Reference counted handle to a Packet allocated from a PacketPool.
+ * Copying a handle does not copy the packet, so the same buffer can be
+ * shared between the application thread, the stream and the DataPhase.
+ * The packet is returned to the pool when the last handle is destroyed.
+ * A default constructed handle is empty and does not point to any packet.
+ */
+class PooledPacket {
+public:
+    PooledPacket() : slot(nullptr) {}
+
+    PooledPacket(const PooledPacket& other) : slot(other.slot) {
+        if(slot) addRef(slot);
+    }
+
+    PooledPacket(PooledPacket&& other) : slot(other.slot) {
+        other.slot = nullptr;
+    }
+
+    PooledPacket& operator=(PooledPacket other) {
+        swap(other);
+        return *this;
+    }
+
+    ~PooledPacket() { reset(); }
+
+    /**
+     * Release the packet, leaving the handle empty
+     */
+    void reset();
+
+    void swap(PooledPacket& other) {
+        std::swap(slot, other.slot);
+    }
+
+    /**
+     * \return true if this is the only handle pointing to the packet
+     */
+    bool unique() const;
+
+    Packet& operator*() const { return slot->packet; }
+
+    Packet* operator->() const { return &slot->packet; }
+
+    Packet* get() const { return slot ? &slot->packet : nullptr; }
+
+    explicit operator bool() const { return slot != nullptr; }
+
+private:
+    friend class PacketPool;
+
+    explicit PooledPacket(PacketPoolSlot *slot) : slot(slot) { addRef(slot); }
+
+    static void addRef(PacketPoolSlot *s) {
+#ifdef _MIOSIX
+        miosix::atomicAdd(&s->refcount, 1);
+#else
+        __atomic_add_fetch(&s->refcount, 1, __ATOMIC_ACQ_REL);
+#endif
+    }
+
+    PacketPoolSlot *slot;
+};
+
+/**
+ * Fixed size pool of Packet buffers, allocated once at construction time.
+ * Allocating and releasing packets never touches the heap, so it can be done
+ * by the MAC thread during the data phase. Packets can be released from any
+ * thread.
+ * Users reserve their worst case share of the pool beforehand, so that a
+ * request the pool cannot cover is rejected instead of silently dropping
+ * packets later. Packets are only allocated against the reservations of
+ * their PoolClass.
+ */
+class PacketPool {
+public:
+    /**
+     * \param size number of packets in the pool
+     */
+    explicit PacketPool(unsigned int size);
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    /**
+     * \param cls class of the user allocating the packet
+     * \return a handle to a cleared packet, or an empty handle if all the
+     * packets reserved for cls are in use
+     */
+    PooledPacket allocate(PoolClass cls = PoolClass::STREAM);
+
+    /**
+     * \return the number of packets in the pool
+     */
+    unsigned int size() const { return slots.size(); }
+
+    /**
+     * \return the number of packets that can still be allocated
+     */
+    unsigned int available() const { return freeCount; }
+
+    /**
+     * Reserve count packets of the pool for a class of users
+     * \return false, reserving nothing, if the packets not yet reserved are
+     * less than count
+     */
+    bool reserve(unsigned int count, PoolClass cls = PoolClass::STREAM);
+
+    /**
+     * Return count packets previously reserved with reserve()
+     */
+    void unreserve(unsigned int count, PoolClass cls = PoolClass::STREAM);
+
+    /**
+     * \return the number of packets not yet reserved
+     */
+    unsigned int unreserved() const {
+        return slots.size() - reserved[0] - reserved[1];
+    }
+
+private:
+    friend class PooledPacket;
+
+    void release(PacketPoolSlot *slot);
+
+    std::vector<PacketPoolSlot> slots;
+    PacketPoolSlot *freeList = nullptr;
+    unsigned int freeCount = 0;
+    // Packets reserved and allocated by each PoolClass
+    unsigned int reserved[2] = {0, 0};
+    unsigned int used[2] = {0, 0};
+#ifdef _MIOSIX
+    miosix::FastMutex pool_mutex;
+#else
+    std::mutex pool_mutex;
+#endif
+};
+
+} // namespace mxnet
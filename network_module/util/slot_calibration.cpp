@@ -0,0 +1,94 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "slot_calibration.h"
+#include "debug_settings.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mxnet {
+
+// Data slot processing is below 1.3ms, uplink packets below 6.4ms
+const long long SlotCalibration::bucketWidth[NUM_PHASES] = { 10000, 10000, 50000 };
+
+static const char *phaseName[SlotCalibration::NUM_PHASES] = {
+    "data prepare", "data process", "uplink packet"
+};
+
+void SlotCalibration::add(Phase phase, long long ns) {
+    if(ns < 0) ns = 0;
+    unsigned int bucket = ns / bucketWidth[phase];
+    if(bucket >= numBuckets) bucket = numBuckets - 1;
+    histogram[phase][bucket]++;
+    n[phase]++;
+    if(ns > maxValue[phase]) maxValue[phase] = ns;
+}
+
+void SlotCalibration::reset() {
+    memset(histogram, 0, sizeof(histogram));
+    memset(n, 0, sizeof(n));
+    memset(maxValue, 0, sizeof(maxValue));
+}
+
+long long SlotCalibration::percentile(Phase phase, unsigned int permille) const {
+    if(n[phase] == 0) return 0;
+    // Number of samples that must be below the returned value, rounded up
+    unsigned long long needed = (static_cast<unsigned long long>(n[phase]) * permille + 999) / 1000;
+    unsigned long long seen = 0;
+    for(unsigned int i = 0; i < numBuckets - 1; i++) {
+        seen += histogram[phase][i];
+        if(seen >= needed) return std::min((i + 1) * bucketWidth[phase], maxValue[phase]);
+    }
+    return maxValue[phase];
+}
+
+SlotTimingProfile SlotCalibration::getProfile(unsigned int permille,
+                                              unsigned int marginPercent) const {
+    long long data = 0, uplink = 0;
+    // The preparation of a data slot overlaps the previous slot, so both
+    // must fit in the processing time
+    if(n[DATA_PROCESS] > 0)
+        data = percentile(DATA_PREPARE, permille) + percentile(DATA_PROCESS, permille);
+    if(n[UPLINK_PACKET] > 0)
+        uplink = percentile(UPLINK_PACKET, permille);
+    data += data * marginPercent / 100;
+    uplink += uplink * marginPercent / 100;
+    return SlotTimingProfile(data, uplink);
+}
+
+void SlotCalibration::print() const {
+    for(int i = 0; i < NUM_PHASES; i++) {
+        Phase p = static_cast<Phase>(i);
+        print_dbg("[C] %s: n=%u p50=%lld p99=%lld max=%lld\n", phaseName[i],
+                  n[p], percentile(p, 500), percentile(p, 990), max(p));
+    }
+    auto profile = getProfile(defaultPermille, defaultMarginPercent);
+    print_dbg("[C] SlotTimingProfile(%lld, %lld)\n", profile.getDataProcessingTime(),
+              profile.getUplinkPacketTime());
+}
+
+} // namespace mxnet
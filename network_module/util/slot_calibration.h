@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "../network_configuration.h"
+
+namespace mxnet {
+
+/**
+ * Measures the processing time actually spent by the MAC phases on the
+ * running build, to compute a SlotTimingProfile that replaces the built-in
+ * pessimistic estimates used to size the slots.
+ * Samples are accumulated in fixed size histograms, so percentiles can be
+ * computed without storing the samples. Only accessed by the MAC thread.
+ */
+class SlotCalibration {
+public:
+    enum Phase : unsigned char {
+        DATA_PREPARE,  // Data slot processing before the radio activity
+        DATA_PROCESS,  // Data slot processing after the radio activity
+        UPLINK_PACKET, // Reception and processing of an uplink packet
+        NUM_PHASES
+    };
+
+    SlotCalibration() { reset(); }
+
+    /**
+     * Add a sample
+     * \param phase phase the sample refers to
+     * \param ns measured time in nanoseconds, negative values count as zero
+     */
+    void add(Phase phase, long long ns);
+
+    /**
+     * Discard all the samples
+     */
+    void reset();
+
+    /**
+     * \return the number of samples of a phase
+     */
+    unsigned int count(Phase phase) const { return n[phase]; }
+
+    /**
+     * \return the largest sample of a phase
+     */
+    long long max(Phase phase) const { return maxValue[phase]; }
+
+    /**
+     * \param permille percentile to compute, from 0 to 1000
+     * \return an upper bound of the requested percentile of a phase,
+     * with the resolution of the histogram
+     */
+    long long percentile(Phase phase, unsigned int permille) const;
+
+    /**
+     * \param permille percentile of the samples to cover, from 0 to 1000.
+     * 1000 covers the worst case measured
+     * \param marginPercent margin added to the measured times
+     * \return the calibrated profile, phases without samples keep the
+     * built-in estimate
+     */
+    SlotTimingProfile getProfile(unsigned int permille, unsigned int marginPercent) const;
+
+    /**
+     * Print the statistics and the calibrated profile
+     */
+    void print() const;
+
+    /* Default percentile and margin of the printed profile. The profile
+       sizes every slot, so it covers the worst case measured: even the
+       99.9th percentile would let about one slot in a thousand overrun */
+    static const unsigned int defaultPermille = 1000;
+    static const unsigned int defaultMarginPercent = 20;
+
+private:
+    static const unsigned int numBuckets = 128;
+    /* Width of the histogram buckets of each phase, samples larger than
+       the histogram range are accounted in the last bucket */
+    static const long long bucketWidth[NUM_PHASES];
+
+    unsigned int histogram[NUM_PHASES][numBuckets];
+    unsigned int n[NUM_PHASES];
+    long long maxValue[NUM_PHASES];
+};
+
+} // namespace mxnet
@@ -0,0 +1,123 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "slot_timing.h"
+#include "debug_settings.h"
+#include <cstring>
+
+namespace mxnet {
+
+static const char *phaseName[SlotTiming::NUM_PHASES] = {
+    "data", "uplink", "schedule downlink", "timesync downlink"
+};
+
+SlotTiming::SlotTiming() : current(DATA), currentStart(0), lastRadio(-1),
+                           publishSeq(0) {
+    reset();
+    memset(published, 0, sizeof(published));
+}
+
+void SlotTiming::end(long long slotDuration, long long now) {
+    long long offset = now - currentStart;
+    exit[current].add(offset);
+    if(lastRadio >= 0) radio[current].add(lastRadio - currentStart);
+    if(offset > slotDuration) overruns[current]++;
+    unsigned int bucket = 0;
+    if(offset > 0 && slotDuration > 0)
+        bucket = offset * bucketsPerSlot / slotDuration;
+    if(bucket >= numBuckets) bucket = numBuckets - 1;
+    histogram[current][bucket]++;
+    duration[current] = slotDuration;
+}
+
+void SlotTiming::publish() {
+    Result results[NUM_PHASES];
+    for(int i = 0; i < NUM_PHASES; i++) {
+        results[i].entry = entry[i].getStats();
+        results[i].radio = radio[i].getStats();
+        results[i].exit = exit[i].getStats();
+        results[i].overruns = overruns[i];
+        // Upper bound of the bucket holding the 99th percentile, clamped
+        // to the maximum actually measured
+        results[i].exitP99 = results[i].exit.max;
+        unsigned long long needed = (static_cast<unsigned long long>(results[i].exit.n) * 99 + 99) / 100;
+        unsigned long long seen = 0;
+        for(unsigned int j = 0; j < numBuckets - 1; j++) {
+            seen += histogram[i][j];
+            if(seen >= needed) {
+                long long bound = (j + 1) * duration[i] / bucketsPerSlot;
+                if(bound < results[i].exitP99) results[i].exitP99 = bound;
+                break;
+            }
+        }
+    }
+    // Only the MAC thread writes, so the sequence can be read relaxed.
+    // It is odd while the snapshot is being written, and the fence keeps
+    // the writes to the snapshot from becoming visible before it
+    unsigned int seq = publishSeq.load(std::memory_order_relaxed);
+    publishSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(published, results, sizeof(results));
+    publishSeq.store(seq + 2, std::memory_order_release);
+    reset();
+}
+
+SlotTiming::Result SlotTiming::getResult(Phase phase) const {
+    for(;;) {
+        unsigned int seq = publishSeq.load(std::memory_order_acquire);
+        if(seq & 1) continue; // MAC thread is publishing
+        Result result = published[phase];
+        // Any publish that overlapped the copy has changed the sequence
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(publishSeq.load(std::memory_order_relaxed) == seq)
+            return result;
+    }
+}
+
+void SlotTiming::print() const {
+    for(int i = 0; i < NUM_PHASES; i++) {
+        Result r = getResult(static_cast<Phase>(i));
+        if(r.exit.n == 0) continue;
+        print_dbg("[ST] %s: n=%u entry=%lld/%lld radio=%lld/%lld exit=%lld/%lld/%lld p99=%lld overruns=%u\n",
+                  phaseName[i], r.exit.n, r.entry.min, r.entry.mean,
+                  r.radio.mean, r.radio.max, r.exit.min, r.exit.mean,
+                  r.exit.max, r.exitP99, r.overruns);
+    }
+}
+
+void SlotTiming::reset() {
+    for(int i = 0; i < NUM_PHASES; i++) {
+        entry[i].resetStats();
+        radio[i].resetStats();
+        exit[i].resetStats();
+    }
+    memset(histogram, 0, sizeof(histogram));
+    memset(duration, 0, sizeof(duration));
+    memset(overruns, 0, sizeof(overruns));
+}
+
+} // namespace mxnet
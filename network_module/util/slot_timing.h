@@ -0,0 +1,137 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "stats.h"
+#include <atomic>
+
+namespace mxnet {
+
+/**
+ * Per-slot timing instrumentation of the MAC phases.
+ * For each phase records how early the phase was entered with respect to
+ * the slot start, when the last radio operation completed and when the
+ * phase returned, counting as overruns the slots that returned after the
+ * end of the slot.
+ * Samples are accumulated by the MAC thread without locking, and published
+ * periodically as a snapshot that can be queried from any thread. Publishing
+ * is lock-free too, so the MAC thread never waits for a reader.
+ */
+class SlotTiming {
+public:
+    enum Phase : unsigned char {
+        DATA,              // A data slot
+        UPLINK,            // The uplink slot
+        SCHEDULE_DOWNLINK, // The schedule distribution downlink slot
+        TIMESYNC_DOWNLINK, // The timesync downlink slot
+        NUM_PHASES
+    };
+
+    /**
+     * Statistics of a phase, all times are in nanoseconds
+     */
+    struct Result {
+        StatsResult entry;   // Time from phase entry to slot start, negative if late
+        StatsResult radio;   // Time from slot start to the end of the last radio operation
+        StatsResult exit;    // Time from slot start to phase return
+        long long exitP99;   // Upper bound of the 99th percentile of exit
+        unsigned int overruns; // Slots where the phase returned past the slot end
+    };
+
+    SlotTiming();
+
+    /**
+     * Called by the MAC thread before running a phase
+     * \param phase phase that is going to run
+     * \param slotStart start of the slot
+     * \param now current time
+     */
+    void begin(Phase phase, long long slotStart, long long now) {
+        current = phase;
+        currentStart = slotStart;
+        lastRadio = -1;
+        entry[phase].add(slotStart - now);
+    }
+
+    /**
+     * Called by the MAC thread at the end of every radio operation
+     * \param now current time
+     */
+    void radioActivity(long long now) { lastRadio = now; }
+
+    /**
+     * Called by the MAC thread after a phase returned
+     * \param slotDuration duration of the slot the phase ran in
+     * \param now current time
+     */
+    void end(long long slotDuration, long long now);
+
+    /**
+     * Called by the MAC thread to make the statistics accumulated so far
+     * available to getResult(), and start accumulating from scratch
+     */
+    void publish();
+
+    /**
+     * Can be called from any thread
+     * \return the statistics of a phase as of the last call to publish()
+     */
+    Result getResult(Phase phase) const;
+
+    /**
+     * Print the statistics as of the last call to publish()
+     */
+    void print() const;
+
+private:
+    void reset();
+
+    static const unsigned int numBuckets = 128;
+    /* Exit times are accounted in buckets of 1/64 of the slot, so the
+       histogram covers up to two slots */
+    static const unsigned int bucketsPerSlot = 64;
+
+    Phase current;
+    long long currentStart;
+    long long lastRadio;
+
+    Stats entry[NUM_PHASES];
+    Stats radio[NUM_PHASES];
+    Stats exit[NUM_PHASES];
+    unsigned int histogram[NUM_PHASES][numBuckets];
+    long long duration[NUM_PHASES];
+    unsigned int overruns[NUM_PHASES];
+
+    /* Seqlock protecting the snapshot, publishSeq is odd while the MAC
+       thread writes it. A reader retries if the sequence was odd or changed
+       while it copied the snapshot */
+    Result published[NUM_PHASES];
+    std::atomic<unsigned int> publishSeq;
+};
+
+} // namespace mxnet
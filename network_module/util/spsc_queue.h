@@ -0,0 +1,107 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <utility>
+
+namespace mxnet {
+
+/**
+ * Bounded single producer single consumer queue.
+ * One thread can push() while another thread concurrently pop()s without
+ * any lock, both operations are O(1) and never allocate memory.
+ * \param T type of the queued elements, must be default constructible
+ * \param N maximum number of queued elements
+ */
+template<typename T, unsigned int N>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * Called by the producer thread
+     * \param item element to be moved in the queue
+     * \return false if the queue is full, in this case item is left untouched
+     */
+    bool push(T&& item) {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        unsigned int next = increment(t);
+        if(next == head.load(std::memory_order_acquire)) return false;
+        items[t] = std::move(item);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Called by the consumer thread
+     * \param item the oldest element is moved here
+     * \return false if the queue is empty
+     */
+    bool pop(T& item) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) return false;
+        item = std::move(items[h]);
+        // Do not keep a moved-from element around, T may hold resources
+        items[h] = T();
+        head.store(increment(h), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Can be called by both threads, the result is exact only if the other
+     * thread is not concurrently modifying the queue
+     * \return the number of queued elements
+     */
+    unsigned int size() const {
+        unsigned int h = head.load(std::memory_order_acquire);
+        unsigned int t = tail.load(std::memory_order_acquire);
+        return t >= h ? t - h : t + N + 1 - h;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * \return the maximum number of elements in the queue
+     */
+    static constexpr unsigned int capacity() { return N; }
+
+private:
+    static unsigned int increment(unsigned int i) { return i == N ? 0 : i + 1; }
+
+    // One more element than the capacity to tell a full queue from an empty one
+    std::array<T, N + 1> items;
+    std::atomic<unsigned int> head; ///< Written only by the consumer
+    std::atomic<unsigned int> tail; ///< Written only by the producer
+};
+
+} // namespace mxnet
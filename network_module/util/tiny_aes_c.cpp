@@ -41,6 +41,9 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #include <stdint.h>
 #include <string.h> // CBC mode, for memset
 #include "tiny_aes_c.h"
+#ifdef AES_NI_DISPATCH
+#include <wmmintrin.h>
+#endif
 
 /*****************************************************************************/
 /* Defines:                                                                  */
@@ -78,17 +81,14 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 /* Private variables:                                                        */
 /*****************************************************************************/
 // state - array holding the intermediate results during decryption.
+// The state and the round keys are passed to each function, so that ECB
+// encryption and decryption are reentrant.
 typedef uint8_t state_t[4][4];
-static state_t* state;
-
-// The array that stores the round keys.
-static uint8_t RoundKey[keyExpSize];
-
-// The Key input to the AES Program
-static const uint8_t* Key;
 
 #if defined(CBC) && CBC
-  // Initial Vector used only for CBC mode
+  // Round keys and Initial Vector used only for CBC mode, that keeps them
+  // across calls and is thus not reentrant
+  static struct AES_ctx CbcCtx;
   static uint8_t* Iv;
 #endif
 
@@ -167,7 +167,7 @@ static uint8_t getSBoxInvert(uint8_t num)
 }
 
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states. 
-static void KeyExpansion(void)
+static void KeyExpansion(uint8_t* RoundKey, const uint8_t* Key)
 {
   uint32_t i, k;
   uint8_t tempa[4]; // Used for the column/row operations
@@ -240,7 +240,7 @@ static void KeyExpansion(void)
 
 // This function adds the round key to state.
 // The round key is added to the state by an XOR function.
-static void AddRoundKey(uint8_t round)
+static void AddRoundKey(uint8_t round, state_t* state, const uint8_t* RoundKey)
 {
   uint8_t i,j;
   for(i=0;i<4;++i)
@@ -254,7 +254,7 @@ static void AddRoundKey(uint8_t round)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void SubBytes(void)
+static void SubBytes(state_t* state)
 {
   uint8_t i, j;
   for(i = 0; i < 4; ++i)
@@ -269,7 +269,7 @@ static void SubBytes(void)
 // The ShiftRows() function shifts the rows in the state to the left.
 // Each row is shifted with different offset.
 // Offset = Row number. So the first row is not shifted.
-static void ShiftRows(void)
+static void ShiftRows(state_t* state)
 {
   uint8_t temp;
 
@@ -303,7 +303,7 @@ static uint8_t xtime(uint8_t x)
 }
 
 // MixColumns function mixes the columns of the state matrix
-static void MixColumns(void)
+static void MixColumns(state_t* state)
 {
   uint8_t i;
   uint8_t Tmp,Tm,t;
@@ -341,7 +341,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
 // MixColumns function mixes the columns of the state matrix.
 // The method used to multiply may be difficult to understand for the inexperienced.
 // Please use the references to gain more information.
-static void InvMixColumns(void)
+static void InvMixColumns(state_t* state)
 {
   int i;
   uint8_t a,b,c,d;
@@ -362,7 +362,7 @@ static void InvMixColumns(void)
 
 // The SubBytes Function Substitutes the values in the
 // state matrix with values in an S-box.
-static void InvSubBytes(void)
+static void InvSubBytes(state_t* state)
 {
   uint8_t i,j;
   for(i=0;i<4;++i)
@@ -374,7 +374,7 @@ static void InvSubBytes(void)
   }
 }
 
-static void InvShiftRows(void)
+static void InvShiftRows(state_t* state)
 {
   uint8_t temp;
 
@@ -404,54 +404,54 @@ static void InvShiftRows(void)
 
 
 // Cipher is the main function that encrypts the PlainText.
-static void Cipher(void)
+static void Cipher(state_t* state, const uint8_t* RoundKey)
 {
   uint8_t round = 0;
 
   // Add the First round key to the state before starting the rounds.
-  AddRoundKey(0); 
+  AddRoundKey(0, state, RoundKey); 
   
   // There will be Nr rounds.
   // The first Nr-1 rounds are identical.
   // These Nr-1 rounds are executed in the loop below.
   for(round = 1; round < Nr; ++round)
   {
-    SubBytes();
-    ShiftRows();
-    MixColumns();
-    AddRoundKey(round);
+    SubBytes(state);
+    ShiftRows(state);
+    MixColumns(state);
+    AddRoundKey(round, state, RoundKey);
   }
   
   // The last round is given below.
   // The MixColumns function is not here in the last round.
-  SubBytes();
-  ShiftRows();
-  AddRoundKey(Nr);
+  SubBytes(state);
+  ShiftRows(state);
+  AddRoundKey(Nr, state, RoundKey);
 }
 
-static void InvCipher(void)
+static void InvCipher(state_t* state, const uint8_t* RoundKey)
 {
   uint8_t round=0;
 
   // Add the First round key to the state before starting the rounds.
-  AddRoundKey(Nr); 
+  AddRoundKey(Nr, state, RoundKey); 
 
   // There will be Nr rounds.
   // The first Nr-1 rounds are identical.
   // These Nr-1 rounds are executed in the loop below.
   for(round=Nr-1;round>0;round--)
   {
-    InvShiftRows();
-    InvSubBytes();
-    AddRoundKey(round);
-    InvMixColumns();
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(round, state, RoundKey);
+    InvMixColumns(state);
   }
   
   // The last round is given below.
   // The MixColumns function is not here in the last round.
-  InvShiftRows();
-  InvSubBytes();
-  AddRoundKey(0);
+  InvShiftRows(state);
+  InvSubBytes(state);
+  AddRoundKey(0, state, RoundKey);
 }
 
 
@@ -461,30 +461,103 @@ static void InvCipher(void)
 #if defined(ECB) && ECB
 
 
-void AES_ECB_encrypt(const uint8_t* input, const uint8_t* key, uint8_t* output)
+#ifdef AES_NI_DISPATCH
+
+// The round keys computed by KeyExpansion are in the byte order AES-NI expects
+#define LoadRoundKey(rk, round) _mm_loadu_si128((const __m128i*)((rk) + (round) * BLOCKLEN))
+
+__attribute__((target("aes,sse2")))
+static void AesNiInvKeyExpansion(uint8_t* InvRoundKey, const uint8_t* RoundKey)
 {
-  // Copy input to output, and work in-memory on output
-  memcpy(output, input, BLOCKLEN);
-  state = (state_t*)output;
+  uint8_t round;
+  _mm_storeu_si128((__m128i*)InvRoundKey, LoadRoundKey(RoundKey, Nr));
+  for(round = 1; round < Nr; ++round)
+  {
+    _mm_storeu_si128((__m128i*)(InvRoundKey + round * BLOCKLEN),
+                     _mm_aesimc_si128(LoadRoundKey(RoundKey, Nr - round)));
+  }
+  _mm_storeu_si128((__m128i*)(InvRoundKey + Nr * BLOCKLEN), LoadRoundKey(RoundKey, 0));
+}
 
-  Key = key;
-  KeyExpansion();
+__attribute__((target("aes,sse2")))
+static void AesNiCipher(const uint8_t* input, uint8_t* output, const uint8_t* RoundKey)
+{
+  uint8_t round;
+  __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i*)input), LoadRoundKey(RoundKey, 0));
+  for(round = 1; round < Nr; ++round)
+  {
+    s = _mm_aesenc_si128(s, LoadRoundKey(RoundKey, round));
+  }
+  _mm_storeu_si128((__m128i*)output, _mm_aesenclast_si128(s, LoadRoundKey(RoundKey, Nr)));
+}
 
-  // The next function call encrypts the PlainText with the Key using AES algorithm.
-  Cipher();
+__attribute__((target("aes,sse2")))
+static void AesNiInvCipher(const uint8_t* input, uint8_t* output, const uint8_t* InvRoundKey)
+{
+  uint8_t round;
+  __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i*)input), LoadRoundKey(InvRoundKey, 0));
+  for(round = 1; round < Nr; ++round)
+  {
+    s = _mm_aesdec_si128(s, LoadRoundKey(InvRoundKey, round));
+  }
+  _mm_storeu_si128((__m128i*)output, _mm_aesdeclast_si128(s, LoadRoundKey(InvRoundKey, Nr)));
 }
 
-void AES_ECB_decrypt(const uint8_t* input, const uint8_t* key, uint8_t *output)
+#endif // #ifdef AES_NI_DISPATCH
+
+void AES_init_ctx(struct AES_ctx* ctx, const uint8_t* key)
 {
+  KeyExpansion(ctx->RoundKey, key);
+#ifdef AES_NI_DISPATCH
+  __builtin_cpu_init();
+  ctx->UseAesNi = __builtin_cpu_supports("aes") ? 1 : 0;
+  if(ctx->UseAesNi)
+  {
+    AesNiInvKeyExpansion(ctx->InvRoundKey, ctx->RoundKey);
+  }
+#endif
+}
+
+void AES_ECB_encrypt_ctx(const struct AES_ctx* ctx, const uint8_t* input, uint8_t* output)
+{
+#ifdef AES_NI_DISPATCH
+  if(ctx->UseAesNi)
+  {
+    AesNiCipher(input, output, ctx->RoundKey);
+    return;
+  }
+#endif
   // Copy input to output, and work in-memory on output
   memcpy(output, input, BLOCKLEN);
-  state = (state_t*)output;
+  Cipher((state_t*)output, ctx->RoundKey);
+}
 
-  // The KeyExpansion routine must be called before encryption.
-  Key = key;
-  KeyExpansion();
+void AES_ECB_decrypt_ctx(const struct AES_ctx* ctx, const uint8_t* input, uint8_t* output)
+{
+#ifdef AES_NI_DISPATCH
+  if(ctx->UseAesNi)
+  {
+    AesNiInvCipher(input, output, ctx->InvRoundKey);
+    return;
+  }
+#endif
+  // Copy input to output, and work in-memory on output
+  memcpy(output, input, BLOCKLEN);
+  InvCipher((state_t*)output, ctx->RoundKey);
+}
 
-  InvCipher();
+void AES_ECB_encrypt(const uint8_t* input, const uint8_t* key, uint8_t* output)
+{
+  struct AES_ctx ctx;
+  AES_init_ctx(&ctx, key);
+  AES_ECB_encrypt_ctx(&ctx, input, output);
+}
+
+void AES_ECB_decrypt(const uint8_t* input, const uint8_t* key, uint8_t *output)
+{
+  struct AES_ctx ctx;
+  AES_init_ctx(&ctx, key);
+  AES_ECB_decrypt_ctx(&ctx, input, output);
 }
 
 
@@ -514,8 +587,7 @@ void AES_CBC_encrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   // Skip the key expansion if key is passed as 0
   if(0 != key)
   {
-    Key = key;
-    KeyExpansion();
+    AES_init_ctx(&CbcCtx, key);
   }
 
   if(iv != 0)
@@ -527,8 +599,7 @@ void AES_CBC_encrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   {
     XorWithIv(input);
     memcpy(output, input, BLOCKLEN);
-    state = (state_t*)output;
-    Cipher();
+    Cipher((state_t*)output, CbcCtx.RoundKey);
     Iv = output;
     input += BLOCKLEN;
     output += BLOCKLEN;
@@ -538,8 +609,7 @@ void AES_CBC_encrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   if(extra)
   {
     memcpy(output, input, extra);
-    state = (state_t*)output;
-    Cipher();
+    Cipher((state_t*)output, CbcCtx.RoundKey);
   }
 }
 
@@ -551,8 +621,7 @@ void AES_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   // Skip the key expansion if key is passed as 0
   if(0 != key)
   {
-    Key = key;
-    KeyExpansion();
+    AES_init_ctx(&CbcCtx, key);
   }
 
   // If iv is passed as 0, we continue to encrypt without re-setting the Iv
@@ -564,8 +633,7 @@ void AES_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   for(i = 0; i < length; i += BLOCKLEN)
   {
     memcpy(output, input, BLOCKLEN);
-    state = (state_t*)output;
-    InvCipher();
+    InvCipher((state_t*)output, CbcCtx.RoundKey);
     XorWithIv(output);
     Iv = input;
     input += BLOCKLEN;
@@ -575,8 +643,7 @@ void AES_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, co
   if(extra)
   {
     memcpy(output, input, extra);
-    state = (state_t*)output;
-    InvCipher();
+    InvCipher((state_t*)output, CbcCtx.RoundKey);
   }
 }
 
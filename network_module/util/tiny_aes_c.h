@@ -28,8 +28,32 @@ extern "C" {
 
 #define AES128
 
+// On x86 hosts, use the AES-NI instructions when the CPU supports them
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #define AES_NI_DISPATCH 1
+#endif
+
+// Expanded round keys, so that a key can be used for many blocks while
+// computing its key schedule only once
+struct AES_ctx
+{
+  uint8_t RoundKey[176];
+#ifdef AES_NI_DISPATCH
+  // Round keys of the equivalent inverse cipher used by AES-NI
+  uint8_t InvRoundKey[176];
+  uint8_t UseAesNi;
+#endif
+};
+
+void AES_init_ctx(struct AES_ctx* ctx, const uint8_t* key);
+
 #if defined(ECB) && ECB
 
+// Reentrant, as long as each thread uses its own AES_ctx
+void AES_ECB_encrypt_ctx(const struct AES_ctx* ctx, const uint8_t* input, uint8_t* output);
+void AES_ECB_decrypt_ctx(const struct AES_ctx* ctx, const uint8_t* input, uint8_t* output);
+
+// Expand the key at every call
 void AES_ECB_encrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
 void AES_ECB_decrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
 
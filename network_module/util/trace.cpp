@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "trace.h"
+#include <cstdio>
+
+namespace mxnet {
+
+int formatTraceRecord(char *str, unsigned int size, const TraceRecord& r)
+{
+    switch(r.event)
+    {
+        case TraceEvent::DATA_SENT:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: Sent packet for stream (%d,%d) NT=%lld\n", r.node, r.src, r.dst, r.time);
+            return snprintf(str, size, "[D] s (%d,%d) NT=%lld\n", r.src, r.dst, r.time);
+        case TraceEvent::DATA_NOT_READY:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: no packet ready to send for stream (%d,%d) NT=%lld\n", r.node, r.src, r.dst, r.time);
+            return snprintf(str, size, "[D] x (%d,%d) NT=%lld\n", r.src, r.dst, r.time);
+        case TraceEvent::DATA_SKIPPED:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: Skipped copy for stream (%d,%d) NT=%lld\n", r.node, r.src, r.dst, r.time);
+            return snprintf(str, size, "[D] k (%d,%d) NT=%lld\n", r.src, r.dst, r.time);
+        case TraceEvent::DATA_RECEIVED:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: Received packet for stream (%d,%d) NT=%lld\n", r.node, r.src, r.dst, r.time);
+            return snprintf(str, size, "[D] r (%d,%d) NT=%lld\n", r.src, r.dst, r.time);
+        case TraceEvent::DATA_MISSED:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: Missed packet for stream (%d,%d) NT=%lld\n", r.node, r.src, r.dst, r.time);
+            return snprintf(str, size, "[D] m (%d,%d) NT=%lld\n", r.src, r.dst, r.time);
+        case TraceEvent::DATA_PERIOD_END:
+            if(COMPRESSED_DBG==false)
+                return snprintf(str, size, "[D] Node %d: (%d,%d) --- \n", r.node, r.src, r.dst);
+            return snprintf(str, size, "[D] - (%d,%d)\n", r.src, r.dst);
+        case TraceEvent::DATA_RECOVERED:
+            return snprintf(str, size, "[D] Node %d: Recovered packet for stream (%d,%d)\n", r.node, r.src, r.dst);
+        case TraceEvent::UPLINK_SLOT:
+            return snprintf(str, size, "[U] N=%u NT=%lld\n", r.node, r.time);
+        case TraceEvent::UPLINK_SENT:
+            return snprintf(str, size, "[U] N=%u -> @%lld\n", r.node, r.time);
+        case TraceEvent::UPLINK_RECEIVED:
+            return snprintf(str, size, "[U]<-N=%u @%lld %hddBm\n", r.node, r.time, r.extra);
+        default:
+            return snprintf(str, size, "[E] Unknown trace event %d\n", static_cast<int>(r.event));
+    }
+}
+
+} // namespace mxnet
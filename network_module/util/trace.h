@@ -0,0 +1,106 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by TDMH contributors                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "debug_settings.h"
+
+namespace mxnet {
+
+/**
+ * Binary trace events, used in place of print_dbg() for the debug messages
+ * printed on every slot. Each event stores its raw arguments in a fixed size
+ * record, that is formatted into the same text print_dbg() would produce
+ * only later, outside of the slot timing.
+ * The meaning of the arguments of trace_dbg() is listed next to each event,
+ * and must be kept in sync with the decoder in experiments/scripts.
+ * NOTE: append new events at the end, the numeric values are part of the
+ * trace format
+ */
+enum class TraceEvent : unsigned char {
+    DATA_SENT,       // node, src, dst, network time
+    DATA_NOT_READY,  // node, src, dst, network time
+    DATA_SKIPPED,    // node, src, dst, network time
+    DATA_RECEIVED,   // node, src, dst, network time
+    DATA_MISSED,     // node, src, dst, network time
+    DATA_PERIOD_END, // node, src, dst
+    DATA_RECOVERED,  // node, src, dst
+    UPLINK_SLOT,     // node owning the slot, network time
+    UPLINK_SENT,     // node, network time
+    UPLINK_RECEIVED, // sender node, network time, RSSI
+    NUM_EVENTS
+};
+
+/**
+ * A trace event with its arguments
+ */
+struct TraceRecord {
+    long long time;      // Network time of the event
+    short extra;         // Event specific value
+    TraceEvent event;
+    unsigned char node;  // Node the event refers to
+    unsigned char src;   // Stream source, if any
+    unsigned char dst;   // Stream destination, if any
+};
+
+/**
+ * Format a trace record as the text print_dbg() would have printed
+ * \param str buffer where the text is written, including the newline
+ * \param size size of the buffer
+ * \return the number of characters written, as snprintf()
+ */
+int formatTraceRecord(char *str, unsigned int size, const TraceRecord& record);
+
+#ifdef DEBUG_MESSAGES_IN_SEPARATE_THREAD
+
+/**
+ * Trace an event. The record is added to a lock-free ring buffer drained
+ * by the logger thread, that prints it as a "[B]" line to be decoded
+ * offline by experiments/scripts/tracedecode.pl.
+ * The ring buffer has a single producer, so only the MAC thread can call
+ * this function. Events are dropped if the ring buffer is full.
+ */
+void trace_dbg(TraceEvent event, unsigned char node, unsigned char src,
+               unsigned char dst, long long time, short extra = 0);
+
+#else //DEBUG_MESSAGES_IN_SEPARATE_THREAD
+
+/**
+ * Trace an event. Without a logger thread the event is printed right away
+ * as text through print_dbg()
+ */
+inline void trace_dbg(TraceEvent event, unsigned char node, unsigned char src,
+                      unsigned char dst, long long time, short extra = 0)
+{
+    char str[128];
+    formatTraceRecord(str, sizeof(str), { time, extra, event, node, src, dst });
+    print_dbg("%s", str);
+}
+
+#endif //DEBUG_MESSAGES_IN_SEPARATE_THREAD
+
+} // namespace mxnet
@@ -28,17 +28,43 @@
 
 #pragma once
 
-#include <map>
-#include <list>
+#include <memory>
+#include <utility>
 #include <functional>
 #include <stdexcept>
+#include <type_traits>
+#include <cstdint>
 
 namespace mxnet {
 
+/**
+ * Maps the keys of an UpdatableQueue to an unsigned int that uniquely
+ * identifies them. Integral keys are used directly, other keys, such as
+ * SMEKey and StreamId, through their getKey() member function, that is also
+ * what their ordering operators use
+ */
+template<typename K, typename Enable = void>
+struct UpdatableQueueKey
+{
+    static unsigned int get(const K& key) { return key.getKey(); }
+};
+
+template<typename K>
+struct UpdatableQueueKey<K, typename std::enable_if<std::is_integral<K>::value>::type>
+{
+    static unsigned int get(K key) { return static_cast<unsigned int>(key); }
+};
+
 /**
  * A queue data structure in which the elements are enqueued with a relative key,
  * and they can be updated preserving the queue ordering of the old value.
  * Elements are thus kept unique by key.
+ *
+ * Elements are stored in a pool of slots linked in FIFO order, and found by
+ * key through an open addressing table with linear probing, so that all
+ * operations are O(1). The storage only grows, doubling its capacity, when
+ * full, so once the queue reaches its steady state size no memory is
+ * allocated by the queue itself.
  * \tparam K the type of the key to which the element is associated.
  * \tparam V the type of the values stored in the queue.
  */
@@ -46,6 +72,27 @@ template<typename K, typename V>
 class UpdatableQueue
 {
 public:
+    /**
+     * \param capacity initial number of elements that can be stored before
+     * the storage is grown
+     */
+    explicit UpdatableQueue(int capacity = 8) { allocate(capacity); }
+    
+    UpdatableQueue(const UpdatableQueue& other) : UpdatableQueue(other.cap)
+    {
+        other.forEachPair([this](const K& key, const V& val) { enqueue(key, val); });
+    }
+    
+    UpdatableQueue(UpdatableQueue&& other) : UpdatableQueue(1) { swap(other); }
+    
+    UpdatableQueue& operator=(UpdatableQueue other)
+    {
+        swap(other);
+        return *this;
+    }
+    
+    ~UpdatableQueue() { clear(); }
+    
     /**
      * Adds an element to the queue, replacing a previous element with the
      * same key, if present.
@@ -75,7 +122,12 @@ public:
     /**
      * \return the oldest element in the queue, without removing it
      */
-    V& top() const;
+    V& top();
+    
+    /**
+     * \return the oldest element in the queue, without removing it
+     */
+    const V& top() const;
     
     /**
      * \return the oldest element in the queue, removing it
@@ -88,101 +140,298 @@ public:
      */
     std::pair<K,V> dequeuePair();
     
+    /**
+     * \return a pointer to the element with the given key, that can be
+     * modified in place, or nullptr if not present
+     */
+    V* find(K key)
+    {
+        int slot = lookup(UpdatableQueueKey<K>::get(key));
+        return slot < 0 ? nullptr : &slots[slot].value();
+    }
+    
+    /**
+     * Call a function on all the elements, from the oldest to the newest
+     * \param f function taking a const reference to an element
+     */
+    template<typename F>
+    void forEach(F f) const
+    {
+        for(int i = oldest; i >= 0; i = slots[i].newer) f(slots[i].value());
+    }
+    
     /**
      * Remove all elements in the queue
      */
     void clear()
     {
-        data.clear();
-        queue.clear();
+        while(oldest >= 0) release(oldest);
     }
     
     /**
      * \return true if the queue is empty
      */
-    bool empty() const { return data.empty(); }
+    bool empty() const { return count == 0; }
     
     /**
      * \return the number of elements
      */
-    std::size_t size() const { return data.size(); }
+    std::size_t size() const { return count; }
     
 private:
-    std::map<K,V> data;
-    std::list<K> queue;
+    /**
+     * A slot of the pool. Key and value are constructed in place only while
+     * the slot is in use, as they may not be default constructible
+     */
+    struct Slot
+    {
+        typename std::aligned_storage<sizeof(K), alignof(K)>::type keyStorage;
+        typename std::aligned_storage<sizeof(V), alignof(V)>::type valueStorage;
+        unsigned int hashKey; ///< UpdatableQueueKey of the key
+        int older;            ///< Previous slot in FIFO order, or -1
+        int newer;            ///< Next slot in FIFO order, or next free slot
+        
+        K& key() { return *reinterpret_cast<K*>(&keyStorage); }
+        const K& key() const { return *reinterpret_cast<const K*>(&keyStorage); }
+        V& value() { return *reinterpret_cast<V*>(&valueStorage); }
+        const V& value() const { return *reinterpret_cast<const V*>(&valueStorage); }
+    };
+    
+    template<typename F>
+    void forEachPair(F f) const
+    {
+        for(int i = oldest; i >= 0; i = slots[i].newer) f(slots[i].key(), slots[i].value());
+    }
+    
+    void swap(UpdatableQueue& other)
+    {
+        std::swap(slots, other.slots);
+        std::swap(table, other.table);
+        std::swap(cap, other.cap);
+        std::swap(tableBits, other.tableBits);
+        std::swap(count, other.count);
+        std::swap(oldest, other.oldest);
+        std::swap(newest, other.newest);
+        std::swap(freeList, other.freeList);
+    }
+    
+    /**
+     * Allocate an empty storage for at least the given number of elements
+     */
+    void allocate(int capacity);
+    
+    /**
+     * Double the capacity, moving the elements in the new storage
+     */
+    void grow();
+    
+    /**
+     * \return the position in the table where the search for a key starts
+     */
+    unsigned int home(unsigned int hashKey) const
+    {
+        // Fibonacci hashing, uses the high bits of the product as they
+        // depend on all the bits of the key
+        return static_cast<uint32_t>(hashKey * 2654435769u) >> (32 - tableBits);
+    }
+    
+    /**
+     * \return the slot containing the key, or -1
+     */
+    int lookup(unsigned int hashKey) const;
+    
+    /**
+     * Construct the key and the value in a free slot and link it as the newest
+     */
+    template<typename U>
+    void insert(const K& key, unsigned int hashKey, U&& val);
+    
+    /**
+     * Destroy the content of a slot in use and return it to the free list
+     */
+    void release(int slot);
+    
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<int[]> table; ///< Slot index for each position, or -1
+    int cap = 0;                  ///< Number of slots
+    int tableBits = 0;            ///< log2 of the table size
+    int count = 0;                ///< Number of elements
+    int oldest = -1;              ///< Head of the FIFO
+    int newest = -1;              ///< Tail of the FIFO
+    int freeList = -1;            ///< First free slot
 };
 
 template<typename K, typename V>
 void UpdatableQueue<K,V>::enqueue(K key, const V& val)
 {
-    auto it = data.find(key);
-    if(it != data.end())
-    {
-        it->second = val; //Replace
-    } else {
-        data[key] = val;
-        queue.push_front(key);
-    }
+    unsigned int hashKey = UpdatableQueueKey<K>::get(key);
+    int slot = lookup(hashKey);
+    if(slot >= 0) slots[slot].value() = val; //Replace
+    else insert(key, hashKey, val);
 }
 
 template<typename K, typename V>
 void UpdatableQueue<K,V>::enqueue(K key, V&& val)
 {
-    auto it = data.find(key);
-    if(it != data.end())
-    {
-        it->second = std::move(val); //Replace
-    } else {
-        data.insert(std::make_pair(key, std::move(val)));
-        queue.push_front(key);
-    }
+    unsigned int hashKey = UpdatableQueueKey<K>::get(key);
+    int slot = lookup(hashKey);
+    if(slot >= 0) slots[slot].value() = std::move(val); //Replace
+    else insert(key, hashKey, std::move(val));
 }
 
 template<typename K, typename V>
 void UpdatableQueue<K,V>::enqueue(K key, const V& val, std::function<void (V& oldVal, const V& newVal)> f)
 {
-    auto it = data.find(key);
-    if(it != data.end())
+    unsigned int hashKey = UpdatableQueueKey<K>::get(key);
+    int slot = lookup(hashKey);
+    if(slot >= 0)
     {
-        f(it->second, val);
-        it->second = val; //Replace
-    } else {
-        data.insert(std::make_pair(key, val));
-        queue.push_front(key);
-    }
+        f(slots[slot].value(), val);
+        slots[slot].value() = val; //Replace
+    } else insert(key, hashKey, val);
 }
 
 template<typename K, typename V>
-V& UpdatableQueue<K,V>::top() const
+V& UpdatableQueue<K,V>::top()
 {
-    if(data.empty()) throw std::runtime_error("no element in queue");
-    return data[queue.back()];
+    if(count == 0) throw std::runtime_error("no element in queue");
+    return slots[oldest].value();
+}
+
+template<typename K, typename V>
+const V& UpdatableQueue<K,V>::top() const
+{
+    if(count == 0) throw std::runtime_error("no element in queue");
+    return slots[oldest].value();
 }
 
 template<typename K, typename V>
 V UpdatableQueue<K,V>::dequeue()
 {
-    if(data.empty()) throw std::runtime_error("no element in queue");
-    auto key = queue.back();
-    auto it = data.find(key);
-    auto result = std::move(it->second); //Move out and rely on RVO
-    queue.pop_back();
-    data.erase(it);
+    if(count == 0) throw std::runtime_error("no element in queue");
+    int slot = oldest;
+    V result = std::move(slots[slot].value()); //Move out and rely on RVO
+    release(slot);
     return result;
 }
 
 template<typename K, typename V>
 std::pair<K,V> UpdatableQueue<K,V>::dequeuePair()
 {
-    if(data.empty()) throw std::runtime_error("no element in queue");
-    auto key = queue.back();
-    auto it = data.find(key);
-    auto value = std::move(it->second); //Move out and rely on RVO
-    queue.pop_back();
-    data.erase(it);
-    std::pair<K,V> result = std::pair<K,V>(key, value);
+    if(count == 0) throw std::runtime_error("no element in queue");
+    int slot = oldest;
+    std::pair<K,V> result(slots[slot].key(), std::move(slots[slot].value()));
+    release(slot);
     return result;
 }
 
+template<typename K, typename V>
+void UpdatableQueue<K,V>::allocate(int capacity)
+{
+    if(capacity < 1) capacity = 1;
+    cap = capacity;
+    slots.reset(new Slot[cap]);
+    // Keep the table load factor at most 1/2
+    tableBits = 1;
+    while((1 << tableBits) < 2 * cap) tableBits++;
+    table.reset(new int[1 << tableBits]);
+    for(int i = 0; i < (1 << tableBits); i++) table[i] = -1;
+    for(int i = 0; i < cap; i++) slots[i].newer = i + 1 < cap ? i + 1 : -1;
+    freeList = 0;
+    count = 0;
+    oldest = newest = -1;
+}
+
+template<typename K, typename V>
+void UpdatableQueue<K,V>::grow()
+{
+    UpdatableQueue other(2 * cap);
+    while(oldest >= 0)
+    {
+        Slot& s = slots[oldest];
+        other.insert(s.key(), s.hashKey, std::move(s.value()));
+        release(oldest);
+    }
+    swap(other);
+}
+
+template<typename K, typename V>
+int UpdatableQueue<K,V>::lookup(unsigned int hashKey) const
+{
+    const unsigned int mask = (1 << tableBits) - 1;
+    for(unsigned int i = home(hashKey);; i = (i + 1) & mask)
+    {
+        int slot = table[i];
+        if(slot < 0) return -1;
+        if(slots[slot].hashKey == hashKey) return slot;
+    }
+}
+
+template<typename K, typename V>
+template<typename U>
+void UpdatableQueue<K,V>::insert(const K& key, unsigned int hashKey, U&& val)
+{
+    if(freeList < 0)
+    {
+        // Key and value may refer to an element that is about to be moved
+        K tempKey(key);
+        V tempVal(std::forward<U>(val));
+        grow();
+        insert(tempKey, hashKey, std::move(tempVal));
+        return;
+    }
+    int slot = freeList;
+    Slot& s = slots[slot];
+    new (&s.valueStorage) V(std::forward<U>(val));
+    new (&s.keyStorage) K(key);
+    freeList = s.newer;
+    s.hashKey = hashKey;
+    s.older = newest;
+    s.newer = -1;
+    if(newest >= 0) slots[newest].newer = slot;
+    else oldest = slot;
+    newest = slot;
+    count++;
+    
+    const unsigned int mask = (1 << tableBits) - 1;
+    unsigned int i = home(hashKey);
+    while(table[i] >= 0) i = (i + 1) & mask;
+    table[i] = slot;
+}
+
+template<typename K, typename V>
+void UpdatableQueue<K,V>::release(int slot)
+{
+    Slot& s = slots[slot];
+    
+    // Remove from the table, shifting back the following entries of the
+    // cluster that would no longer be reachable, so that no tombstones are
+    // needed
+    const unsigned int mask = (1 << tableBits) - 1;
+    unsigned int i = home(s.hashKey);
+    while(table[i] != slot) i = (i + 1) & mask;
+    table[i] = -1;
+    for(unsigned int j = (i + 1) & mask; table[j] >= 0; j = (j + 1) & mask)
+    {
+        unsigned int h = home(slots[table[j]].hashKey);
+        // The entry at j can fill the hole at i only if its home position
+        // is not cyclically in (i, j]
+        bool stays = i <= j ? (i < h && h <= j) : (i < h || h <= j);
+        if(stays) continue;
+        table[i] = table[j];
+        table[j] = -1;
+        i = j;
+    }
+    
+    if(s.older >= 0) slots[s.older].newer = s.newer;
+    else oldest = s.newer;
+    if(s.newer >= 0) slots[s.newer].older = s.older;
+    else newest = s.older;
+    s.key().~K();
+    s.value().~V();
+    s.newer = freeList;
+    freeList = slot;
+    count--;
+}
 
 } // namespace mxnet
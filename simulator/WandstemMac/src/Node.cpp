@@ -72,7 +72,18 @@ try {
             -90,           //minWeakNeighborRSSI
             3,             //maxMissedTimesyncs
             true,          //channelSpatialReuse
-            useWeakTopologies //useWeakTopologies
+            useWeakTopologies, //useWeakTopologies
+            false,             //compactDataHeader
+            false,             //combineRedundantCopies
+            false,             //earlyTermination
+            false,             //calibrateSlotTiming
+            false,             //adaptiveUplink
+            false,             //burstUplink
+            false,             //deltaTopologies
+            false,             //sparseTopologies
+            false,             //concurrentUplink
+            false,             //smeFastPath
+            false              //backgroundRekeying
 #ifdef CRYPTO
             ,
             true,          //authenticateControlMessages
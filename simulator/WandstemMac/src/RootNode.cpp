@@ -73,7 +73,18 @@ void RootNode::activity() {
       -90,              // minWeakNeighborRSSI
       3,                // maxMissedTimesyncs
       true,             // channelSpatialReuse
-      useWeakTopologies // useWeakTopologies
+      useWeakTopologies, // useWeakTopologies
+      false,             // compactDataHeader
+      false,             // combineRedundantCopies
+      false,             // earlyTermination
+      false,             // calibrateSlotTiming
+      false,             // adaptiveUplink
+      false,             // burstUplink
+      false,             // deltaTopologies
+      false,             // sparseTopologies
+      false,             // concurrentUplink
+      false,             // smeFastPath
+      false              // backgroundRekeying
 #ifdef CRYPTO
       ,
       true,  // authenticateControlMessages
@@ -160,9 +160,20 @@ RecvResult Transceiver::recv(void* pkt, int size, long long timeout, Unit unit,
             dynamic_cast<cMessage*>(collidingMsgs.back())->getSendingTime().inUnit(SIMTIME_NS) <<
             ", crc was " << (cfg.crc? "enabled": "disabled") << endl;
         //if there was a collision, meaning any received packet during the message length
-        if (cfg.crc) //crc enabled -> bad crc
+        if (cfg.crc) { //crc enabled -> bad crc, but the corrupted bytes are still delivered
             result.error = RecvResult::CRC_FAIL;
-        else { //crc disabled -> random bytes received successfully
+            result.size = cPkt->length - 2;
+            if (result.size > size) result.error = RecvResult::TOO_LONG;
+            int copied = std::min<int>(size, result.size);
+            memcpy(pkt, cPkt->data, copied);
+            if (size > copied) memset(((unsigned char*) pkt) + copied, 0, size - copied);
+            //the colliding frame corrupts a few bits of the payload
+            int errors = parentNode->uniform(1, 9, 0);
+            for (int i = 0; i < errors && copied > 0; i++) {
+                int bit = parentNode->uniform(0, copied * 8, 0);
+                ((unsigned char*) pkt)[bit / 8] ^= 1 << (bit % 8);
+            }
+        } else { //crc disabled -> random bytes received successfully
             for (int i = 0; i < size; i++)
                 ((unsigned char*) pkt)[i] = parentNode->uniform(0, 16, 0);
             result.error = RecvResult::OK;
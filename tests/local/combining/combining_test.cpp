@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <cassert>
+#include "util/packet_combining.h"
+#include "crypto/aes_ocb.h"
+
+using namespace std;
+using namespace mxnet;
+
+unsigned char key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+unsigned char nonce[12] = {0xBB, 0xAA, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x0F};
+
+// Build an authenticated packet like a data phase transmission
+Packet makePacket(AesOcb& ocb)
+{
+    Packet pkt;
+    pkt.putPanHeader(6, 42);
+    for(unsigned char i = 0; i < 40; i++) pkt.put(&i, 1);
+    pkt.reserveTag();
+    ocb.setNonce(nonce);
+    pkt.putTag(ocb);
+    return pkt;
+}
+
+// Emulate a collision by flipping one bit of the received copy
+Packet corrupt(const Packet& pkt, unsigned int bit)
+{
+    Packet result = pkt;
+    result.data()[bit / 8] ^= 1 << (bit % 8);
+    return result;
+}
+
+bool verifies(Packet pkt, AesOcb& ocb)
+{
+    ocb.setNonce(nonce);
+    return pkt.verify(ocb);
+}
+
+void testMajorityCombining()
+{
+    AesOcb ocb(key);
+    Packet original = makePacket(ocb);
+    assert(verifies(original, ocb));
+
+    //Every copy has a different bit error, none verifies on its own
+    Packet a = corrupt(original, 3);
+    Packet b = corrupt(original, 8 * 20 + 5);
+    Packet c = corrupt(corrupt(original, 8 * 30), 8 * original.size() - 1);
+    assert(!verifies(a, ocb) && !verifies(b, ocb) && !verifies(c, ocb));
+
+    Packet combined;
+    assert(combineMajority(combined, a, b, c));
+    assert(combined.size() == original.size());
+    assert(verifies(combined, ocb));
+
+    //Copies of different length are not combined
+    Packet shorter = a;
+    shorter.discardFromEnd(1);
+    Packet unused;
+    assert(!combineMajority(unused, shorter, b, c));
+    printf("Majority combining: OK\n");
+}
+
+void testSelectionCombining()
+{
+    AesOcb ocb(key);
+    Packet original = makePacket(ocb);
+
+    //Only the copy received with the highest RSSI is intact
+    Packet copies[3] = { corrupt(original, 17), original, corrupt(original, 100) };
+    short rssi[3] = { -80, -60, -75 };
+    unsigned int best = strongestCopy(rssi, 3);
+    assert(best == 1);
+    assert(verifies(copies[best], ocb));
+
+    //A single copy is always the strongest
+    assert(strongestCopy(rssi, 1) == 0);
+    printf("Selection combining: OK\n");
+}
+
+int main()
+{
+    testMajorityCombining();
+    testSelectionCombining();
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <cstdio>
 #include "crypto/initialization_vector.h"
 #include "crypto/aes_gcm.h"
 
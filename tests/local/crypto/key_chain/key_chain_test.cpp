@@ -0,0 +1,155 @@
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <chrono>
+#include <random>
+#include <set>
+#include "crypto/key_management/master_key_chain.h"
+
+using namespace std;
+using namespace mxnet;
+
+static const unsigned char rootKey[16] = {
+    0x4d, 0x69, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74,
+    0x4d, 0x69, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74
+};
+
+static bool sameKey(const MasterKey& a, const MasterKey& b) {
+    return a.getIndex() == b.getIndex() && memcmp(a.get(), b.get(), 16) == 0;
+}
+
+// Upper bound on the hashes needed by a single advance
+static unsigned int maxHashes(unsigned int newIndex) {
+    const unsigned int top = MasterKey::levels - 1;
+    return top * MasterKeyChain::fanout
+         + (newIndex >> (top * MasterKeyChain::fanoutBits)) + top;
+}
+
+// Jumping to an index gives the same key as stepping to it one at a time
+void testEquivalence() {
+    MasterKeyChain chain;
+    MasterKey stepped, jumped, start;
+    chain.init(stepped, rootKey);
+    start = stepped;
+    mt19937 rng(42);
+    uniform_int_distribution<unsigned int> gap(1, 3 * MasterKeyChain::fanout);
+    for(int i = 0; i < 200; i++) {
+        unsigned int newIndex = stepped.getIndex() + gap(rng);
+        unsigned int hashes = chain.advance(jumped, start, newIndex);
+        assert(hashes <= maxHashes(newIndex));
+        while(stepped.getIndex() < newIndex) chain.next(stepped, stepped);
+        assert(sameKey(stepped, jumped));
+        // Keys never repeat
+        assert(memcmp(jumped.get(), start.get(), 16) != 0);
+        start = jumped;
+    }
+    // Advancing to the current index is a no-op
+    assert(chain.advance(jumped, start, start.getIndex()) == 0);
+    assert(sameKey(jumped, start));
+}
+
+// Hashes of the MasterKeyChain, whose IVs are public
+struct PublicHashes {
+    PublicHashes() {
+        unsigned char iv[16];
+        for(unsigned int i = 0; i < MasterKey::levels; i++) {
+            memcpy(iv, "masterChainLeve", 15);
+            iv[15] = i;
+            chainHash[i].setIv(iv);
+        }
+        for(unsigned int i = 0; i < MasterKey::levels - 1; i++) {
+            memcpy(iv, "masterRestartLv", 15);
+            iv[15] = i;
+            restartHash[i].setIv(iv);
+        }
+    }
+    SingleBlockMPHash chainHash[MasterKey::levels];
+    SingleBlockMPHash restartHash[MasterKey::levels - 1];
+};
+
+typedef array<unsigned char, 16> Key;
+
+// Collect the master keys obtained hashing key along the chain of its level
+// up to steps times, and restarting the lower levels from each of them
+static void reach(PublicHashes& h, set<Key>& result, unsigned int level,
+                  const unsigned char *key, unsigned int steps) {
+    Key k, lower;
+    memcpy(k.data(), key, 16);
+    for(unsigned int i = 0; i <= steps; i++) {
+        if(level == 0) result.insert(k);
+        else {
+            h.restartHash[level - 1].digestBlock(lower.data(), k.data());
+            reach(h, result, level - 1, lower.data(), MasterKeyChain::fanout);
+        }
+        h.chainHash[level].digestBlock(k.data(), k.data());
+    }
+}
+
+// The keys held by a node for the current index, upper levels included,
+// must not allow to compute the master keys of the previous indices
+void testBackwardSecrecy() {
+    static_assert(MasterKey::levels == 3, "test written for three levels");
+    const unsigned int fanout = MasterKeyChain::fanout;
+    const unsigned int topBlock = fanout * fanout;
+    MasterKeyChain chain;
+    MasterKey key, other;
+    chain.init(key, rootKey);
+    // Well within the current block of both upper levels
+    const unsigned int index = topBlock + 3 * fanout + 5;
+    chain.advance(key, key, index);
+
+    PublicHashes h;
+    set<Key> reachable;
+    for(unsigned int l = 0; l < MasterKey::levels; l++)
+        reach(h, reachable, l, key.getLevelKey(l), l == 2 ? 1 : fanout);
+
+    // The search covers the following keys, including later blocks
+    for(unsigned int i : {index, index + 1, index + fanout, 2 * topBlock}) {
+        chain.advance(other, key, i);
+        Key k;
+        memcpy(k.data(), other.get(), 16);
+        assert(reachable.count(k) == 1);
+    }
+    // But none of the previous ones
+    chain.init(other, rootKey);
+    while(other.getIndex() < index) {
+        Key k;
+        memcpy(k.data(), other.get(), 16);
+        assert(reachable.count(k) == 0);
+        chain.next(other, other);
+    }
+}
+
+// Compare resync cost against a single hash chain
+void benchResync() {
+    MasterKeyChain chain;
+    MasterKey key, result;
+    chain.init(key, rootKey);
+    SingleBlockMPHash linearHash;
+    unsigned char linear[16];
+    for(unsigned int gap : {1u, 100u, 10000u, 100000u, 600000u}) {
+        auto t0 = chrono::steady_clock::now();
+        unsigned int hashes = chain.advance(result, key, gap);
+        auto t1 = chrono::steady_clock::now();
+        memcpy(linear, rootKey, 16);
+        for(unsigned int i = 0; i < gap; i++) linearHash.digestBlock(linear, linear);
+        auto t2 = chrono::steady_clock::now();
+        assert(hashes <= maxHashes(gap));
+        printf("gap %6u: chain %3u hashes %6ldus, linear %6u hashes %8ldus\n",
+               gap, hashes,
+               (long)chrono::duration_cast<chrono::microseconds>(t1 - t0).count(),
+               gap,
+               (long)chrono::duration_cast<chrono::microseconds>(t2 - t1).count());
+    }
+}
+
+int main() {
+    testEquivalence();
+    testBackwardSecrecy();
+    benchResync();
+    printf("ok\n");
+    return 0;
+}
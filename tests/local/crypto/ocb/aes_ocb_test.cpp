@@ -1,3 +1,4 @@
+#include <cstdio>
 #include "crypto/aes_ocb.h"
 
 using namespace std;
@@ -47,7 +47,18 @@ int main()
         -95,           //minWeakNeighborRSSI
         4,             //maxMissedTimesyncs
         false,         //channelSpatialReuse
-        false          //useWeakTopologies
+        false,          //useWeakTopologies
+        false,          //compactDataHeader
+        false,          //combineRedundantCopies
+        false,          //earlyTermination
+        false,          //calibrateSlotTiming
+        false,          //adaptiveUplink
+        false,          //burstUplink
+        false,          //deltaTopologies
+        false,          //sparseTopologies
+        false,          //concurrentUplink
+        false,          //smeFastPath
+        false           //backgroundRekeying
     );
     
     
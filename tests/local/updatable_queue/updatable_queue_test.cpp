@@ -0,0 +1,150 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <map>
+#include <list>
+// The benchmark is meant to be built optimized, keep the checks anyway
+#undef NDEBUG
+#include <cassert>
+#include "util/updatable_queue.h"
+#include "stream/stream_management_element.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace mxnet;
+
+/**
+ * The previous UpdatableQueue implementation, based on std::map and
+ * std::list, used as reference for correctness and performance
+ */
+template<typename K, typename V>
+class MapUpdatableQueue
+{
+public:
+    void enqueue(K key, const V& val)
+    {
+        auto it = data.find(key);
+        if(it != data.end())
+        {
+            it->second = val; //Replace
+        } else {
+            data.insert(make_pair(key, val));
+            queue.push_front(key);
+        }
+    }
+
+    V dequeue()
+    {
+        auto key = queue.back();
+        auto it = data.find(key);
+        auto result = std::move(it->second);
+        queue.pop_back();
+        data.erase(it);
+        return result;
+    }
+
+    bool empty() const { return data.empty(); }
+    size_t size() const { return data.size(); }
+
+private:
+    map<K,V> data;
+    list<K> queue;
+};
+
+struct Key
+{
+    unsigned int k;
+    unsigned int getKey() const { return k; }
+    bool operator<(const Key& other) const { return k < other.k; }
+};
+
+// Compare the two implementations with a random sequence of operations,
+// keys are drawn from a small range to exercise updates and collisions
+template<typename K, typename MakeKey>
+void testRandom(MakeKey makeKey, int numKeys)
+{
+    mt19937 gen(42);
+    UpdatableQueue<K,int> q(2); // Small capacity to exercise growth
+    MapUpdatableQueue<K,int> ref;
+    for(int i = 0; i < 100000; i++)
+    {
+        if(gen() % 3 != 0)
+        {
+            auto key = makeKey(gen() % numKeys);
+            q.enqueue(key, i);
+            ref.enqueue(key, i);
+        } else if(!ref.empty()) {
+            int top = q.top();
+            int dequeued = q.dequeue();
+            assert(top == dequeued && dequeued == ref.dequeue());
+        }
+        assert(q.size() == ref.size());
+    }
+    while(!ref.empty()) assert(q.dequeue() == ref.dequeue());
+    assert(q.empty());
+}
+
+void testOrder()
+{
+    UpdatableQueue<unsigned char,int> q;
+    q.enqueue(3, 30);
+    q.enqueue(1, 10);
+    q.enqueue(2, 20);
+    q.enqueue(3, 31); // Update keeps the position
+    assert(*q.find(1) == 10);
+    assert(q.find(4) == nullptr);
+    const auto& cq = q;
+    assert(cq.top() == 31);
+    auto p = q.dequeuePair();
+    assert(p.first == 3 && p.second == 31);
+    int expected[] = {10, 20};
+    int i = 0;
+    q.forEach([&](const int& v) { assert(v == expected[i++]); });
+    auto copy = q;
+    q.clear();
+    assert(q.empty() && copy.size() == 2);
+    assert(copy.dequeue() == 10);
+    assert(copy.dequeue() == 20);
+    SMEKey key(StreamId(1, 2, 0, 1), SMEType::CONNECT);
+    UpdatableQueue<SMEKey,int> sq;
+    sq.enqueue(key, 1);
+    sq.enqueue(key, 2);
+    assert(sq.size() == 1 && sq.dequeue() == 2);
+}
+
+// Steady state workload of the uplink queues: a set of nodes updating their
+// element, and a forwarder dequeuing some of them
+template<typename Q>
+double benchmark(int numKeys)
+{
+    Q q;
+    mt19937 gen(1);
+    unsigned long long result = 0;
+    auto start = steady_clock::now();
+    for(int i = 0; i < 1000000; i++)
+    {
+        q.enqueue(gen() % numKeys, i);
+        if((i & 3) == 0 && !q.empty()) result += q.dequeue();
+    }
+    auto end = steady_clock::now();
+    if(result == 42) cout << ' '; // Prevent optimizing away the loop
+    return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+int main()
+{
+    testOrder();
+    testRandom<unsigned char>([](unsigned int k) { return static_cast<unsigned char>(k); }, 32);
+    testRandom<Key>([](unsigned int k) { return Key{k * 0x10001}; }, 200);
+
+    for(int numKeys : {16, 64, 256})
+    {
+        double map = benchmark<MapUpdatableQueue<unsigned char,int>>(numKeys);
+        double flat = benchmark<UpdatableQueue<unsigned char,int>>(numKeys);
+        cout << numKeys << " keys: map+list " << map << "ns/op, flat "
+             << flat << "ns/op" << endl;
+    }
+
+    cout<<"ok"<<endl;
+    return 0;
+}